@@ -0,0 +1,12 @@
+# Find package for zstd
+include(LibFindMacros)
+
+# Use pkg-config to get hints
+libfind_pkg_detect(zstd libzstd
+    FIND_PATH zstd.h
+    FIND_LIBRARY zstd)
+
+# Set include dir and libraries variables
+set(Zstd_PROCESS_INCLUDES zstd_INCLUDE_DIR)
+set(Zstd_PROCESS_LIBS zstd_LIBRARY)
+libfind_process(Zstd)
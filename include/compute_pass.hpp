@@ -0,0 +1,93 @@
+#ifndef _COMPUTE_PASS_HPP_
+#define _COMPUTE_PASS_HPP_
+
+#include <shadertoy.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "discovered_bindings.hpp"
+#include "discovered_uniform.hpp"
+#include "pass_program.hpp"
+
+/// RGBA32F image written by a compute or postprocessing pass, sized like the
+/// render targets
+class compute_output {
+    std::unique_ptr<shadertoy::backends::gx::texture> texture_;
+    shadertoy::rsize size_;
+
+   public:
+    compute_output();
+
+    inline shadertoy::backends::gx::texture *texture() const
+    { return texture_.get(); }
+
+    /// Allocated size, 0x0 until the first allocation
+    inline const shadertoy::rsize &size() const { return size_; }
+
+    /// Reallocate the image if its size changed
+    void allocate(const shadertoy::rsize &size);
+};
+
+/**
+ * @brief Compute shader pass run between the geometry and postprocess stages
+ *
+ * The source declares the work group size with `//! local_size X Y`, and its
+ * sampler inputs with the `//! name binding=target` directives of
+ * postprocess shaders. Targets are outputs of the geometry buffer, or the
+ * identifier of an earlier compute pass. The pass writes one RGBA32F image,
+ * oOutput, which later passes and the postprocess shader bind by the pass
+ * identifier. iResolution is declared as in fragment passes.
+ */
+class compute_pass {
+    std::string id_;
+    std::string source_;
+    glm::ivec2 local_size_;
+    std::vector<discovered_binding> bindings_;
+
+    pass_program program_;
+
+   public:
+    /**
+     * @brief     Parse a compute pass
+     *
+     * @param[in]  id       Identifier of the pass
+     * @param[in]  source   Preprocessed source of the pass
+     * @param[out] uniforms Discovered uniforms, the uniforms declared by the
+     *                      source are appended to it unless another stage
+     *                      already declared them
+     */
+    compute_pass(const std::string &id, const std::string &source,
+                 std::vector<discovered_uniform> &uniforms);
+
+    compute_pass(const compute_pass &) = delete;
+    compute_pass &operator=(const compute_pass &) = delete;
+
+    inline const std::string &id() const { return id_; }
+
+    inline const std::vector<discovered_binding> &bindings() const
+    { return bindings_; }
+
+    /// Compile the program if needed, throws std::runtime_error on failure
+    void compile();
+
+    template <typename T>
+    void set_uniform(const std::string &name, const T &value) {
+        program_.set_uniform(name, value);
+    }
+
+    /**
+     * @brief     Run the pass over an image
+     *
+     * @param[in] inputs Textures of bindings(), in the same order
+     * @param[in] output Image to write, allocated at the given size
+     * @param[in] size   Size of the render targets
+     */
+    void dispatch(const std::vector<shadertoy::backends::gx::texture *> &inputs,
+                  compute_output &output, const shadertoy::rsize &size);
+};
+
+#endif /* _COMPUTE_PASS_HPP_ */
@@ -4,5 +4,14 @@
 const int window_width = 300;
 const float rotate_speed = 0.0125f;
 const float mouse_speed = 0.5f;
+const int profiler_history = 1024;
+/// Frames drawn after an input event, so ImGui can settle
+const int idle_redraw_frames = 3;
+/// Interval at which the network thread checks for shutdown
+const int server_poll_ms = 100;
+/// Maximum number of requests waiting for the render thread
+const int command_queue_size = 256;
+/// Interval between refreshes of the timing statistics served to clients
+const int stats_refresh_ms = 100;
 
 #endif /* _CONFIG_HPP_ */
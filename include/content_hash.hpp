@@ -0,0 +1,42 @@
+#ifndef _CONTENT_HASH_HPP_
+#define _CONTENT_HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/// 64-bit FNV-1a hash. Unlike std::hash, its values do not change between
+/// runs or builds, so they can name files of on-disk caches.
+class content_hash {
+    uint64_t value_;
+
+   public:
+    content_hash() : value_(0xcbf29ce484222325ULL) {}
+
+    inline uint64_t value() const { return value_; }
+
+    void add_bytes(const void *data, size_t size) {
+        auto bytes = reinterpret_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value_ ^= bytes[i];
+            value_ *= 0x100000001b3ULL;
+        }
+    }
+
+    /// Add a string, with its length so consecutive strings cannot collide
+    void add(const std::string &value) {
+        uint64_t size = value.size();
+        add_bytes(&size, sizeof(size));
+        add_bytes(value.data(), value.size());
+    }
+
+    /// Add the bytes of a value, e.g. a scalar or a glm vector
+    template <typename T> void add(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "only plain values can be hashed by their bytes");
+        add_bytes(&value, sizeof(value));
+    }
+};
+
+#endif /* _CONTENT_HASH_HPP_ */
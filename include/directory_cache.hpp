@@ -0,0 +1,99 @@
+#ifndef _DIRECTORY_CACHE_HPP_
+#define _DIRECTORY_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Files of an on-disk cache, one per 64-bit key, with a size limit
+ *
+ * Files are named after their key. When they exceed the size limit, the least
+ * recently used ones are removed. Uses are recorded in the modification times,
+ * so the order is kept across runs and shared with other viewers using the
+ * same directory. Files are written under a temporary name and renamed, so
+ * they are never read partially. The file contents are up to the callers,
+ * which validate them when they read them. Thread-safe.
+ */
+class directory_cache {
+   public:
+    struct cache_stats {
+        /// Total size of the files in bytes
+        uint64_t size;
+        uint64_t files;
+        /// Files removed to fit the size limit
+        uint64_t evictions;
+    };
+
+    /**
+     * @brief     Open a cache directory and index its files
+     *
+     * @param[in] dir       Directory of the files, created if needed
+     * @param[in] extension Extension of the files, e.g. ".bin"
+     * @param[in] budget    Size limit of the files in bytes
+     *
+     * @throws std::runtime_error if the directory can not be created
+     */
+    directory_cache(const std::string &dir, const std::string &extension,
+                    size_t budget);
+
+    directory_cache(const directory_cache &) = delete;
+    directory_cache &operator=(const directory_cache &) = delete;
+
+    /// Path of the file of the given key
+    std::string path(uint64_t key) const;
+
+    /// Record a use of the file of the given key, which may have been
+    /// written by another viewer
+    void touch(uint64_t key, uint64_t size);
+
+    /// Remove the file of the given key, e.g. when its contents are invalid
+    void remove(uint64_t key);
+
+    /**
+     * @brief     Write the file of the given key, then evict files over the
+     *            size limit
+     *
+     * @param[in] key         Key of the file
+     * @param[in] header      Header of the file
+     * @param[in] header_size Size of the header in bytes
+     * @param[in] data        Contents following the header
+     * @param[in] size        Size of the contents in bytes
+     *
+     * @return false if the file was not written, or would not fit the limit
+     */
+    bool write(uint64_t key, const void *header, size_t header_size,
+               const void *data, size_t size);
+
+    cache_stats stats() const;
+
+    inline const std::string &dir() const { return dir_; }
+
+    inline size_t budget() const { return budget_; }
+
+   private:
+    struct file_entry {
+        uint64_t size;
+        /// Modification time in nanoseconds, updated on uses
+        int64_t last_used;
+    };
+
+    std::string dir_;
+    std::string extension_;
+    size_t budget_;
+
+    mutable std::mutex mutex_;
+    std::map<uint64_t, file_entry> files_;
+    cache_stats counters_;
+
+    /// Set the entry of a key, with the mutex held
+    void update(uint64_t key, const file_entry &entry);
+
+    /// Remove the least recently used files until they fit the budget,
+    /// with the mutex held
+    void evict();
+};
+
+#endif /* _DIRECTORY_CACHE_HPP_ */
@@ -71,4 +71,7 @@ bool try_parse_uniform(const std::string &line,
 
 bool try_set_variant(uniform_variant &dst, const uniform_variant &value);
 
+/// Parse a textual value (e.g. "1.0,0.5") using the current type of dst
+bool try_parse_variant(uniform_variant &dst, const std::string &text);
+
 #endif /* _DISCOVERED_UNIFORM_HPP_ */
@@ -3,12 +3,21 @@
 
 #include <shadertoy.hpp>
 
+#include <functional>
+#include <optional>
+#include <set>
+#include <tuple>
+
 #include "log.hpp"
 
 #include "mvw/geometry.hpp"
 
 #include "mvw_buffer.hpp"
 
+#include "compute_pass.hpp"
+#include "image_allocator.hpp"
+#include "postprocess_pass.hpp"
+
 #include "discovered_bindings.hpp"
 #include "discovered_uniform.hpp"
 
@@ -16,6 +25,12 @@
 
 #include "data_input.hpp"
 
+#include "noise_stats.hpp"
+
+#include "noise/gabor.hpp"
+
+#include "profiler.hpp"
+
 typedef std::map<std::string, std::shared_ptr<data_input>> input_map_t;
 
 struct viewer_state;
@@ -35,6 +50,92 @@ struct gl_state {
     /// Geometry scale
     float scale;
 
+    /// Fit geometry using its oriented bounds instead of its bounding box
+    bool fit_oriented_bounds;
+
+    /// GPU and CPU timing history
+    profiler timings;
+
+    /// Compute reductions of render outputs, used by getnoisestats
+    noise_stats_reducer stats_reducer;
+
+    /// Outputs of the compute and postprocessing passes of every chain
+    image_allocator transient_images;
+
+    /// Region of a larger frame rendered at render_size, see set_tile
+    struct tile_region {
+        /// Size of the full frame
+        shadertoy::rsize frame_size;
+        /// Offset of the rendered region in the full frame, from the
+        /// bottom-left corner
+        int x, y;
+    };
+
+    /// Running average of jittered renders of one member output, see
+    /// accumulate
+    struct accumulator {
+        /// Swap chain of the double-buffered averaging member
+        shadertoy::swap_chain chain;
+        /// Number of samples in the average
+        int samples;
+        /// Fingerprint of the render state of the samples
+        uint64_t fingerprint;
+    };
+
+    /// Swap chains and render targets of a chain at a given size
+    struct render_targets {
+        /// Size of the targets, referenced by the chain members
+        std::unique_ptr<shadertoy::rsize> size;
+
+        shadertoy::swap_chain chain;
+        shadertoy::swap_chain geometry_chain;
+        std::shared_ptr<mvw_buffer> geometry_buffer;
+        std::shared_ptr<shadertoy::buffers::toy_buffer> postprocess_buffer;
+
+        /// true if geometry_buffer is shared with other targets of this or
+        /// another chain, which may have resized its depth attachment
+        bool shared_geometry;
+
+        /// Accumulators of the outputs averaged so far, by "buffer.output"
+        std::map<std::string, accumulator> accumulators;
+
+        /// Pool clock value of the last use
+        uint64_t last_used;
+
+        /// Fingerprint of the frame held by the targets, 0 if none
+        uint64_t fingerprint;
+
+        /// true if the targets hold a tile of a frame or a jittered sample
+        /// instead of the frame of the render state, see set_tile and
+        /// accumulate
+        bool stale;
+
+        /// true if the members have no textures, see
+        /// chain_instance::release_targets
+        bool released;
+
+        /// Estimated GPU memory freed by the release, including the pooled
+        /// targets, in bytes
+        size_t released_size;
+
+        /// Estimated GPU memory of the render targets, in bytes
+        size_t memory_size() const;
+    };
+
+    /// Render target pool counters, reported by getstats
+    struct texture_pool_stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        /// Targets resized in place, with no room in the pool
+        uint64_t resizes;
+    };
+
+    /// Memory budget of the render targets of each chain, in bytes
+    size_t texture_pool_budget;
+
+    texture_pool_stats pool_stats;
+
     /**
      * Loaded chain state
      *
@@ -43,34 +144,83 @@ struct gl_state {
     struct chain_instance {
         shader_program_options opt;
 
-        shadertoy::swap_chain chain;
-        shadertoy::swap_chain geometry_chain;
-        std::shared_ptr<mvw_buffer> geometry_buffer;
-        std::shared_ptr<shadertoy::buffers::toy_buffer> postprocess_buffer;
+        /// Render targets at the current render size
+        render_targets targets;
+
+        /// Render targets of recently used sizes, least recently used ones
+        /// are evicted over the texture pool budget
+        std::vector<render_targets> pool;
 
         std::vector<discovered_uniform> discovered_uniforms;
         std::vector<discovered_binding> buffer_bindings;
 
+        /// Compute passes run between the geometry and postprocess stages
+        std::vector<std::unique_ptr<compute_pass>> compute_passes;
+
+        /// Postprocessing passes run before the postprocess shader, in
+        /// dependency order, without the passes it does not depend on
+        std::vector<std::unique_ptr<postprocess_pass>> postprocess_passes;
+
+        /// Index in the transient images of the output of each compute and
+        /// postprocessing pass
+        std::vector<size_t> compute_slots;
+        std::vector<size_t> pass_slots;
+
+        /// Data input the geometry stage reads generated splats from, empty
+        /// if it does not use pg/3d/data.glsl
+        std::string splat_table;
+
+        /// content_hash of the preprocessed source of the geometry stage
+        uint64_t shader_hash;
+
+        /// content_hash of the preprocessed sources of every stage and pass
+        uint64_t source_hash;
+
         bool needs_init;
         std::string error_status;
 
+        /**
+         * @brief     Load a chain from its shader sources
+         *
+         * @param[in] g_buffer_template Template of geometry programs
+         * @param[in] images            Images of the pass outputs
+         * @param[in] opt               Shader sources
+         * @param[in] inputs            Data inputs of the geometry stage
+         * @param[in] context           Rendering context
+         * @param[in] render_size       Initial render size
+         * @param[in] previous          Chain whose geometry program is reused
+         *                              if its source did not change, or null
+         */
         chain_instance(std::shared_ptr<shadertoy::compiler::program_template>
                            g_buffer_template,
+                       image_allocator &images,
                        const shader_program_options &opt,
                        const input_map_t &inputs,
                        shadertoy::render_context &context,
-                       shadertoy::rsize &render_size);
+                       const shadertoy::rsize &render_size,
+                       const chain_instance *previous);
 
         void render(shadertoy::render_context &context, bool draw_wireframe,
                     const shadertoy::rsize &render_size,
-                    std::shared_ptr<mvw_geometry> geometry, bool full_render);
+                    std::shared_ptr<mvw_geometry> geometry, bool full_render,
+                    profiler &timings);
 
-        template <typename TKey, typename... Targs>
-        void set_uniform(const TKey &identifier, Targs &&... value) const {
+        template <typename TKey, typename T>
+        void set_uniform(const TKey &identifier, const T &value) const {
             if (!error_status.empty()) return;
 
-            chain.set_uniform(identifier, std::forward<Targs...>(value...));
-            geometry_chain.set_uniform(identifier, std::forward<Targs...>(value...));
+            // Remember the value for render targets taken from the pool
+            std::string name(identifier);
+            uniform_values_[name] = value;
+
+            targets.chain.set_uniform(name, value);
+            targets.geometry_chain.set_uniform(name, value);
+
+            // Compute programs are shared by all render targets
+            for (const auto &pass : compute_passes)
+                pass->set_uniform(name, value);
+            for (const auto &pass : postprocess_passes)
+                pass->set_uniform(name, value);
         }
 
         void set_named(const std::string &identifier, uniform_variant value);
@@ -79,14 +229,135 @@ struct gl_state {
 
         void init(shadertoy::render_context &context);
 
-        void add_input(const std::string &name, std::shared_ptr<data_input> input);
-
-        void allocate_textures(shadertoy::render_context &context);
+        /// Add a data input, registered is the set of geometry buffers which
+        /// already have it, as chains may share them
+        void add_input(const std::string &name, std::shared_ptr<data_input> input,
+                       std::set<const mvw_buffer *> &registered);
+
+        /// Accumulator of the given member output, created on first use
+        accumulator &find_accumulator(
+            shadertoy::render_context &context,
+            const std::shared_ptr<shadertoy::members::buffer_member> &member,
+            const shadertoy::output_name_t &output);
+
+        /// Restart the accumulation of every output
+        void reset_accumulation();
+
+        /**
+         * @brief     Free the member textures and the pooled targets, while
+         *            the chain is not rendered
+         *
+         * The compiled buffers are kept, so restore_targets only allocates
+         * textures.
+         *
+         * @return true if the targets were released by this call
+         */
+        bool release_targets(shadertoy::render_context &context);
+
+        /// Allocate the member textures of released targets, returns true if
+        /// they were released
+        bool restore_targets(shadertoy::render_context &context);
+
+        /**
+         * @brief     Switch to render targets of the given size
+         *
+         * @param[in] context  Rendering context
+         * @param[in] size     New render size
+         * @param[in] budget   Memory budget of the pooled and current targets
+         * @param[in] stats    Pool counters to update
+         * @param[in] use_pool true to keep the current targets in the pool,
+         *                     false to resize them if no pooled targets match
+         */
+        void allocate_textures(shadertoy::render_context &context,
+                               const shadertoy::rsize &size, size_t budget,
+                               texture_pool_stats &stats, bool use_pool);
 
        private:
-        void parse_directives(const shader_file_program &sfp, bool parse_bindings);
+        std::shared_ptr<shadertoy::compiler::program_template>
+            g_buffer_template_;
+        input_map_t inputs_;
+
+        /// Last value of every uniform set through set_uniform
+        mutable std::map<std::string, uniform_value> uniform_values_;
+
+        uint64_t pool_clock_;
+
+        /// Framebuffer of the postprocessing passes
+        pass_framebuffer pass_target_;
 
-        void compile_shader_source(const std::string &shader_path);
+        image_allocator *images_;
+
+        /// Number of images needed by the passes
+        size_t image_count_;
+
+        /// Error found by build_pass_graph, reported by init
+        std::string pass_graph_error_;
+
+        /// Geometry buffer taken from the previous chain with its compiled
+        /// program, until the first init
+        std::shared_ptr<mvw_buffer> reused_geometry_buffer_;
+
+        /// Create targets, with new geometry and postprocess buffers unless
+        /// they are given
+        void make_targets(
+            render_targets &targets, const shadertoy::rsize &size,
+            shadertoy::render_context &context,
+            std::shared_ptr<mvw_buffer> geometry_buffer = {},
+            std::shared_ptr<shadertoy::buffers::toy_buffer>
+                postprocess_buffer = {});
+
+        /// Allocate the textures of the members of a chain whose buffers
+        /// are already compiled
+        void allocate_chain(shadertoy::swap_chain &chain,
+                            shadertoy::render_context &context);
+
+        /// Initialize the members of a chain, without compiling the program
+        /// of the reused geometry buffer
+        void init_chain(shadertoy::swap_chain &chain,
+                        shadertoy::render_context &context);
+
+        /// Set the uniform values of the current targets on other targets
+        void restore_uniforms(const render_targets &targets) const;
+
+        void parse_directives(const std::string &source, bool parse_bindings);
+
+        /// Index of the compute pass a binding targets, or -1 if it targets
+        /// a geometry output
+        int find_compute_pass(const shadertoy::output_name_t &target) const;
+
+        /// Index of the postprocessing pass a binding targets, or -1
+        int find_postprocess_pass(const shadertoy::output_name_t &target) const;
+
+        /// Identifier of a pass read from the given file, unique among the
+        /// compute and postprocessing passes
+        std::string make_pass_id(const std::string &path) const;
+
+        /// Order the postprocessing passes by their bindings, and drop the
+        /// ones the postprocess shader does not depend on
+        void build_pass_graph();
+
+        /// Share images between passes whose outputs are not read at the
+        /// same time
+        void assign_images();
+
+        /// Throw if a pass binds an output that is neither a geometry output
+        /// nor the output of a pass, so render can not fail on it
+        void check_pass_bindings() const;
+
+        /// Texture of a pass input: a geometry output, or the image of a
+        /// compute or postprocessing pass
+        shadertoy::backends::gx::texture *find_pass_input(
+            const shadertoy::output_name_t &target,
+            const std::vector<shadertoy::members::member_output_t>
+                &geometry_outputs);
+
+        /// Run the compute passes on the outputs of the geometry buffer
+        void run_compute_passes(profiler &timings);
+
+        /// Run the postprocessing passes, after the compute passes
+        void run_postprocess_passes(profiler &timings);
+
+        void compile_shader_sources(const std::vector<std::string> &shader_paths);
     };
 
     /// Loaded chain states
@@ -103,28 +374,92 @@ struct gl_state {
 
     bool render_imgui(int back_revision = 0);
 
-    void get_render_ms(float times[2], int back_revision = 0);
-
     std::vector<shadertoy::members::member_output_t> get_render_result(int back_revision = 0, const std::string &target = "") const;
 
     std::string get_render_error(int back_revision = 0) const;
 
+    /**
+     * @brief     Average jittered renders of the current frame
+     *
+     * Samples are rendered with sub-pixel offsets and iFrame values
+     * starting at 0, so the same state gives the same average. They are
+     * kept while the fingerprint of the render state matches, so later
+     * calls only render the missing samples. Asking for fewer samples than
+     * are kept restarts from the first one. The render targets are left
+     * with the last sample, see stale_frame.
+     *
+     * @param[in] samples       Number of samples to average
+     * @param[in] back_revision Revision to render
+     * @param[in] target        Member to average, as in get_render_result
+     * @param[in] output        Output of the member to average
+     *
+     * @return Output of the accumulator, holding the average
+     */
+    std::vector<shadertoy::members::member_output_t> accumulate(
+        int samples, int back_revision, const std::string &target,
+        const shadertoy::output_name_t &output);
+
     const std::vector<discovered_uniform> &get_discovered_uniforms(
         int back_revision = 0) const;
 
     std::vector<discovered_uniform> &get_discovered_uniforms(
         int back_revision = 0);
 
+    /// Parameters of the CPU Gabor noise, from the uniforms of the chain and
+    /// the bounding box of the geometry
+    noise::gabor_params get_gabor_params(int back_revision = 0) const;
+
     bool has_postprocess(int back_revision = 0) const;
 
-    void allocate_textures();
+    /// Reallocate render targets at render_size. Sizes requested with
+    /// use_pool are kept in the texture pool for later reuse.
+    void allocate_textures(bool use_pool = false);
 
     void update_uniforms(float t, const viewer_state &state);
 
+    /// Render the given region of a larger frame, or the whole frame if empty
+    void set_tile(const std::optional<tile_region> &tile);
+
     void load_defaults();
 
     void set_input(const std::string &name, std::vector<float> data, std::array<uint32_t, 3> dims);
 
+    /**
+     * @brief     Memory of the render targets, in MB
+     *
+     * "targets_mb" is the memory of the member outputs of every chain, and
+     * "transient_mb" the memory of the pass outputs. "unaliased_mb" is what
+     * the pass outputs would need with one image per pass and render
+     * target. "released_mb" is the memory the hidden revisions freed when
+     * their targets were released, and "saved_mb" adds it to the memory
+     * saved by sharing the pass outputs.
+     */
+    std::map<std::string, double> memory_stats() const;
+
+    /**
+     * @brief     Hash of the state a frame is rendered from
+     *
+     * Covers the uniform values of the revision, the model and view
+     * matrices, the preprocessed sources, the contents of the geometry and
+     * inputs, the render size, the tile and the sample jitter. Time uniforms
+     * are left out, as getframe does not render again for them. Values are
+     * content_hash values, the same across runs for the same state.
+     *
+     * @param[in] state         Viewer state
+     * @param[in] back_revision Revision to render
+     * @param[in] size          Render size
+     */
+    uint64_t fingerprint(const viewer_state &state, int back_revision,
+                         const shadertoy::rsize &size) const;
+
+    /// Fingerprint of the frame in the render targets of the revision, 0 if
+    /// they do not hold a complete frame
+    uint64_t rendered_fingerprint(int back_revision = 0) const;
+
+    /// true if the render targets of the revision hold a tile rendered by
+    /// set_tile or a sample of accumulate instead of the current frame
+    bool stale_frame(int back_revision = 0) const;
+
    private:
     std::shared_ptr<shadertoy::compiler::program_template> g_buffer_template_;
 
@@ -133,6 +468,47 @@ struct gl_state {
 
     /// Named data inputs
     input_map_t inputs_;
+
+    /// Inputs set through set_input, never replaced by generated tables
+    std::set<std::string> client_inputs_;
+
+    /// Tile count, seed and splat count of the generated splat table
+    std::optional<std::tuple<glm::ivec3, int, int>> splat_table_key_;
+
+    /// Currently rendered tile
+    std::optional<tile_region> tile_;
+
+    /// Sub-pixel offset of the rendered sample, in pixels
+    glm::vec2 jitter_;
+
+    /// iFrame of the current frame
+    int frame_count_;
+
+    /// content_hash of the geometry shader templates, of the loaded
+    /// geometry and of every data input
+    uint64_t template_hash_;
+    uint64_t geometry_hash_;
+    std::map<std::string, uint64_t> input_hashes_;
+
+    /// Hash of the matrices given to the last update_uniforms call
+    uint64_t view_hash_;
+
+    uint64_t fingerprint(uint64_t view_hash, int back_revision,
+                         const shadertoy::rsize &size) const;
+
+    /// Update the projection and tiling uniforms
+    void update_frame_uniforms();
+
+    /// Create or update a data input, and register it in all chains
+    void store_input(const std::string &name, std::vector<float> data,
+                     std::array<uint32_t, 3> dims);
+
+    /// Regenerate the splat table of the chain if its seeding uniforms or
+    /// the grid changed
+    void update_splat_table(const chain_instance &chain);
+
+    /// Free the transient images of the sizes no render targets use
+    void release_images();
 };
 
 #endif /* _GL_STATE_HPP_ */
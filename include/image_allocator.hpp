@@ -0,0 +1,40 @@
+#ifndef _IMAGE_ALLOCATOR_HPP_
+#define _IMAGE_ALLOCATOR_HPP_
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "compute_pass.hpp"
+
+/**
+ * @brief Transient images of the compute and postprocessing passes
+ *
+ * Pass outputs are only read during the chain render that writes them, so
+ * the render targets of every chain share the same images by index. Each
+ * chain assigns indices to its passes so that passes whose outputs are needed
+ * at the same time get different images. Every render target size has its
+ * own images, so switching between pooled sizes does not reallocate them.
+ */
+class image_allocator {
+    std::map<std::pair<int, int>, std::vector<std::shared_ptr<compute_output>>>
+        images_;
+
+   public:
+    /// Image of the given index for targets of the given size, created if
+    /// needed
+    std::shared_ptr<compute_output> image(const shadertoy::rsize &size,
+                                          size_t index);
+
+    /// Free the images of the sizes that are not in the given list
+    void release_unused(const std::vector<shadertoy::rsize> &sizes);
+
+    /// Number of images, of every size
+    size_t count() const;
+
+    /// GPU memory of the allocated images, in bytes
+    size_t memory_size() const;
+};
+
+#endif /* _IMAGE_ALLOCATOR_HPP_ */
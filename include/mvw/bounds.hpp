@@ -0,0 +1,70 @@
+#ifndef _BOUNDS_HPP_
+#define _BOUNDS_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/mat3x3.hpp>
+#include <glm/vec3.hpp>
+
+#include "mvw/vertex_data.hpp"
+
+/// Axis-aligned bounds and vertex sum of a set of vertices
+struct vertex_bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::dvec3 sum;
+    size_t count;
+
+    /// Empty bounds, neutral for merge
+    vertex_bounds();
+
+    void merge(const vertex_bounds &other);
+
+    inline bool empty() const { return count == 0; }
+
+    inline glm::dvec3 centroid() const {
+        return count > 0 ? sum / static_cast<double>(count) : glm::dvec3(0.);
+    }
+};
+
+/// Oriented bounding box
+struct oriented_bounds {
+    glm::vec3 center;
+    /// Unit axes of the box, as columns
+    glm::mat3 axes;
+    glm::vec3 half_extents;
+
+    oriented_bounds();
+
+    /// Box aligned with the coordinate axes
+    static oriented_bounds from_aabb(const glm::vec3 &min, const glm::vec3 &max);
+};
+
+/**
+ * @brief     Compute the axis-aligned bounds and centroid of a set of meshes
+ *
+ * Vertices are processed four at a time using SIMD where available, and
+ * meshes are split in chunks reduced on worker threads.
+ *
+ * @param[in] meshes Meshes to reduce
+ *
+ * @return Bounds of all vertices of all meshes
+ */
+vertex_bounds reduce_bounds(const std::vector<mesh_data> &meshes);
+
+/**
+ * @brief     Compute a tight oriented bounding box of a set of meshes
+ *
+ * The box axes are the principal axes of the vertex covariance, which
+ * requires two more passes over the vertices.
+ *
+ * @param[in] meshes Meshes to reduce
+ * @param[in] bounds Result of reduce_bounds on the same meshes
+ *
+ * @return Oriented bounds of all vertices of all meshes
+ */
+oriented_bounds reduce_oriented_bounds(const std::vector<mesh_data> &meshes,
+                                       const vertex_bounds &bounds);
+
+#endif /* _BOUNDS_HPP_ */
@@ -8,6 +8,7 @@
 #include <optional>
 #include <variant>
 
+#include "mvw/bounds.hpp"
 #include "mvw/vertex_data.hpp"
 
 typedef std::variant<int> hint_value;
@@ -33,6 +34,15 @@ class mvw_geometry : public shadertoy::geometry::basic_geometry {
     /// List of meshes to render
     std::vector<mvw_mesh> meshes_;
 
+    /// Per-instance model transforms, shared by all meshes
+    std::unique_ptr<shadertoy::backends::gx::buffer> instances_;
+
+    /// Number of instances to draw
+    int instance_count_;
+
+    /// Number of vertices accounted for in the centroid
+    size_t centroid_count_;
+
     /// List of hints generated by the geometry for the viewer
     std::map<std::string, hint_value> hints_;
 
@@ -40,14 +50,41 @@ class mvw_geometry : public shadertoy::geometry::basic_geometry {
     glm::vec3 bbox_min_;
     glm::vec3 bbox_max_;
     glm::dvec3 bbox_centroid_;
+    oriented_bounds oriented_bounds_;
 
     mvw_geometry();
 
     void add_vertex_data(const std::vector<vertex_data> &vertices,
                          const std::vector<uint32_t> &indices);
 
+    /**
+     * @brief     Upload meshes and merge their bounds into the geometry bounds
+     *
+     * Bounds are reduced on worker threads while the meshes are uploaded.
+     * Oriented bounds can't be merged, so they are only tight if all meshes
+     * are added in a single call.
+     *
+     * @param[in] meshes Meshes to add
+     */
+    void add_meshes(const std::vector<mesh_data> &meshes);
+
     void set_hint(const std::string &hint, hint_value value = 1);
 
+    /**
+     * @brief     Draw the geometry as multiple instances on a grid
+     *
+     * Instances are laid out on a square grid in the XZ plane, centered on
+     * the origin. The bounding box is extended to cover all instances, and
+     * fragments get their position in that space, so each instance samples
+     * its own part of the noise. This should be called once all meshes have
+     * been added.
+     *
+     * @param[in] count   Number of instances to draw
+     * @param[in] spacing Grid cell size, relative to the largest horizontal
+     *                    extent of the geometry
+     */
+    void set_instances(int count, float spacing);
+
    public:
     inline const std::unique_ptr<shadertoy::backends::gx::vertex_array> &vertex_array() const {
         return vao_;
@@ -60,6 +97,12 @@ class mvw_geometry : public shadertoy::geometry::basic_geometry {
 
     inline glm::dvec3 get_centroid() const { return bbox_centroid_; }
 
+    inline const oriented_bounds &get_oriented_bounds() const {
+        return oriented_bounds_;
+    }
+
+    inline int instance_count() const { return instance_count_; }
+
     void draw() const override;
 
     bool has_hint(const std::string &hint) const;
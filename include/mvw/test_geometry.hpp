@@ -4,9 +4,44 @@
 #include "mvw/mvw_geometry.hpp"
 
 class test_geometry : public mvw_geometry {
-    void plane_geometry(const std::string &line);
+    void plane_geometry(const std::string &line,
+                        std::vector<mesh_data> &meshes);
+
+    void grid_geometry(const std::string &line, int lnum,
+                       std::vector<mesh_data> &meshes);
+
+    void sphere_geometry(const std::string &line, int lnum,
+                         std::vector<mesh_data> &meshes);
+
+    void icosphere_geometry(const std::string &line, int lnum,
+                            std::vector<mesh_data> &meshes);
+
+    void torus_geometry(const std::string &line, int lnum,
+                        std::vector<mesh_data> &meshes);
+
+    void cube_geometry(const std::string &line, int lnum,
+                       std::vector<mesh_data> &meshes);
 
    public:
+    /**
+     * @brief     Build a procedural test geometry
+     *
+     * The input starts with a "#test" marker line, followed by one geometry
+     * per line. Optional arguments may be omitted from the right:
+     *
+     *   plane [dim]
+     *   grid [dim] [nx] [ny]
+     *   sphere [radius] [slices] [stacks]
+     *   icosphere [radius] [subdivisions]
+     *   torus [major_radius] [minor_radius] [major_segments] [minor_segments]
+     *   cube [half_size] [subdivisions]
+     *
+     * The "instances count [spacing]" line draws the whole geometry count
+     * times on a grid, see mvw_geometry::set_instances.
+     *
+     * @param[in] geometry      Path to the .tst file, or its source
+     * @param[in] is_tst_source true if \p geometry is the source text
+     */
     test_geometry(const std::string &geometry, bool is_tst_source = false);
 };
 
@@ -1,6 +1,9 @@
 #ifndef _VERTEX_DATA_HPP_
 #define _VERTEX_DATA_HPP_
 
+#include <cstdint>
+#include <vector>
+
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
@@ -17,4 +20,10 @@ struct vertex_data {
 };
 #pragma pack()
 
+/// CPU-side mesh data, before upload
+struct mesh_data {
+    std::vector<vertex_data> vertices;
+    std::vector<uint32_t> indices;
+};
+
 #endif /* _VERTEX_DATA_HPP_ */
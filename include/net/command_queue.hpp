@@ -0,0 +1,58 @@
+#ifndef _NET_COMMAND_QUEUE_HPP_
+#define _NET_COMMAND_QUEUE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace net {
+/**
+ * @brief Bounded lock-free single-producer single-consumer queue
+ *
+ * The network thread pushes decoded requests and the render thread pops
+ * them, so neither thread ever waits on a lock held by the other.
+ */
+template <typename T, size_t Capacity>
+class command_queue {
+    std::array<std::optional<T>, Capacity> items_;
+    /// Index of the next item to pop, only written by the consumer
+    std::atomic<size_t> head_;
+    /// Index of the next item to push, only written by the producer
+    std::atomic<size_t> tail_;
+
+   public:
+    command_queue() : items_(), head_(0), tail_(0) {}
+
+    /// Push an item, returns false if the queue is full. Producer only.
+    bool try_push(T &&item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        items_[tail % Capacity] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pop the oldest item, if any. Consumer only.
+    std::optional<T> try_pop() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return {};
+
+        auto &slot = items_[head % Capacity];
+        std::optional<T> item(std::move(slot));
+        slot.reset();
+
+        head_.store(head + 1, std::memory_order_release);
+        return item;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+};
+}  // namespace net
+
+#endif /* _NET_COMMAND_QUEUE_HPP_ */
@@ -0,0 +1,56 @@
+#ifndef _NET_FRAME_CODEC_HPP_
+#define _NET_FRAME_CODEC_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace net {
+enum frame_codec {
+    FC_NONE = 0,
+    FC_ZSTD = 1,
+};
+
+/// Codec from its getframe name, "" and "none" meaning no compression
+frame_codec parse_frame_codec(const std::string &name);
+
+struct encoded_frame {
+    /// Encoded image data
+    std::vector<uint8_t> data;
+    /// Size of the image before encoding
+    size_t raw_size;
+    /// Time spent encoding, in microseconds
+    int codec_us;
+};
+
+/**
+ * @brief     Group the bytes of elements by significance
+ *
+ * Byte i of every element ends up in plane i of dst, which makes the
+ * slowly-varying exponent bytes of floats contiguous and much easier to
+ * compress.
+ *
+ * @param[in]  src          Source data
+ * @param[out] dst          Destination buffer, of the same size as src
+ * @param[in]  size         Size of src in bytes, multiple of element_size
+ * @param[in]  element_size Size of one element in bytes
+ */
+void shuffle_bytes(const uint8_t *src, uint8_t *dst, size_t size,
+                   size_t element_size);
+
+/**
+ * @brief     Compress an image, with byte-plane shuffling of its elements
+ *
+ * @param[in] raw          Raw image data
+ * @param[in] codec        Codec to use
+ * @param[in] element_size Size of one channel value in bytes
+ */
+encoded_frame encode_frame(std::vector<uint8_t> raw, frame_codec codec,
+                           size_t element_size);
+
+/// Compress an image kept by the caller, e.g. a mapped stored frame
+encoded_frame encode_frame(const uint8_t *raw, size_t size, frame_codec codec,
+                           size_t element_size);
+}  // namespace net
+
+#endif /* _NET_FRAME_CODEC_HPP_ */
@@ -0,0 +1,88 @@
+#ifndef _NET_FRAME_RING_HPP_
+#define _NET_FRAME_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace net {
+/// Header at the start of the shared memory object of a frame_ring
+struct frame_ring_header {
+    uint32_t magic;
+    uint32_t slot_count;
+    uint64_t slot_size;
+    /// Offset of the data of slot 0, slot i starts slot_size bytes further
+    uint64_t data_offset;
+};
+
+/// State of a slot, following the ring header
+struct frame_slot_header {
+    /// Sequence number of the frame in the slot, 0 while it is written
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+    /// Size of the frame in bytes
+    uint64_t size;
+};
+
+/**
+ * @brief Ring of frame slots in a POSIX shared memory object
+ *
+ * getframe results are written to the next slot in turn, and the reply only
+ * gives the slot index and the sequence number of the frame. Local clients
+ * map the object once and read frames in place. A slot is overwritten after
+ * as many frames as there are slots: a frame is intact if the sequence
+ * number of its slot still matches the reply after it has been read. As in a
+ * seqlock, readers need an acquire fence between reading the frame and
+ * loading the sequence number again, or the load may happen before the reads.
+ */
+class frame_ring {
+    std::string name_;
+    size_t slot_count_;
+    size_t slot_size_;
+    size_t length_;
+    uint8_t *addr_;
+    /// Next slot to write
+    std::atomic<size_t> next_;
+    /// Last sequence number given to a frame
+    std::atomic<uint32_t> seq_;
+
+    inline frame_ring_header &header() const
+    { return *reinterpret_cast<frame_ring_header *>(addr_); }
+
+    inline frame_slot_header &slot_header(size_t index) const {
+        return reinterpret_cast<frame_slot_header *>(
+            addr_ + sizeof(frame_ring_header))[index];
+    }
+
+   public:
+    /**
+     * @brief     Create the shared memory object
+     *
+     * @param[in] name       Name of the object, starting with a slash
+     * @param[in] slot_count Number of slots
+     * @param[in] slot_size  Size of each slot in bytes, rounded up to pages
+     */
+    frame_ring(const std::string &name, size_t slot_count, size_t slot_size);
+    ~frame_ring();
+
+    frame_ring(const frame_ring &) = delete;
+    frame_ring &operator=(const frame_ring &) = delete;
+
+    inline const std::string &name() const { return name_; }
+    inline size_t slot_count() const { return slot_count_; }
+    inline size_t slot_size() const { return slot_size_; }
+    inline size_t data_offset() const { return header().data_offset; }
+
+    /// Take the next slot for writing, the frame it held is invalidated
+    size_t acquire();
+
+    inline uint8_t *data(size_t index) const
+    { return addr_ + data_offset() + index * slot_size_; }
+
+    /// Publish the frame written to a slot, returns its sequence number
+    uint32_t publish(size_t index, size_t size);
+};
+}  // namespace net
+
+#endif /* _NET_FRAME_RING_HPP_ */
@@ -0,0 +1,94 @@
+#ifndef _NET_FRAME_STORE_HPP_
+#define _NET_FRAME_STORE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "directory_cache.hpp"
+
+namespace net {
+/// Header of the files of the frame store, followed by the frame data
+struct stored_frame_header {
+    uint32_t magic;
+    /// Sized format reported to the client, see frame_formats
+    uint32_t format;
+    uint64_t key;
+    int32_t width;
+    int32_t height;
+    uint32_t element_size;
+    uint32_t samples;
+    /// Size of the frame data in bytes
+    uint64_t size;
+};
+
+/// Stored frame mapped in memory, unmapped when the last reference goes
+class mapped_frame {
+    void *addr_;
+    size_t length_;
+
+   public:
+    mapped_frame(void *addr, size_t length);
+    ~mapped_frame();
+
+    mapped_frame(const mapped_frame &) = delete;
+    mapped_frame &operator=(const mapped_frame &) = delete;
+
+    inline const stored_frame_header &header() const
+    { return *reinterpret_cast<const stored_frame_header *>(addr_); }
+
+    inline const uint8_t *data() const {
+        return reinterpret_cast<const uint8_t *>(addr_) +
+               sizeof(stored_frame_header);
+    }
+};
+
+/**
+ * @brief On-disk cache of getframe results, shared across runs
+ *
+ * Frames are stored uncompressed in a directory_cache, one file per key, and
+ * served by mapping their file. Keys are content_hash values of the render
+ * state, so they stay valid when the viewer restarts. Viewers may share a
+ * directory. Thread-safe.
+ */
+class frame_store {
+   public:
+    struct store_stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stores;
+        uint64_t evictions;
+        /// Total size of the stored frames in bytes
+        uint64_t size;
+        uint64_t files;
+    };
+
+    /**
+     * @brief     Open a frame store
+     *
+     * @param[in] dir    Directory of the frames, created if needed
+     * @param[in] budget Size limit of the stored frames in bytes
+     */
+    frame_store(const std::string &dir, size_t budget);
+
+    /// Mapped frame of the given key, or null
+    std::shared_ptr<const mapped_frame> find(uint64_t key);
+
+    /// Write a frame, the magic of the header is set by the store
+    void store(stored_frame_header header, const uint8_t *data);
+
+    store_stats stats() const;
+
+    inline size_t budget() const { return files_.budget(); }
+
+   private:
+    directory_cache files_;
+
+    /// Guards the hit, miss and store counters
+    mutable std::mutex mutex_;
+    store_stats counters_;
+};
+}  // namespace net
+
+#endif /* _NET_FRAME_STORE_HPP_ */
@@ -1,6 +1,7 @@
 #ifndef _NET_SERVER_HPP_
 #define _NET_SERVER_HPP_
 
+#include <functional>
 #include <memory>
 
 #include "options.hpp"
@@ -21,6 +22,10 @@ struct viewer_state;
 #define CMD_NAME_GEOMETRY "geometry"
 #define CMD_NAME_LOADDEFAULTS "loaddefaults"
 #define CMD_NAME_SETINPUT "setinput"
+#define CMD_NAME_GETSTATS "getstats"
+#define CMD_NAME_GETTILE "gettile"
+#define CMD_NAME_GETNOISESTATS "getnoisestats"
+#define CMD_NAME_GETSHM "getshm"
 
 namespace net {
 class server_impl;
@@ -29,38 +34,26 @@ class server {
     const server_options &opt_;
     std::unique_ptr<server_impl> impl_;
 
-    void handle_getframe(gl_state &gl_state, int revision, const std::string &target) const;
-
-    void handle_getparams(gl_state &gl_state, int revision) const;
-
-    void handle_getparam(gl_state &gl_state, int revision) const;
-
-    void handle_setparam(gl_state &gl_state, int revision, bool &changed_state) const;
-
-    void handle_getcamera(viewer_state &state) const;
-
-    void handle_setcamera(viewer_state &state, bool &changed_state) const;
-
-    void handle_getrotation(viewer_state &state) const;
-
-    void handle_setrotation(viewer_state &state, bool &changed_state) const;
-
-    void handle_getscale(viewer_state &state) const;
-
-    void handle_setscale(viewer_state &state, bool &changed_state) const;
-
-    void handle_geometry(gl_state &gl_state, viewer_state &state, bool &changed_state) const;
-
-    void handle_loaddefaults(gl_state &gl_state, bool &changed_state) const;
-
-    void handle_setinput(gl_state &gl_state, bool &changed_state) const;
-
    public:
-    server(const server_options &opt, const log_options &log_opt);
+    /**
+     * @brief     Start the network thread serving requests
+     *
+     * @param[in] opt     Server options
+     * @param[in] log_opt Logging options
+     * @param[in] wake    Called from the network thread when requests are
+     *                    queued, to wake up the render thread
+     */
+    server(const server_options &opt, const log_options &log_opt,
+           std::function<void()> wake);
     // non-trivial destructor because of pimpl
     ~server();
 
+    /// Apply the queued requests on the render thread, returns true if a new
+    /// frame must be rendered
     bool poll(viewer_state &state, gl_state &gl_state, int revision) const;
+
+    /// true if requests are waiting for poll
+    bool has_work() const;
 };
 }  // namespace net
 
@@ -0,0 +1,82 @@
+#ifndef _NOISE_GABOR_HPP_
+#define _NOISE_GABOR_HPP_
+
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace noise {
+/// Variants of eb() in gabor/kernel.glsl
+enum class gabor_envelope {
+    gaussian,
+    trunc,
+    kaiser,
+};
+
+/// Generators in src/glsl/prng
+enum class prng_type {
+    hash,
+    lcg,
+    xorshift,
+    xoroshiro,
+    none,
+};
+
+/// Parameters of gabor-noise-solid.glsl
+struct gabor_params {
+    /// gSplats, mean number of splats per cell
+    int splats;
+    /// gF0, kernel frequency
+    float f0;
+    /// gW0, base orientation angles in radians
+    glm::vec2 w0;
+    /// gLobes, number of orientation lobes
+    int lobes;
+    /// gTilesize, size of a grid cell
+    float tile_size;
+    /// aSigma, width of the prefiltering
+    float sigma;
+    /// dQuad, use a 2D grid
+    bool quad;
+
+    // Template choices of the shader
+    gabor_envelope envelope;
+    prng_type prng;
+    /// white_poisson, draw the number of splats per cell
+    bool poisson_splats;
+    int random_seed;
+
+    /// bboxMin and bboxMax, set by the loaded geometry
+    glm::vec3 bbox_min;
+    glm::vec3 bbox_max;
+
+    /// Defaults of gabor-noise-solid.glsl rendered as a quad
+    gabor_params();
+
+    /// Number of cells of the grid, count in cgaborCell
+    glm::ivec3 tile_count() const;
+};
+
+/**
+ * @brief     Evaluate Gabor noise over a quad on the CPU
+ *
+ * The result matches the color output of the geometry pass of
+ * gabor-noise-solid.glsl rendered with dQuad, without the debug grid overlay.
+ * Pixels are evaluated four at a time using SIMD where available, and tiles
+ * of the image are split across worker threads.
+ *
+ * @param[in]  params Noise parameters
+ * @param[in]  width  Image width
+ * @param[in]  height Image height
+ * @param[out] pixels RGBA values, width * height * 4 floats, bottom row first
+ *                    as returned by getframe
+ */
+void render_gabor(const gabor_params &params, int width, int height,
+                  float *pixels);
+
+std::vector<float> render_gabor(const gabor_params &params, int width,
+                                int height);
+}  // namespace noise
+
+#endif /* _NOISE_GABOR_HPP_ */
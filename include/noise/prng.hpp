@@ -0,0 +1,279 @@
+#ifndef _NOISE_PRNG_HPP_
+#define _NOISE_PRNG_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/**
+ * Host-side ports of the generators in src/glsl/prng and of the cell point
+ * generator in src/glsl/pg/3d/white.glsl. The integer streams match the
+ * shaders bit for bit; float conversions use the same expressions.
+ *
+ * Generators are written once over a lane type U, either uint32_t or one of
+ * the SIMD types of noise/prng_batch.hpp, and operate on a state of
+ * state_size values of U.
+ */
+namespace noise {
+/// M_PI in core/math.glsl, which GLSL reads as a float literal
+const float pi = 3.141592653589793f;
+
+template <int K>
+inline uint32_t shl(uint32_t x) {
+    return x << K;
+}
+
+template <int K>
+inline uint32_t shr(uint32_t x) {
+    return x >> K;
+}
+
+/// Integer to float in [0, 1], as `u / float(4294967295u)`
+inline float unorm(uint32_t u) { return float(u) / float(4294967295u); }
+
+/// Integer to a dyadic rational in [0, 1), tofloat in prng/xoroshiro.glsl
+inline float tofloat(uint32_t u) {
+    uint32_t bits = 0x7fu << 23 | u >> 9;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f - 1.f;
+}
+
+template <int K, typename U>
+inline U rotl(U x) {
+    return shl<K>(x) | shr<32 - K>(x);
+}
+
+/// Wang hash, hash4 in core/hash.glsl
+template <typename U>
+inline U hash(U x) {
+    x = (x ^ U(61u)) ^ shr<16>(x);
+    x = x * U(9u);
+    x = x ^ shr<4>(x);
+    x = x * U(0x27d4eb2du);
+    x = x ^ shr<15>(x);
+    return x;
+}
+
+/// prng/hash.glsl
+template <typename U>
+struct hash_gen {
+    static const int state_size = 2;
+
+    static void seed(U *s, U seed) {
+        s[0] = hash(seed);
+        s[1] = U(0u);
+    }
+
+    static auto rand1(U *s) {
+        s[1] = s[1] + U(1u);
+        return unorm(hash(s[0] ^ shl<8>(s[1])));
+    }
+
+    template <typename F>
+    static void rand2(U *s, F &x, F &y) {
+        x = rand1(s);
+        y = rand1(s);
+    }
+};
+
+/// prng/lcg.glsl
+template <typename U>
+struct lcg_gen {
+    static const int state_size = 1;
+
+    static void seed(U *s, U seed) { s[0] = hash(seed); }
+
+    static auto rand1(U *s) {
+        s[0] = s[0] * U(3039177861u);
+        return unorm(s[0]);
+    }
+
+    template <typename F>
+    static void rand2(U *s, F &x, F &y) {
+        x = rand1(s);
+        y = rand1(s);
+    }
+};
+
+/// prng/xorshift.glsl
+template <typename U>
+struct xorshift_gen {
+    static const int state_size = 2;
+
+    static void seed(U *s, U seed) {
+        s[0] = hash(shl<1>(seed));
+        s[1] = hash(shl<1>(seed) | U(1u));
+    }
+
+    static void next(U *s) {
+        U t = s[0] ^ shl<23>(s[0]);
+        s[0] = s[1];
+        s[1] = (s[1] ^ shr<24>(s[1])) ^ (t ^ shr<3>(t));
+    }
+
+    static auto rand1(U *s) {
+        next(s);
+        return unorm(s[1]);
+    }
+
+    template <typename F>
+    static void rand2(U *s, F &x, F &y) {
+        next(s);
+        x = unorm(s[0]);
+        y = unorm(s[1]);
+    }
+};
+
+/// prng/xoroshiro.glsl, two xoroshiro64* streams
+template <typename U>
+struct xoroshiro_gen {
+    static const int state_size = 4;
+
+    static void seed(U *s, U seed) {
+        s[0] = hash(shl<2>(seed));
+        s[1] = hash(shl<2>(seed) | U(1u));
+        s[2] = hash(shl<2>(seed) | U(2u));
+        s[3] = hash(shl<2>(seed) | U(3u));
+    }
+
+    /// next() on the (s[0], s[1]) pair
+    static U next(U *s) {
+        U s0 = s[0];
+        U s1 = s[1];
+        U rs = rotl<5>(s0 * U(0x9E3779BBu)) * U(5u);
+
+        s1 = s1 ^ s0;
+        s[0] = rotl<26>(s0) ^ s1 ^ shl<9>(s1);
+        s[1] = rotl<13>(s1);
+
+        return rs;
+    }
+
+    static auto rand1(U *s) { return tofloat(next(s)); }
+
+    /// next2() advances the xy and zw streams together
+    template <typename F>
+    static void rand2(U *s, F &x, F &y) {
+        x = tofloat(next(s));
+        y = tofloat(next(s + 2));
+    }
+};
+
+/// prng/none.glsl
+template <typename U>
+struct none_gen {
+    static const int state_size = 1;
+
+    static void seed(U *s, U) { s[0] = U(0u); }
+
+    static auto rand1(U *) { return decltype(unorm(U(0u)))(0.f); }
+
+    template <typename F>
+    static void rand2(U *, F &x, F &y) {
+        x = F(0.f);
+        y = F(0.f);
+    }
+};
+
+/// Single generator, prng_state in the shaders
+template <template <typename> class Gen>
+class prng {
+    typedef Gen<uint32_t> gen;
+
+    uint32_t s_[gen::state_size];
+
+   public:
+    explicit prng(uint32_t seed) { gen::seed(s_, seed); }
+
+    float rand1() { return gen::rand1(s_); }
+
+    glm::vec2 rand2() {
+        float x, y;
+        gen::rand2(s_, x, y);
+        return glm::vec2(x, y);
+    }
+};
+
+typedef prng<hash_gen> hash_prng;
+typedef prng<lcg_gen> lcg_prng;
+typedef prng<xorshift_gen> xorshift_prng;
+typedef prng<xoroshiro_gen> xoroshiro_prng;
+typedef prng<none_gen> none_prng;
+
+/// prng_poisson in prng/poisson.glsl
+template <typename Prng>
+int poisson(Prng &prng, float mean) {
+    int em = 0;
+
+    if (mean < 45.f) {
+        // Knuth
+        float g = std::exp(-mean);
+        float t = prng.rand1();
+        while (t > g) {
+            ++em;
+            t *= prng.rand1();
+        }
+    } else {
+        // Gaussian approximation
+        glm::vec2 u = prng.rand2();
+        float v = std::sqrt(-2.f * std::log(u.x)) * std::cos(2.f * pi * u.y);
+        em = int((v * std::sqrt(mean)) + mean + .5f);
+    }
+
+    return em;
+}
+
+template <>
+inline int poisson(none_prng &, float mean) {
+    return int(mean + .5f);
+}
+
+/// Cell point generator of pg/3d/white.glsl
+template <typename Prng>
+class white_points {
+    Prng state_;
+    int splats_;
+
+    static uint32_t cell_seed(const glm::ivec3 &nc, const glm::ivec3 &count,
+                              int random_seed) {
+        // Same wrap-around as the int arithmetic of the shader
+        return uint32_t(nc.z) * uint32_t(count.x) * uint32_t(count.y) +
+               uint32_t(nc.y) * uint32_t(count.x) + uint32_t(nc.x) +
+               uint32_t(random_seed);
+    }
+
+   public:
+    /**
+     * @brief     Seed the generator of a cell, pg_seed
+     *
+     * @param[in] nc              Cell coordinates
+     * @param[in] tile_count      Number of cells of the grid
+     * @param[in] random_seed     Seed of the noise
+     * @param[in] expected_splats Mean number of points per cell
+     * @param[in] poisson_splats  Draw the number of points from a Poisson
+     *                            distribution, white_poisson in the shader
+     */
+    white_points(const glm::ivec3 &nc, const glm::ivec3 &tile_count,
+                 int random_seed, int expected_splats, bool poisson_splats)
+        : state_(cell_seed(nc, tile_count, random_seed)),
+          splats_(expected_splats) {
+        if (poisson_splats) splats_ = poisson(state_, float(expected_splats));
+    }
+
+    int splats() const { return splats_; }
+
+    /// Next point in [-1, 1]^4, pg_point4
+    glm::vec4 point4() {
+        glm::vec2 xy = 2.f * state_.rand2() - 1.f;
+        glm::vec2 zw = 2.f * state_.rand2() - 1.f;
+        return glm::vec4(xy.x, xy.y, zw.x, zw.y);
+    }
+};
+}  // namespace noise
+
+#endif /* _NOISE_PRNG_HPP_ */
@@ -0,0 +1,295 @@
+#ifndef _NOISE_PRNG_BATCH_HPP_
+#define _NOISE_PRNG_BATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "noise/prng.hpp"
+
+namespace noise {
+#if defined(__AVX2__)
+struct u32_lanes {
+    static const size_t width = 8;
+
+    __m256i v;
+
+    u32_lanes() = default;
+    u32_lanes(__m256i v) : v(v) {}
+    u32_lanes(uint32_t s) : v(_mm256_set1_epi32(int(s))) {}
+
+    static u32_lanes load(const uint32_t *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+
+    void store(uint32_t *p) const {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+};
+
+struct f32_lanes {
+    __m256 v;
+
+    f32_lanes() : v(_mm256_setzero_ps()) {}
+    f32_lanes(__m256 v) : v(v) {}
+    f32_lanes(float s) : v(_mm256_set1_ps(s)) {}
+
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline u32_lanes operator^(u32_lanes a, u32_lanes b) {
+    return _mm256_xor_si256(a.v, b.v);
+}
+
+inline u32_lanes operator|(u32_lanes a, u32_lanes b) {
+    return _mm256_or_si256(a.v, b.v);
+}
+
+inline u32_lanes operator+(u32_lanes a, u32_lanes b) {
+    return _mm256_add_epi32(a.v, b.v);
+}
+
+inline u32_lanes operator*(u32_lanes a, u32_lanes b) {
+    return _mm256_mullo_epi32(a.v, b.v);
+}
+
+template <int K>
+inline u32_lanes shl(u32_lanes x) {
+    return _mm256_slli_epi32(x.v, K);
+}
+
+template <int K>
+inline u32_lanes shr(u32_lanes x) {
+    return _mm256_srli_epi32(x.v, K);
+}
+
+inline f32_lanes unorm(u32_lanes u) {
+    // No unsigned conversion before AVX-512, both halves are exact and the
+    // sum is rounded once, as float(u)
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(u.v, 16));
+    __m256 lo = _mm256_cvtepi32_ps(
+        _mm256_and_si256(u.v, _mm256_set1_epi32(0xffff)));
+    __m256 f = _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.f)), lo);
+
+    // Exact, the divisor is a power of two
+    return _mm256_mul_ps(f, _mm256_set1_ps(1.f / 4294967296.f));
+}
+
+inline f32_lanes tofloat(u32_lanes u) {
+    __m256i bits = _mm256_or_si256(_mm256_set1_epi32(0x7f << 23),
+                                   _mm256_srli_epi32(u.v, 9));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.f));
+}
+#elif defined(__ARM_NEON)
+struct u32_lanes {
+    static const size_t width = 4;
+
+    uint32x4_t v;
+
+    u32_lanes() = default;
+    u32_lanes(uint32x4_t v) : v(v) {}
+    u32_lanes(uint32_t s) : v(vdupq_n_u32(s)) {}
+
+    static u32_lanes load(const uint32_t *p) { return vld1q_u32(p); }
+
+    void store(uint32_t *p) const { vst1q_u32(p, v); }
+};
+
+struct f32_lanes {
+    float32x4_t v;
+
+    f32_lanes() : v(vdupq_n_f32(0.f)) {}
+    f32_lanes(float32x4_t v) : v(v) {}
+    f32_lanes(float s) : v(vdupq_n_f32(s)) {}
+
+    void store(float *p) const { vst1q_f32(p, v); }
+};
+
+inline u32_lanes operator^(u32_lanes a, u32_lanes b) {
+    return veorq_u32(a.v, b.v);
+}
+
+inline u32_lanes operator|(u32_lanes a, u32_lanes b) {
+    return vorrq_u32(a.v, b.v);
+}
+
+inline u32_lanes operator+(u32_lanes a, u32_lanes b) {
+    return vaddq_u32(a.v, b.v);
+}
+
+inline u32_lanes operator*(u32_lanes a, u32_lanes b) {
+    return vmulq_u32(a.v, b.v);
+}
+
+template <int K>
+inline u32_lanes shl(u32_lanes x) {
+    return vshlq_n_u32(x.v, K);
+}
+
+template <int K>
+inline u32_lanes shr(u32_lanes x) {
+    return vshrq_n_u32(x.v, K);
+}
+
+inline f32_lanes unorm(u32_lanes u) {
+    // Exact, the divisor is a power of two
+    return vmulq_n_f32(vcvtq_f32_u32(u.v), 1.f / 4294967296.f);
+}
+
+inline f32_lanes tofloat(u32_lanes u) {
+    uint32x4_t bits = vorrq_u32(vdupq_n_u32(0x7fu << 23), vshrq_n_u32(u.v, 9));
+    return vsubq_f32(vreinterpretq_f32_u32(bits), vdupq_n_f32(1.f));
+}
+#endif
+
+/// Generators advanced together by prng_batch, 1 without SIMD support
+#if defined(__AVX2__) || defined(__ARM_NEON)
+const size_t batch_lanes = u32_lanes::width;
+#else
+const size_t batch_lanes = 1;
+#endif
+
+/**
+ * @brief Many independent generators advanced together
+ *
+ * Generator i is seeded with seeds[i], like one invocation of a shader
+ * calling prng_seed. Each call draws one value from every generator,
+ * batch_lanes generators at a time, so the stream of generator i is the one
+ * the shader would see for the same sequence of calls. The AVX2 path is only
+ * built with the MVW_AVX2 CMake option.
+ */
+template <template <typename> class Gen>
+class prng_batch {
+    static const size_t state_size = Gen<uint32_t>::state_size;
+
+    size_t count_;
+    /// State of all generators, one plane per state value
+    std::vector<uint32_t> state_;
+
+    /// Advance each generator, as many as possible with the lanes function
+    template <typename Lanes, typename Scalar>
+    void apply(Lanes lanes, Scalar scalar) {
+        size_t i = 0;
+
+#if defined(__AVX2__) || defined(__ARM_NEON)
+        for (; i + u32_lanes::width <= count_; i += u32_lanes::width) {
+            u32_lanes s[state_size];
+            for (size_t k = 0; k < state_size; ++k)
+                s[k] = u32_lanes::load(&state_[k * count_ + i]);
+
+            lanes(s, i);
+
+            for (size_t k = 0; k < state_size; ++k)
+                s[k].store(&state_[k * count_ + i]);
+        }
+#endif
+
+        for (; i < count_; ++i) {
+            uint32_t s[state_size];
+            for (size_t k = 0; k < state_size; ++k)
+                s[k] = state_[k * count_ + i];
+
+            scalar(s, i);
+
+            for (size_t k = 0; k < state_size; ++k)
+                state_[k * count_ + i] = s[k];
+        }
+    }
+
+   public:
+    prng_batch(const uint32_t *seeds, size_t count)
+        : count_(count), state_(state_size * count) {
+        apply(
+            [&](auto *s, size_t i) {
+                typedef std::remove_pointer_t<decltype(s)> U;
+                Gen<U>::seed(s, U::load(seeds + i));
+            },
+            [&](uint32_t *s, size_t i) { Gen<uint32_t>::seed(s, seeds[i]); });
+    }
+
+    size_t size() const { return count_; }
+
+    /// prng_rand1, out[i] for generator i
+    void rand1(float *out) {
+        apply(
+            [&](auto *s, size_t i) {
+                typedef std::remove_pointer_t<decltype(s)> U;
+                Gen<U>::rand1(s).store(out + i);
+            },
+            [&](uint32_t *s, size_t i) { out[i] = Gen<uint32_t>::rand1(s); });
+    }
+
+    /// prng_rand2, out[2 * i] and out[2 * i + 1] for generator i
+    void rand2(float *out) {
+        apply(
+            [&](auto *s, size_t i) {
+                typedef std::remove_pointer_t<decltype(s)> U;
+                decltype(unorm(U(0u))) x, y;
+                Gen<U>::rand2(s, x, y);
+
+                alignas(32) float xs[U::width], ys[U::width];
+                x.store(xs);
+                y.store(ys);
+
+                for (size_t l = 0; l < U::width; ++l) {
+                    out[2 * (i + l)] = xs[l];
+                    out[2 * (i + l) + 1] = ys[l];
+                }
+            },
+            [&](uint32_t *s, size_t i) {
+                Gen<uint32_t>::rand2(s, out[2 * i], out[2 * i + 1]);
+            });
+    }
+
+    /// prng_poisson, out[i] for generator i. The number of draws depends on
+    /// the values, so generators are advanced one at a time.
+    void poisson(float mean, int *out) {
+        for (size_t i = 0; i < count_; ++i) {
+            single_view view(this, i);
+            out[i] = noise::poisson(view, mean);
+            view.store();
+        }
+    }
+
+   private:
+    /// Scalar generator on the state of generator i
+    class single_view {
+        prng_batch *batch_;
+        size_t i_;
+        uint32_t s_[state_size];
+
+       public:
+        single_view(prng_batch *batch, size_t i) : batch_(batch), i_(i) {
+            for (size_t k = 0; k < state_size; ++k)
+                s_[k] = batch_->state_[k * batch_->count_ + i_];
+        }
+
+        void store() {
+            for (size_t k = 0; k < state_size; ++k)
+                batch_->state_[k * batch_->count_ + i_] = s_[k];
+        }
+
+        float rand1() { return Gen<uint32_t>::rand1(s_); }
+
+        glm::vec2 rand2() {
+            float x, y;
+            Gen<uint32_t>::rand2(s_, x, y);
+            return glm::vec2(x, y);
+        }
+    };
+};
+
+template <>
+inline void prng_batch<none_gen>::poisson(float mean, int *out) {
+    for (size_t i = 0; i < count_; ++i) out[i] = int(mean + .5f);
+}
+}  // namespace noise
+
+#endif /* _NOISE_PRNG_BATCH_HPP_ */
@@ -0,0 +1,41 @@
+#ifndef _NOISE_SPLAT_TABLE_HPP_
+#define _NOISE_SPLAT_TABLE_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+namespace noise {
+/// Contents of a data input read by pg/3d/data.glsl
+struct splat_table {
+    /// RGBA values, one row per cell
+    std::vector<float> data;
+    /// Width, height and channel count, as for setinput
+    std::array<uint32_t, 3> dims;
+};
+
+/**
+ * @brief     Build the point table of every cell of a grid
+ *
+ * Row r holds the points of the cell of index r, in the order pg_point4
+ * reads them, two per splat. Each row is drawn from the xoroshiro generator
+ * seeded as pg/3d/white.glsl seeds the same cell. Switching a shader that
+ * uses the xoroshiro prng, without white_poisson, from the white to the data
+ * point generator thus renders the same splats in the cells of the grid, but
+ * not in their neighbors outside of it, which pg/3d/data.glsl wraps around.
+ * Rows are filled by batches of generators split across worker threads.
+ *
+ * @param[in] tile_count  Number of cells of the grid, a zero count along an
+ *                        axis is one layer of cells
+ * @param[in] random_seed Seed of the noise
+ * @param[in] splats      Number of splats per cell
+ *
+ * @return Table to upload as the pointData input
+ */
+splat_table make_splat_table(const glm::ivec3 &tile_count, int random_seed,
+                             int splats);
+}  // namespace noise
+
+#endif /* _NOISE_SPLAT_TABLE_HPP_ */
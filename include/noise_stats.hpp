@@ -0,0 +1,84 @@
+#ifndef _NOISE_STATS_HPP_
+#define _NOISE_STATS_HPP_
+
+#include <epoxy/gl.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include <shadertoy/backends/gx/texture.hpp>
+
+/// Statistics requested from noise_stats_reducer::reduce
+struct noise_stats_options {
+    /// Channel of the histogram and of the spectrum
+    int channel;
+    /// Number of histogram bins, 0 to skip the histogram
+    int bins;
+    /// Values mapped to the first and last bins, other values are clamped
+    glm::vec2 range;
+    /// Number of radial bands of the power spectrum, 0 to skip it
+    int spectrum_bins;
+};
+
+/// Named statistics, each a list of values
+typedef std::map<std::string, std::vector<double>> noise_stats;
+
+/**
+ * @brief Statistics of render outputs computed by compute shaders
+ *
+ * Only the reduced values are read back: the pixel count, and the mean,
+ * variance, min and max of each channel, followed by the requested
+ * histogram and radial power spectrum. Programs are compiled on first use,
+ * which requires a current OpenGL context.
+ */
+class noise_stats_reducer {
+    GLuint moments_program_;
+    GLuint reduce_program_;
+    /// FFT programs by transform size
+    std::map<int, GLuint> fft_rows_programs_;
+    std::map<int, GLuint> fft_columns_programs_;
+
+    /// Partials, Result, Transform and Spectrum buffers
+    GLuint buffers_[4];
+
+    GLuint make_program(const std::string &defines);
+
+   public:
+    /// Largest histogram and spectrum sizes, MAX_BINS and MAX_SPECTRUM_BINS
+    /// in noise-stats.glsl
+    static const int max_bins = 2048;
+    static const int max_spectrum_bins = 1024;
+    /// Largest image side for the spectrum, limited by the work group size
+    static const int max_spectrum_size = 2048;
+
+    noise_stats_reducer();
+    ~noise_stats_reducer();
+
+    noise_stats_reducer(const noise_stats_reducer &) = delete;
+    noise_stats_reducer &operator=(const noise_stats_reducer &) = delete;
+
+    /**
+     * @brief     Compute statistics of a texture
+     *
+     * Entries are "count", "mean", "variance", "min" and "max", plus
+     * "histogram" with the number of pixels of each bin and "spectrum" with
+     * the power of each radial frequency band, from 0 to the Nyquist
+     * frequency, if requested. The mean of the channel is removed before the
+     * transform, so the bands add up to its variance minus the power of the
+     * frequencies beyond the Nyquist radius.
+     *
+     * @param[in] texture Texture to reduce, its first level is read
+     * @param[in] opt     Requested statistics
+     *
+     * @throws std::runtime_error if the options are invalid, or if a
+     *         spectrum is requested for an image whose sides are not powers
+     *         of two up to max_spectrum_size
+     */
+    noise_stats reduce(shadertoy::backends::gx::texture &texture,
+                       const noise_stats_options &opt);
+};
+
+#endif /* _NOISE_STATS_HPP_ */
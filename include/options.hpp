@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 struct shader_file_program {
     std::string path;
@@ -26,6 +27,11 @@ struct shader_file_program {
 struct shader_program_options {
     shader_file_program shader;
     shader_file_program postprocess;
+    /// Paths of the compute passes run before postprocessing, in order
+    std::vector<std::string> compute;
+    /// Paths of the postprocessing passes run before the postprocess shader,
+    /// ordered by their bindings
+    std::vector<std::string> passes;
 
     bool use_make;
 };
@@ -47,15 +53,30 @@ struct geometry_options {
 struct frame_options {
     int width;
     int height;
+    bool fit_oriented_bounds;
+    int texture_pool_mb;
+    /// Frame rate cap, 0 for none
+    int max_fps;
 };
 
 struct server_options {
     std::string bind_addr;
+    /// Number of getframe results kept on the GPU, 0 to disable the cache
+    int frame_cache;
+    /// Directory of the on-disk getframe cache, empty to disable it
+    std::string frame_store_dir;
+    /// Size limit of the on-disk cache in MB
+    int frame_store_mb;
+    /// Number of slots of the shared memory frame ring, 0 to disable it
+    int shm_frames;
+    /// Size of each slot of the frame ring in MB
+    int shm_slot_mb;
 };
 
 struct log_options {
     bool debug;
     bool verbose;
+    std::string trace_path;
 };
 
 struct viewer_options {
@@ -65,6 +86,10 @@ struct viewer_options {
     server_options server;
     log_options log;
     bool headless_mode;
+    /// Directory of the program binary cache, empty to disable it
+    std::string program_cache_dir;
+    /// Size limit of the program binary cache in MB
+    int program_cache_mb;
 };
 
 #endif /* _OPTIONS_HPP_ */
@@ -0,0 +1,48 @@
+#ifndef _PARALLEL_FOR_HPP_
+#define _PARALLEL_FOR_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief     Call body(state, i) for every i in [0, count), on worker threads
+ *            and the calling thread
+ *
+ * Indices are taken one at a time, so tasks of uneven cost stay balanced.
+ * Every thread owns a default-constructed State, for its scratch buffers or
+ * its part of a reduction.
+ *
+ * @param[in] count Number of tasks
+ * @param[in] body  Task function
+ *
+ * @return    The states of the threads, the one of the calling thread first
+ */
+template <typename State, typename Body>
+std::vector<State> parallel_for(size_t count, Body body) {
+    size_t workers = std::max<size_t>(
+        1, std::min<size_t>(count, std::thread::hardware_concurrency()));
+
+    std::vector<State> states(workers);
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](State &state) {
+        for (size_t i; (i = next++) < count;) body(state, i);
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t w = 1; w < workers; ++w)
+        futures.emplace_back(
+            std::async(std::launch::async, worker, std::ref(states[w])));
+
+    worker(states[0]);
+    for (auto &future : futures) future.get();
+
+    return states;
+}
+
+#endif /* _PARALLEL_FOR_HPP_ */
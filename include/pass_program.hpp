@@ -0,0 +1,121 @@
+#ifndef _PASS_PROGRAM_HPP_
+#define _PASS_PROGRAM_HPP_
+
+#include <epoxy/gl.h>
+
+#include <shadertoy.hpp>
+
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "discovered_bindings.hpp"
+#include "discovered_uniform.hpp"
+
+/// Value of a pass uniform: the types of discovered uniforms, and the
+/// matrices set by the viewer
+typedef std::variant<float, glm::vec2, glm::vec3, glm::vec4, int, glm::ivec2,
+                     glm::ivec3, glm::ivec4, bool, glm::bvec2, glm::bvec3,
+                     glm::bvec4, glm::mat4>
+    uniform_value;
+
+/// glProgramUniform for the types given to chain_instance::set_uniform
+void apply_uniform(GLuint program, GLint location, float value);
+void apply_uniform(GLuint program, GLint location, const glm::vec2 &value);
+void apply_uniform(GLuint program, GLint location, const glm::vec3 &value);
+void apply_uniform(GLuint program, GLint location, const glm::vec4 &value);
+void apply_uniform(GLuint program, GLint location, int value);
+void apply_uniform(GLuint program, GLint location, const glm::ivec2 &value);
+void apply_uniform(GLuint program, GLint location, const glm::ivec3 &value);
+void apply_uniform(GLuint program, GLint location, const glm::ivec4 &value);
+void apply_uniform(GLuint program, GLint location, bool value);
+void apply_uniform(GLuint program, GLint location, const glm::bvec2 &value);
+void apply_uniform(GLuint program, GLint location, const glm::bvec3 &value);
+void apply_uniform(GLuint program, GLint location, const glm::bvec4 &value);
+void apply_uniform(GLuint program, GLint location, const glm::mat4 &value);
+void apply_uniform(GLuint program, GLint location, const uniform_value &value);
+
+/**
+ * @brief     Parse a uniform directive of a pass source
+ *
+ * Passes often share includes, such as pp/lighting.glsl, so the uniform is
+ * only appended if no other stage declared it.
+ *
+ * @return true if the line declares a uniform
+ */
+bool try_parse_pass_uniform(const std::string &line,
+                            std::vector<discovered_uniform> &uniforms);
+
+/// Shader of a pass program, from the concatenation of its sources
+struct pass_shader {
+    GLenum type;
+    std::vector<const char *> sources;
+};
+
+/**
+ * @brief Program of a compute or postprocessing pass
+ *
+ * Uniforms keep their last value, which is applied when it is set and again
+ * when the program is linked. Their locations are only looked up when they
+ * are first set or when the program is linked.
+ */
+class pass_program {
+    GLuint program_;
+    GLint resolution_location_;
+
+    struct uniform_slot {
+        GLint location;
+        uniform_value value;
+    };
+
+    std::map<std::string, uniform_slot> uniforms_;
+
+    GLint location(const std::string &name) const;
+
+   public:
+    pass_program();
+    ~pass_program();
+
+    pass_program(const pass_program &) = delete;
+    pass_program &operator=(const pass_program &) = delete;
+
+    inline GLuint get() const { return program_; }
+
+    inline bool linked() const { return program_ != 0; }
+
+    /**
+     * @brief     Compile the shaders and link them through the program cache
+     *
+     * Input i of the bindings is bound to texture unit i.
+     *
+     * @param[in] description Name of the pass in error messages
+     * @param[in] shaders     Shaders of the program
+     * @param[in] bindings    Sampler inputs of the pass
+     *
+     * @throws std::runtime_error with the info log on failure
+     */
+    void link(const std::string &description,
+              const std::vector<pass_shader> &shaders,
+              const std::vector<discovered_binding> &bindings);
+
+    template <typename T>
+    void set_uniform(const std::string &name, const T &value) {
+        auto it = uniforms_.find(name);
+        if (it == uniforms_.end())
+            it = uniforms_.emplace(name, uniform_slot{location(name), value})
+                     .first;
+        else
+            it->second.value = value;
+
+        if (it->second.location >= 0)
+            apply_uniform(program_, it->second.location, value);
+    }
+
+    /// Set iResolution to the size of the render targets
+    void set_resolution(const shadertoy::rsize &size);
+};
+
+#endif /* _PASS_PROGRAM_HPP_ */
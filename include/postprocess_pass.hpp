@@ -0,0 +1,97 @@
+#ifndef _POSTPROCESS_PASS_HPP_
+#define _POSTPROCESS_PASS_HPP_
+
+#include <shadertoy.hpp>
+
+#include <string>
+#include <vector>
+
+#include "compute_pass.hpp"
+#include "discovered_bindings.hpp"
+#include "discovered_uniform.hpp"
+#include "pass_program.hpp"
+
+/// Framebuffer, sampler and empty vertex array shared by the postprocessing
+/// passes of a chain, created on first use
+class pass_framebuffer {
+    GLuint framebuffer_;
+    GLuint vertex_array_;
+    GLuint sampler_;
+
+   public:
+    pass_framebuffer();
+    ~pass_framebuffer();
+
+    pass_framebuffer(const pass_framebuffer &) = delete;
+    pass_framebuffer &operator=(const pass_framebuffer &) = delete;
+
+    /// Attach the given image and bind the framebuffer for drawing
+    void bind(compute_output &output, const shadertoy::rsize &size);
+
+    /// Unbind the framebuffer and the vertex array
+    void unbind();
+
+    /// Trilinear sampler with clamped coordinates for the pass inputs
+    inline GLuint sampler() const { return sampler_; }
+};
+
+/**
+ * @brief Fragment pass of the postprocessing graph
+ *
+ * The source is a Shadertoy-style mainImage function, preceded by the usual
+ * `//! name binding=target` directives. Targets are outputs of the geometry
+ * buffer, compute passes or other postprocessing passes, by identifier. The
+ * standard Shadertoy uniforms are declared for it, except the iChannel
+ * inputs. Passes are drawn as a full-screen triangle into one RGBA32F image.
+ */
+class postprocess_pass {
+    std::string id_;
+    std::string source_;
+    std::vector<discovered_binding> bindings_;
+
+    pass_program program_;
+
+   public:
+    /**
+     * @brief     Parse a postprocessing pass
+     *
+     * @param[in]  id       Identifier of the pass
+     * @param[in]  source   Preprocessed source of the pass
+     * @param[out] uniforms Discovered uniforms, the uniforms declared by the
+     *                      source are appended to it unless another stage
+     *                      already declared them
+     */
+    postprocess_pass(const std::string &id, const std::string &source,
+                     std::vector<discovered_uniform> &uniforms);
+
+    postprocess_pass(const postprocess_pass &) = delete;
+    postprocess_pass &operator=(const postprocess_pass &) = delete;
+
+    inline const std::string &id() const { return id_; }
+
+    inline const std::vector<discovered_binding> &bindings() const
+    { return bindings_; }
+
+    /// Compile the program if needed, throws std::runtime_error on failure
+    void compile();
+
+    template <typename T>
+    void set_uniform(const std::string &name, const T &value) {
+        program_.set_uniform(name, value);
+    }
+
+    /**
+     * @brief     Draw the pass into an image
+     *
+     * @param[in] inputs Textures of bindings(), in the same order, with
+     *                   complete mipmaps
+     * @param[in] output Image to write, allocated at the given size
+     * @param[in] size   Size of the render targets
+     * @param[in] target Framebuffer of the chain
+     */
+    void draw(const std::vector<shadertoy::backends::gx::texture *> &inputs,
+              compute_output &output, const shadertoy::rsize &size,
+              pass_framebuffer &target);
+};
+
+#endif /* _POSTPROCESS_PASS_HPP_ */
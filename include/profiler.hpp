@@ -0,0 +1,131 @@
+#ifndef _PROFILER_HPP_
+#define _PROFILER_HPP_
+
+#include <epoxy/gl.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+
+/// Fixed-size history of timing samples, in milliseconds
+class sample_ring {
+    std::vector<float> samples_;
+    size_t next_;
+    size_t size_;
+
+   public:
+    sample_ring(size_t capacity = profiler_history);
+
+    void push(float ms);
+
+    inline size_t size() const { return size_; }
+
+    inline bool empty() const { return size_ == 0; }
+
+    /// Most recent sample
+    float last() const;
+
+    float mean() const;
+
+    /// Sample at the given percentile, in [0, 100]
+    float percentile(float p) const;
+
+    /// Raw storage, for plotting. The oldest sample is at offset().
+    inline const float *data() const { return samples_.data(); }
+
+    inline size_t capacity() const { return samples_.size(); }
+
+    inline size_t offset() const { return size_ < samples_.size() ? 0 : next_; }
+};
+
+/// Statistics summary of every profiled section
+typedef std::map<std::string, std::map<std::string, double>> profiler_stats;
+
+/**
+ * @brief Timing history of GPU and CPU sections
+ *
+ * GPU sections are measured with timestamp queries, which are only read back
+ * once available so the render loop never waits on them.
+ */
+class profiler {
+    struct gpu_section {
+        std::string name;
+        GLuint begin_query;
+        GLuint end_query;
+    };
+
+    std::map<std::string, sample_ring> sections_;
+
+    /// Sections started but not ended yet
+    std::vector<gpu_section> open_;
+
+    /// Sections waiting for their results, in submission order
+    std::deque<gpu_section> pending_;
+
+    /// Recycled query objects
+    std::vector<GLuint> free_queries_;
+
+    /// GPU and trace clocks at the same instant, to place GPU spans in traces
+    GLint64 gpu_reference_ns_;
+    double trace_reference_us_;
+    bool calibrated_;
+
+    void calibrate();
+
+    GLuint make_timestamp();
+
+    void release(const gpu_section &section);
+
+   public:
+    profiler();
+    ~profiler();
+
+    profiler(const profiler &) = delete;
+    profiler &operator=(const profiler &) = delete;
+
+    /// Insert a GPU timestamp starting the named section
+    void gpu_begin(const std::string &name);
+
+    /// Insert a GPU timestamp ending the named section
+    void gpu_end(const std::string &name);
+
+    /// Record GPU sections whose results are available, without blocking
+    void collect();
+
+    /// Forget all recorded samples. Pending GPU sections are still recorded.
+    void clear();
+
+    /// Record a CPU-measured sample for the named section
+    void record(const std::string &name, float ms);
+
+    /// History of the named section, or nullptr if it was never recorded
+    const sample_ring *find(const std::string &name) const;
+
+    /// Count, mean, p50, p95, p99 and last sample of every section
+    profiler_stats stats() const;
+};
+
+/// Record the CPU time spent in the current scope
+class scoped_timer {
+    profiler &profiler_;
+    const char *name_;
+    std::chrono::steady_clock::time_point start_;
+
+   public:
+    inline scoped_timer(profiler &profiler, const char *name)
+        : profiler_(profiler),
+          name_(name),
+          start_(std::chrono::steady_clock::now()) {}
+
+    inline ~scoped_timer() {
+        std::chrono::duration<float, std::milli> elapsed(
+            std::chrono::steady_clock::now() - start_);
+        profiler_.record(name_, elapsed.count());
+    }
+};
+
+#endif /* _PROFILER_HPP_ */
@@ -0,0 +1,80 @@
+#ifndef _PROGRAM_CACHE_HPP_
+#define _PROGRAM_CACHE_HPP_
+
+#include <epoxy/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * On-disk cache of linked program binaries. Programs linked with link(), or
+ * by libshadertoy while a link_hook is alive, are first looked up in the
+ * cache, keyed by the sources of their shaders and the driver identification
+ * strings, and only linked from source on a miss. When the binaries exceed
+ * the size limit, the least recently used ones are removed. Nothing is cached
+ * until open() is called.
+ */
+namespace program_cache {
+struct cache_stats {
+    /// Programs loaded from a binary
+    uint64_t hits;
+    /// Programs linked from source, including rejected binaries
+    uint64_t misses;
+    /// Binaries rejected by the driver, e.g. after an update
+    uint64_t rejected;
+    /// Binaries removed to fit the size limit
+    uint64_t evictions;
+    /// Total size of the binaries in bytes
+    uint64_t size;
+};
+
+/**
+ * @brief     Start caching program binaries in the given directory
+ *
+ * Must be called with a current OpenGL context. Does nothing if the driver
+ * does not support program binaries.
+ *
+ * @param[in] dir    Cache directory, created if needed
+ * @param[in] budget Size limit of the binaries in bytes
+ */
+void open(const std::string &dir, size_t budget);
+
+/**
+ * @brief     Link a program, or load its binary from the cache
+ *
+ * The key only covers the shader sources. Callers must not set state that
+ * changes the link result before calling it, such as attribute, fragment
+ * output or transform feedback bindings: the passes of the viewer and the
+ * shader templates of libshadertoy declare their locations in their sources
+ * instead.
+ *
+ * @param[in] program Program with its shaders attached and compiled
+ */
+void link(GLuint program);
+
+/**
+ * @brief Send the glLinkProgram calls of libshadertoy through link() while
+ *        in scope
+ *
+ * libshadertoy links the programs of the chains internally, so the libepoxy
+ * entry point is replaced while they are initialized, and restored after.
+ * Programs linked out of its scope, such as those of ImGui, are not cached.
+ */
+class link_hook {
+    PFNGLLINKPROGRAMPROC previous_;
+
+   public:
+    link_hook();
+    ~link_hook();
+
+    link_hook(const link_hook &) = delete;
+    link_hook &operator=(const link_hook &) = delete;
+};
+
+bool enabled();
+
+cache_stats stats();
+}  // namespace program_cache
+
+#endif /* _PROGRAM_CACHE_HPP_ */
@@ -0,0 +1,56 @@
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+#include <string>
+
+/**
+ * Chrome trace-event output of the frame timeline, which can be loaded in
+ * chrome://tracing or Perfetto. All functions are no-ops until open() is
+ * called.
+ */
+namespace trace {
+/// Start writing trace events to the given file
+void open(const std::string &path);
+
+/// Terminate the trace file
+void close();
+
+bool enabled();
+
+/// Name the track of the calling thread
+void name_thread(const std::string &name);
+
+/// Microseconds since the trace was opened
+double now_us();
+
+/**
+ * @brief     Write a complete span event
+ *
+ * @param[in] name     Span name
+ * @param[in] category Span category
+ * @param[in] ts_us    Start of the span, see now_us()
+ * @param[in] dur_us   Duration of the span
+ * @param[in] gpu      true to show the span on the GPU track instead of the
+ *                     calling thread
+ */
+void complete(const std::string &name, const char *category, double ts_us,
+              double dur_us, bool gpu = false);
+
+/// Span covering the current scope on the calling thread
+class scope {
+    const char *name_;
+    const char *category_;
+    double start_;
+
+   public:
+    scope(const char *name, const char *category = "cpu");
+    ~scope();
+};
+}  // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) \
+    trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+#endif /* _TRACE_HPP_ */
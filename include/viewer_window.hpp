@@ -28,6 +28,12 @@ class viewer_window {
 
     bool need_render_;
 
+    /// Frames left to draw after the last input event
+    int redraw_frames_;
+
+    /// Earliest start of the next frame, for the frame rate cap
+    double next_frame_time_;
+
     static void glfw_window_mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
     static void glfw_window_set_framebuffer_size(GLFWwindow *window, int width, int height);
     static void glfw_window_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
@@ -44,6 +50,14 @@ class viewer_window {
 
     void reload_shader();
 
+    /// Schedule frames after an input event
+    inline void wake() { redraw_frames_ = idle_redraw_frames; }
+
+    /// Block until there is input, a request or an animation to render
+    void wait_for_frame();
+
+    static void glfw_window_refresh_callback(GLFWwindow *window);
+
   public:
    viewer_window(viewer_options opt);
    ~viewer_window();
@@ -0,0 +1,17 @@
+// Running average of jittered frames, see gl_state::accumulate
+
+// Number of samples already in iPrevious
+uniform int iSampleCount;
+
+void mainImage(out vec4 O, in vec2 U)
+{
+    ivec2 p = ivec2(U);
+    vec4 current = texelFetch(iCurrent, p, 0);
+
+    if (iSampleCount == 0) {
+        O = current;
+    } else {
+        vec4 previous = texelFetch(iPrevious, p, 0);
+        O = previous + (current - previous) / float(iSampleCount + 1);
+    }
+}
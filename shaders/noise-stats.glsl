@@ -0,0 +1,286 @@
+// Reductions of a render output, see noise_stats_reducer. The host defines
+// the pass to compile (STATS_MOMENTS, STATS_REDUCE, STATS_FFT_ROWS or
+// STATS_FFT_COLUMNS) and FFT_SIZE for the FFT passes.
+
+#define GROUP_SIZE 256
+#define MAX_BINS 2048
+#define MAX_SPECTRUM_BINS 1024
+#define M_PI 3.14159265358979323846
+
+// Sample count, mean, sum of squared differences to the mean, min and max
+// of each channel
+struct moments {
+    vec4 count;
+    vec4 mean;
+    vec4 m2;
+    vec4 lo;
+    vec4 hi;
+};
+
+// Moments of each work group of the first pass
+layout(std430, binding = 0) buffer Partials {
+    moments partials[];
+};
+
+// Moments of the whole image, and histogram of the chosen channel
+layout(std430, binding = 1) buffer Result {
+    moments result;
+    uint histogram[];
+};
+
+layout(binding = 0) uniform sampler2D uTexture;
+
+uniform int uChannel;
+uniform int uBins;
+uniform vec2 uRange;
+uniform int uGroups;
+uniform int uSpectrumBins;
+
+#if defined(STATS_MOMENTS) || defined(STATS_REDUCE)
+shared vec4 s_count[GROUP_SIZE];
+shared vec4 s_mean[GROUP_SIZE];
+shared vec4 s_m2[GROUP_SIZE];
+shared vec4 s_lo[GROUP_SIZE];
+shared vec4 s_hi[GROUP_SIZE];
+
+// Merge the moments of b into a, using the pairwise update of Chan et al.
+void combine(inout moments a, moments b)
+{
+    vec4 n = a.count + b.count;
+    vec4 d = b.mean - a.mean;
+    vec4 f = b.count / max(n, vec4(1.));
+
+    a.mean += d * f;
+    a.m2 += b.m2 + d * d * a.count * f;
+    a.count = n;
+    a.lo = min(a.lo, b.lo);
+    a.hi = max(a.hi, b.hi);
+}
+
+moments load_shared(uint i)
+{
+    return moments(s_count[i], s_mean[i], s_m2[i], s_lo[i], s_hi[i]);
+}
+
+void store_shared(uint i, moments m)
+{
+    s_count[i] = m.count;
+    s_mean[i] = m.mean;
+    s_m2[i] = m.m2;
+    s_lo[i] = m.lo;
+    s_hi[i] = m.hi;
+}
+
+moments empty_moments()
+{
+    float inf = uintBitsToFloat(0x7f800000u);
+    return moments(vec4(0.), vec4(0.), vec4(0.), vec4(inf), vec4(-inf));
+}
+
+// Tree reduction of the moments of the work group into s_*[0]
+void reduce_shared(uint li)
+{
+    for (uint s = GROUP_SIZE / 2; s > 0; s >>= 1) {
+        if (li < s) {
+            moments m = load_shared(li);
+            combine(m, load_shared(li + s));
+            store_shared(li, m);
+        }
+
+        barrier();
+    }
+}
+#endif
+
+#if defined(STATS_MOMENTS)
+layout(local_size_x = 16, local_size_y = 16) in;
+
+shared uint s_histogram[MAX_BINS];
+
+void main()
+{
+    uint li = gl_LocalInvocationIndex;
+    ivec2 size = textureSize(uTexture, 0);
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+
+    for (int b = int(li); b < uBins; b += GROUP_SIZE)
+        s_histogram[b] = 0u;
+
+    barrier();
+
+    moments m = empty_moments();
+
+    if (all(lessThan(p, size))) {
+        vec4 v = texelFetch(uTexture, p, 0);
+        m = moments(vec4(1.), v, vec4(0.), v, v);
+
+        if (uBins > 0) {
+            float x = (v[uChannel] - uRange.x) / (uRange.y - uRange.x);
+            int b = clamp(int(floor(x * float(uBins))), 0, uBins - 1);
+            atomicAdd(s_histogram[b], 1u);
+        }
+    }
+
+    store_shared(li, m);
+    barrier();
+
+    reduce_shared(li);
+
+    if (li == 0u) {
+        uint g = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+        partials[g] = load_shared(0u);
+    }
+
+    for (int b = int(li); b < uBins; b += GROUP_SIZE) {
+        if (s_histogram[b] > 0u)
+            atomicAdd(histogram[b], s_histogram[b]);
+    }
+}
+#elif defined(STATS_REDUCE)
+layout(local_size_x = GROUP_SIZE) in;
+
+void main()
+{
+    uint li = gl_LocalInvocationIndex;
+
+    moments m = empty_moments();
+    for (int i = int(li); i < uGroups; i += GROUP_SIZE)
+        combine(m, partials[i]);
+
+    store_shared(li, m);
+    barrier();
+
+    reduce_shared(li);
+
+    if (li == 0u)
+        result = load_shared(0u);
+}
+#elif defined(STATS_FFT_ROWS) || defined(STATS_FFT_COLUMNS)
+// One row or column per work group, two elements per invocation
+layout(local_size_x = FFT_SIZE / 2) in;
+
+// Row transforms, FFT_SIZE values per row
+layout(std430, binding = 2) buffer Transform {
+    vec2 transform[];
+};
+
+// Power of each radial band, as float bits
+layout(std430, binding = 3) buffer Spectrum {
+    uint spectrum[];
+};
+
+shared vec2 s_data[FFT_SIZE];
+shared uint s_spectrum[MAX_SPECTRUM_BINS];
+
+uint reversed(uint i)
+{
+    return bitfieldReverse(i) >> (32 - findMSB(FFT_SIZE));
+}
+
+vec2 cmul(vec2 a, vec2 b)
+{
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// Radix-2 decimation in time over s_data, loaded in bit-reversed order
+void fft(uint t)
+{
+    for (uint len = 2u; len <= uint(FFT_SIZE); len <<= 1) {
+        uint half_len = len >> 1;
+        uint i = (t / half_len) * len + t % half_len;
+        uint j = i + half_len;
+
+        float a = -2. * M_PI * float(t % half_len) / float(len);
+        vec2 u = s_data[i];
+        vec2 v = cmul(s_data[j], vec2(cos(a), sin(a)));
+
+        s_data[i] = u + v;
+        s_data[j] = u - v;
+
+        barrier();
+    }
+}
+
+#if defined(STATS_FFT_ROWS)
+void main()
+{
+    uint t = gl_LocalInvocationIndex;
+    int y = int(gl_WorkGroupID.x);
+
+    // Without the mean, the bands add up to the variance
+    for (uint k = 0u; k < 2u; ++k) {
+        uint x = t + k * uint(FFT_SIZE / 2);
+        float v = texelFetch(uTexture, ivec2(x, y), 0)[uChannel];
+        s_data[reversed(x)] = vec2(v - result.mean[uChannel], 0.);
+    }
+
+    barrier();
+    fft(t);
+
+    for (uint k = 0u; k < 2u; ++k) {
+        uint x = t + k * uint(FFT_SIZE / 2);
+        transform[y * FFT_SIZE + x] = s_data[x];
+    }
+}
+#else
+// Width of the image, the transform of the rows
+uniform int uWidth;
+
+void add_power(uint b, float p)
+{
+    uint prev = s_spectrum[b], expected;
+    do {
+        expected = prev;
+        prev = atomicCompSwap(s_spectrum[b], expected,
+                              floatBitsToUint(uintBitsToFloat(expected) + p));
+    } while (prev != expected);
+}
+
+void main()
+{
+    uint t = gl_LocalInvocationIndex;
+    int x = int(gl_WorkGroupID.x);
+
+    for (int b = int(t); b < uSpectrumBins; b += FFT_SIZE / 2)
+        s_spectrum[b] = 0u;
+
+    for (uint k = 0u; k < 2u; ++k) {
+        uint y = t + k * uint(FFT_SIZE / 2);
+        s_data[reversed(y)] = transform[y * uWidth + x];
+    }
+
+    barrier();
+    fft(t);
+
+    // Signed frequencies in cycles per pixel
+    float fx = float(x <= uWidth / 2 ? x : x - uWidth) / float(uWidth);
+    float n = float(uWidth) * float(FFT_SIZE);
+
+    for (uint k = 0u; k < 2u; ++k) {
+        int y = int(t + k * uint(FFT_SIZE / 2));
+        float fy = float(y <= FFT_SIZE / 2 ? y : y - FFT_SIZE) / float(FFT_SIZE);
+
+        // Bands up to the Nyquist frequency, corners are left out
+        int b = int(length(vec2(fx, fy)) / .5 * float(uSpectrumBins));
+        if (b < uSpectrumBins) {
+            vec2 c = s_data[y];
+            add_power(uint(b), dot(c, c) / (n * n));
+        }
+    }
+
+    barrier();
+
+    for (int b = int(t); b < uSpectrumBins; b += FFT_SIZE / 2) {
+        float p = uintBitsToFloat(s_spectrum[b]);
+        if (p == 0.) continue;
+
+        uint prev = spectrum[b], expected;
+        do {
+            expected = prev;
+            prev = atomicCompSwap(spectrum[b], expected,
+                                  floatBitsToUint(uintBitsToFloat(expected) + p));
+        } while (prev != expected);
+    }
+}
+#endif
+#endif
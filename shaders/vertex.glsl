@@ -7,6 +7,8 @@ precision highp sampler2D;
 uniform mat4 mModel;
 uniform mat4 mView;
 uniform mat4 mProj;
+// Maps the full frame to the rendered tile, identity when not tiling
+uniform mat4 mTile;
 
 uniform bool bWireframe;
 
@@ -16,11 +18,15 @@ uniform vec3 bboxMin;
 uniform bool dQuad;
 
 uniform vec3 iResolution;
+// Size of the full frame, which differs from iResolution when tiling
+uniform vec3 iFullResolution;
 
 // Vertex attributes
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec2 texCoord;
 layout(location = 2) in vec3 normal;
+// Per-instance model transform (identity when not instanced)
+layout(location = 3) in mat4 instanceTransform;
 
 // Texture coord for fragment
 out vec2 vtexCoord;
@@ -34,12 +40,15 @@ void main() {
 
     if (dQuad) {
         // Fix quad aspect ratio
-        float ratio = iResolution.x / iResolution.y;
+        float ratio = iFullResolution.x / iFullResolution.y;
         vPosition.x *= ratio;
         vtexCoord.x *= ratio;
 
-        gl_Position = vec4(position, 1.0);
+        gl_Position = mTile * vec4(position, 1.0);
     } else {
-        gl_Position = mProj * mView * mModel * vec4(position, 1.0);
+        // Instance space, which the bounding box covers when instanced
+        vPosition = (instanceTransform * vec4(position, 1.0)).xyz;
+
+        gl_Position = mTile * mProj * mView * mModel * instanceTransform * vec4(position, 1.0);
     }
 }
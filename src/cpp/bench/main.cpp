@@ -0,0 +1,483 @@
+#include <epoxy/gl.h>
+
+#include <GLFW/glfw3.h>
+
+#include <shadertoy.hpp>
+#include <shadertoy/backends/gl4.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#include <sys/resource.h>
+
+#include <boost/program_options.hpp>
+
+#include "gl_state.hpp"
+#include "noise/gabor.hpp"
+#include "noise/prng_batch.hpp"
+#include "program_cache.hpp"
+#include "trace.hpp"
+#include "viewer_state.hpp"
+
+using namespace shadertoy;
+namespace gx = shadertoy::backends::gx;
+
+namespace po = boost::program_options;
+
+struct bench_options {
+    viewer_options viewer;
+
+    std::string scene_path;
+    std::string output_path;
+    std::vector<std::string> params;
+
+    int warmup_frames;
+    int measured_frames;
+    int reference_frames;
+    /// Generator of prng-check.glsl to compare against, empty if disabled
+    std::string check_prng;
+    bool readback;
+    bool software;
+};
+
+/// Fixed time step between frames, so animated shaders are reproducible
+static const float bench_time_step = 1.0f / 60.0f;
+
+static void write_json_string(std::ostream &os, const std::string &str) {
+    os << '"';
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') os << '\\';
+        os << ch;
+    }
+    os << '"';
+}
+
+static void set_params(gl_state &gl_state,
+                       const std::vector<std::string> &params) {
+    auto &discovered_uniforms = gl_state.get_discovered_uniforms();
+
+    for (const auto &param : params) {
+        auto eq_pos = param.find('=');
+        if (eq_pos == std::string::npos)
+            throw std::runtime_error("invalid param " + param +
+                                     ", expected name=value");
+
+        std::string name(param.begin(), param.begin() + eq_pos);
+        std::string value(param.begin() + eq_pos + 1, param.end());
+
+        auto it = std::find_if(
+            discovered_uniforms.begin(), discovered_uniforms.end(),
+            [&name](const auto &item) { return item.s_name == name; });
+
+        if (it == discovered_uniforms.end())
+            throw std::runtime_error("param " + name + " not found");
+
+        if (!try_parse_variant(it->value, value))
+            throw std::runtime_error("invalid value for param " + name);
+    }
+}
+
+static void read_back(gl_state &gl_state, std::vector<float> &pixels) {
+    auto output(gl_state.get_render_result());
+    if (output.empty()) return;
+
+    auto texture(std::get<1>(output.front()));
+
+    GLint width, height;
+    texture->get_parameter(GL_TEXTURE_WIDTH, &width);
+    texture->get_parameter(GL_TEXTURE_HEIGHT, &height);
+
+    pixels.resize(width * height * 4);
+
+    TRACE_SCOPE("get_image", "gl");
+    scoped_timer timer(gl_state.timings, "cpu.readback");
+
+    reinterpret_cast<const shadertoy::backends::gl4::texture *>(texture)
+        ->get_image(0, GL_RGBA, GL_FLOAT, pixels.size() * sizeof(float),
+                    pixels.data());
+}
+
+static void render_frame(gl_state &gl_state, viewer_state &state, float t,
+                         bool readback, std::vector<float> &pixels) {
+    TRACE_SCOPE("frame");
+
+    {
+        scoped_timer timer(gl_state.timings, "cpu.frame");
+
+        gl_state.update_uniforms(t, state);
+
+        // Same as the viewer ImGui pass, push the parameter values
+        for (auto &uniform : gl_state.get_discovered_uniforms())
+            uniform.set_uniform(*gl_state.chains.back());
+
+        gl_state.render(false);
+
+        // Wait for the GPU so the CPU time covers the whole frame
+        glFinish();
+    }
+
+    std::string error_status(gl_state.get_render_error());
+    if (!error_status.empty()) throw std::runtime_error(error_status);
+
+    if (readback) read_back(gl_state, pixels);
+
+    gl_state.timings.collect();
+    state.frame_count++;
+}
+
+static std::vector<float> render_reference(gl_state &gl_state,
+                                           const bench_options &opt) {
+    auto params(gl_state.get_gabor_params());
+
+    std::vector<float> reference;
+    for (int i = 0; i < opt.reference_frames; ++i) {
+        TRACE_SCOPE("render_gabor");
+        scoped_timer timer(gl_state.timings, "cpu.reference");
+
+        reference = noise::render_gabor(params, opt.viewer.frame.width,
+                                        opt.viewer.frame.height);
+    }
+
+    return reference;
+}
+
+/// Difference between the noise values of the GPU and CPU renders
+static std::map<std::string, double> reference_error(
+    const std::vector<float> &pixels, const std::vector<float> &reference) {
+    double max_abs = 0., sum_sq = 0.;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        double diff = std::abs(double(pixels[i]) - double(reference[i]));
+        max_abs = std::max(max_abs, diff);
+        sum_sq += diff * diff;
+    }
+
+    return {{"max_abs", max_abs},
+            {"rms", std::sqrt(sum_sq / double(pixels.size() / 4))}};
+}
+
+/// Count pixels of a prng-check.glsl frame that differ from the C++ port
+template <template <typename> class Gen>
+static size_t check_prng(const std::vector<float> &pixels, float mean) {
+    size_t count = pixels.size() / 4;
+    std::vector<uint32_t> seeds(count);
+    std::iota(seeds.begin(), seeds.end(), 0u);
+
+    // Same draws as the shader, in the same order
+    noise::prng_batch<Gen> batch(seeds.data(), count);
+    std::vector<float> xy(2 * count), z(count);
+    std::vector<int> w(count);
+    batch.rand2(xy.data());
+    batch.rand1(z.data());
+    batch.poisson(mean, w.data());
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const float *p = &pixels[4 * i];
+        if (p[0] != xy[2 * i] || p[1] != xy[2 * i + 1] || p[2] != z[i] ||
+            p[3] != float(w[i]))
+            mismatches++;
+    }
+
+    return mismatches;
+}
+
+static size_t check_prng(gl_state &gl_state, const bench_options &opt,
+                         const std::vector<float> &pixels) {
+    float mean = 0.f;
+    for (const auto &uniform : gl_state.get_discovered_uniforms()) {
+        if (uniform.s_name == "cMean") {
+            if (auto p = std::get_if<float>(&uniform.value); p) mean = *p;
+        }
+    }
+
+    if (opt.check_prng == "hash")
+        return check_prng<noise::hash_gen>(pixels, mean);
+    if (opt.check_prng == "lcg")
+        return check_prng<noise::lcg_gen>(pixels, mean);
+    if (opt.check_prng == "xorshift")
+        return check_prng<noise::xorshift_gen>(pixels, mean);
+    return check_prng<noise::xoroshiro_gen>(pixels, mean);
+}
+
+static void write_report(std::ostream &os, const bench_options &opt,
+                         const profiler_stats &stats) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const auto &program = opt.viewer.program;
+    const auto &geometry = opt.viewer.geometry;
+
+    os << "{\n  \"scene\": {\n    \"shader\": ";
+    write_json_string(os, program.shader.path.empty() ? program.shader.source
+                                                      : program.shader.path);
+    os << ",\n    \"postprocess\": ";
+    write_json_string(os, program.postprocess.path.empty()
+                              ? program.postprocess.source
+                              : program.postprocess.path);
+    os << ",\n    \"geometry\": ";
+    write_json_string(os, geometry.path.empty() ? geometry.nff_source
+                                                : geometry.path);
+    os << ",\n    \"width\": " << opt.viewer.frame.width
+       << ",\n    \"height\": " << opt.viewer.frame.height
+       << "\n  },\n  \"renderer\": ";
+    write_json_string(
+        os, reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    os << ",\n  \"warmup_frames\": " << opt.warmup_frames
+       << ",\n  \"measured_frames\": " << opt.measured_frames
+       << ",\n  \"peak_rss_kb\": " << usage.ru_maxrss
+       << ",\n  \"sections\": {";
+
+    bool first_section = true;
+    for (const auto &section : stats) {
+        os << (first_section ? "\n    " : ",\n    ");
+        write_json_string(os, section.first);
+        os << ": {";
+
+        bool first_value = true;
+        for (const auto &value : section.second) {
+            os << (first_value ? "" : ", ");
+            write_json_string(os, value.first);
+            os << ": " << value.second;
+            first_value = false;
+        }
+
+        os << "}";
+        first_section = false;
+    }
+
+    os << "\n  }\n}\n";
+}
+
+static void run_bench(const bench_options &opt) {
+    glfwWindowHint(GLFW_VISIBLE, 0);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow *window =
+        glfwCreateWindow(opt.viewer.frame.width, opt.viewer.frame.height,
+                         "Test model benchmark", nullptr, nullptr);
+
+    if (!window) {
+        throw std::runtime_error("Failed to create window");
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    backends::set_current(std::make_unique<backends::gl4::backend>());
+
+    size_t prng_mismatches = 0;
+
+    if (!opt.viewer.program_cache_dir.empty())
+        program_cache::open(
+            opt.viewer.program_cache_dir,
+            static_cast<size_t>(opt.viewer.program_cache_mb) << 20);
+
+    {
+        viewer_state state;
+        gl_state gl_state(opt.viewer.frame);
+
+        gl_state.load_chain(opt.viewer.program);
+        gl_state.load_geometry(opt.viewer.geometry);
+        state.center = gl_state.center;
+        state.scale = gl_state.scale;
+
+        set_params(gl_state, opt.params);
+
+        std::vector<float> pixels;
+        float t = 0.0f;
+
+        for (int i = 0; i < opt.warmup_frames; ++i, t += bench_time_step)
+            render_frame(gl_state, state, t, opt.readback, pixels);
+
+        // Only keep the measured frames in the statistics
+        glFinish();
+        gl_state.timings.collect();
+        gl_state.timings.clear();
+
+        for (int i = 0; i < opt.measured_frames; ++i, t += bench_time_step)
+            render_frame(gl_state, state, t, opt.readback, pixels);
+
+        glFinish();
+        gl_state.timings.collect();
+
+        std::vector<float> reference;
+        if (opt.reference_frames > 0)
+            reference = render_reference(gl_state, opt);
+
+        auto stats(gl_state.timings.stats());
+        stats.emplace("render_targets", gl_state.memory_stats());
+
+        // Only meaningful when the result is the noise geometry pass
+        if (!reference.empty() && pixels.size() == reference.size())
+            stats.emplace("reference_error",
+                          reference_error(pixels, reference));
+
+        if (!opt.check_prng.empty()) {
+            prng_mismatches = check_prng(gl_state, opt, pixels);
+            stats.emplace(
+                "prng_check",
+                std::map<std::string, double>{
+                    {"pixels", static_cast<double>(pixels.size() / 4)},
+                    {"mismatches", static_cast<double>(prng_mismatches)},
+                    {"lanes", static_cast<double>(noise::batch_lanes)},
+                });
+        }
+
+        if (opt.output_path.empty()) {
+            write_report(std::cout, opt, stats);
+        } else {
+            std::ofstream ofs(opt.output_path);
+            if (!ofs)
+                throw std::runtime_error("could not open " + opt.output_path);
+
+            write_report(ofs, opt, stats);
+        }
+    }
+
+    glfwDestroyWindow(window);
+
+    if (prng_mismatches > 0)
+        throw std::runtime_error(std::to_string(prng_mismatches) +
+                                 " pixels differ from the C++ " +
+                                 opt.check_prng + " generator");
+}
+
+int main(int argc, char *argv[]) {
+    int code = 0;
+
+    // Initialize logger
+    spdlog::stderr_color_st(VLOG_NAME);
+
+    bench_options opt;
+    opt.viewer.headless_mode = true;
+
+    // clang-format off
+    po::options_description s_desc("Scene options");
+    s_desc.add_options()
+        ("shader-file,s", po::value(&opt.viewer.program.shader.path), "Path to the shader program")
+        ("shader,S", po::value(&opt.viewer.program.shader.source), "Source of the shader program")
+        ("postprocess-file,p", po::value(&opt.viewer.program.postprocess.path), "Path to the postprocessing shader")
+        ("postprocess,P", po::value(&opt.viewer.program.postprocess.source), "Source of the postprocessing shader")
+        ("compute-file", po::value(&opt.viewer.program.compute)->composing(), "Path to a compute pass run before postprocessing, may be repeated")
+        ("pass-file", po::value(&opt.viewer.program.passes)->composing(), "Path to a postprocessing pass run before the postprocess shader, may be repeated")
+        ("use-make,m", po::bool_switch(&opt.viewer.program.use_make), "Compile the target shader file using make first")
+        ("geometry-file,g", po::value(&opt.viewer.geometry.path), "Path to the geometry to load")
+        ("geometry,G", po::value(&opt.viewer.geometry.nff_source), "NFF format string of the geometry to use")
+        ("width,W", po::value(&opt.viewer.frame.width)->default_value(512), "Frame width")
+        ("height,H", po::value(&opt.viewer.frame.height)->default_value(512), "Frame height")
+        ("oriented-bounds", po::bool_switch(&opt.viewer.frame.fit_oriented_bounds)->default_value(false), "Fit geometry to the frame using its oriented bounding box")
+        ("texture-pool", po::value(&opt.viewer.frame.texture_pool_mb)->default_value(512), "Memory budget in MB for render targets kept across size changes")
+        ("param", po::value(&opt.params)->composing(), "Uniform value as name=value, may be repeated");
+
+    po::options_description b_desc("Benchmark options");
+    b_desc.add_options()
+        ("scene,c", po::value(&opt.scene_path), "Read scene options from the given file")
+        ("warmup,n", po::value(&opt.warmup_frames)->default_value(16), "Number of warm-up frames")
+        ("frames,f", po::value(&opt.measured_frames)->default_value(256), "Number of measured frames")
+        ("no-readback", po::bool_switch()->default_value(false), "Do not read the result back after each frame")
+        ("cpu-frames", po::value(&opt.reference_frames)->default_value(0), "Number of frames also rendered by the CPU Gabor noise evaluator")
+        ("check-prng", po::value(&opt.check_prng), "Compare the result of prng-check.glsl with the given C++ generator (hash, lcg, xorshift, xoroshiro)")
+        ("software", po::bool_switch(&opt.software)->default_value(false), "Render with Mesa llvmpipe")
+        ("output,o", po::value(&opt.output_path), "Write the JSON report to the given file instead of stdout")
+        ("debug,d", po::bool_switch(&opt.viewer.log.debug)->default_value(false), "Enable debug logs")
+        ("verbose,v", po::bool_switch(&opt.viewer.log.verbose)->default_value(false), "Enable verbose logs")
+        ("trace", po::value(&opt.viewer.log.trace_path), "Write a Chrome trace-event file of the frame timeline")
+        ("program-cache", po::value(&opt.viewer.program_cache_dir), "Directory of the on-disk cache of linked pass programs, shared across runs")
+        ("program-cache-mb", po::value(&opt.viewer.program_cache_mb)->default_value(256), "Size limit of the on-disk cache of linked pass programs in MB")
+        ("help,h", "Show this help message");
+    // clang-format on
+
+    po::options_description desc;
+    desc.add(s_desc).add(b_desc);
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+
+        // Options given on the command line take precedence over the scene
+        if (vm.count("scene") > 0) {
+            std::ifstream scene(vm["scene"].as<std::string>());
+            if (!scene) {
+                std::cerr << "Could not open scene file "
+                          << vm["scene"].as<std::string>() << std::endl;
+                return 1;
+            }
+
+            po::store(po::parse_config_file(scene, s_desc), vm);
+        }
+
+        po::notify(vm);
+    } catch (po::error &ex) {
+        std::cerr << "Invalid usage: " << ex.what() << std::endl
+                  << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help") > 0) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    opt.readback = !vm["no-readback"].as<bool>();
+
+    if (!opt.check_prng.empty()) {
+        static const std::vector<std::string> generators{"hash", "lcg",
+                                                         "xorshift", "xoroshiro"};
+        if (std::find(generators.begin(), generators.end(), opt.check_prng) ==
+                generators.end() ||
+            !opt.readback) {
+            std::cerr << "Invalid usage: --check-prng needs one of hash, lcg, "
+                         "xorshift, xoroshiro and the frame readback"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // Must be set before the driver is loaded
+    if (opt.software) setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+
+    if (!glfwInit()) {
+        VLOG->critical("Failed to initialize glfw");
+        return 2;
+    }
+
+    // Set log levels
+    auto level = opt.viewer.log.debug
+                     ? spdlog::level::debug
+                     : (opt.viewer.log.verbose ? spdlog::level::info
+                                               : spdlog::level::warn);
+    utils::log::shadertoy()->set_level(level);
+    VLOG->set_level(level);
+
+    try {
+        if (!opt.viewer.log.trace_path.empty())
+            trace::open(opt.viewer.log.trace_path);
+
+        run_bench(opt);
+    } catch (gx::shader_compilation_error &sce) {
+        VLOG->critical("Failed to compile shader: {}", sce.log());
+        code = 2;
+    } catch (gx::program_link_error &sce) {
+        VLOG->critical("Failed to link program: {}", sce.log());
+        code = 2;
+    } catch (shadertoy_error &err) {
+        VLOG->critical("GL error: {}", err.what());
+        code = 2;
+    } catch (std::runtime_error &ex) {
+        VLOG->critical("Generic error: {}", ex.what());
+        code = 1;
+    }
+
+    trace::close();
+
+    glfwTerminate();
+    return code;
+}
@@ -0,0 +1,105 @@
+#include <epoxy/gl.h>
+
+#include <shadertoy/backends/gl4/texture.hpp>
+
+#include <regex>
+#include <sstream>
+
+#include "compute_pass.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+
+using namespace shadertoy;
+namespace gx = shadertoy::backends::gx;
+
+static const std::regex regex_local_size(
+    "^//!\\s+local_size\\s+(\\d+)(?:\\s+(\\d+))?\\s*$");
+
+compute_output::compute_output()
+    : texture_(backends::current()->make_texture(GL_TEXTURE_2D)),
+      size_(0, 0) {}
+
+void compute_output::allocate(const rsize &size) {
+    if (size_ == size) return;
+
+    texture_->image_2d(GL_TEXTURE_2D, 0, GL_RGBA32F, size.width, size.height,
+                       0, GL_RGBA, GL_FLOAT, nullptr);
+    size_ = size;
+}
+
+compute_pass::compute_pass(const std::string &id, const std::string &source,
+                           std::vector<discovered_uniform> &uniforms)
+    : id_(id), source_(source), local_size_(0) {
+    std::string line;
+    std::istringstream iss(source);
+    std::smatch match;
+    while (std::getline(iss, line)) {
+        if (try_parse_pass_uniform(line, uniforms)) continue;
+        if (try_parse_binding(line, bindings_)) continue;
+
+        if (std::regex_search(line, match, regex_local_size)) {
+            local_size_.x = std::stoi(match.str(1));
+            local_size_.y = match[2].matched ? std::stoi(match.str(2)) : 1;
+        }
+    }
+
+    if (local_size_.x <= 0 || local_size_.y <= 0)
+        throw std::runtime_error("compute pass " + id +
+                                 " has no valid local_size directive");
+}
+
+void compute_pass::compile() {
+    if (program_.linked()) return;
+
+    TRACE_SCOPE("compute_pass::compile", "gl");
+
+    std::stringstream header;
+    header << "#version 450\n"
+           << "layout(local_size_x = " << local_size_.x
+           << ", local_size_y = " << local_size_.y << ") in;\n"
+           << "uniform vec3 iResolution;\n"
+           << "layout(rgba32f, binding = 0) uniform writeonly image2D "
+              "oOutput;\n";
+
+    for (const auto &binding : bindings_)
+        header << "uniform sampler2D " << binding.uniform_name << ";\n";
+
+    // Report errors at the lines of the pass source
+    header << "#line 1\n";
+
+    std::string header_source(header.str());
+    program_.link(
+        "compute pass " + id_,
+        {{GL_COMPUTE_SHADER, {header_source.c_str(), source_.c_str()}}},
+        bindings_);
+
+    VLOG->debug("Compiled compute pass {}", id_);
+}
+
+void compute_pass::dispatch(const std::vector<gx::texture *> &inputs,
+                            compute_output &output, const rsize &size) {
+    output.allocate(size);
+
+    program_.set_resolution(size);
+
+    for (size_t i = 0; i < inputs.size(); ++i) inputs[i]->bind_unit(i);
+
+    auto gl_texture =
+        static_cast<const backends::gl4::texture *>(output.texture());
+
+    // No libshadertoy wrapper yet
+    glBindImageTexture(0, GLuint(*gl_texture), 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                       GL_RGBA32F);
+
+    glUseProgram(program_.get());
+    glDispatchCompute((size.width + local_size_.x - 1) / local_size_.x,
+                      (size.height + local_size_.y - 1) / local_size_.y, 1);
+    glUseProgram(0);
+
+    // Later passes sample the image, or read it as an image
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Postprocess inputs use mipmapped filtering
+    output.texture()->generate_mipmap();
+}
@@ -1,6 +1,7 @@
 #include <shadertoy/backends/gx.hpp>
 
 #include "data_input.hpp"
+#include "trace.hpp"
 
 using namespace shadertoy;
 namespace gx = shadertoy::backends::gx;
@@ -23,6 +24,8 @@ void data_input::reset_input() {
 
 gx::texture *data_input::use_input() {
     if (state != dis_gpu_uptodate) {
+        TRACE_SCOPE("data_input::upload", "gl");
+
         // texture needs to be uploaded
         if (!tex_) {
             tex_ = backends::current()->make_texture(GL_TEXTURE_2D);
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "directory_cache.hpp"
+#include "log.hpp"
+
+static bool make_directories(const std::string &dir) {
+    for (size_t pos = dir.find('/', 1);; pos = dir.find('/', pos + 1)) {
+        std::string part(dir.substr(0, pos));
+        if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        if (pos == std::string::npos) return true;
+    }
+}
+
+static int64_t modification_time(const struct stat &st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+           st.st_mtim.tv_nsec;
+}
+
+/// Same clock as file modification times
+static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+directory_cache::directory_cache(const std::string &dir,
+                                 const std::string &extension, size_t budget)
+    : dir_(dir), extension_(extension), budget_(budget), counters_{} {
+    if (!make_directories(dir))
+        throw std::runtime_error("could not create the directory " + dir);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Index the files of previous runs
+    DIR *d = opendir(dir.c_str());
+    if (!d) throw std::runtime_error("could not open the directory " + dir);
+
+    while (struct dirent *ent = readdir(d)) {
+        std::string name(ent->d_name);
+        size_t ext_len = extension_.size();
+        if (name.size() <= ext_len ||
+            name.compare(name.size() - ext_len, ext_len, extension_) != 0)
+            continue;
+
+        char *end;
+        uint64_t key = std::strtoull(name.c_str(), &end, 16);
+        if (end != name.c_str() + name.size() - ext_len) continue;
+
+        struct stat st;
+        if (stat(path(key).c_str(), &st) != 0) continue;
+
+        update(key, file_entry{static_cast<uint64_t>(st.st_size),
+                               modification_time(st)});
+    }
+
+    closedir(d);
+    evict();
+}
+
+std::string directory_cache::path(uint64_t key) const {
+    std::stringstream ss;
+    ss << dir_ << '/' << std::hex << std::setw(16) << std::setfill('0') << key
+       << extension_;
+    return ss.str();
+}
+
+void directory_cache::touch(uint64_t key, uint64_t size) {
+    // For the eviction of other runs
+    utimensat(AT_FDCWD, path(key).c_str(), nullptr, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    update(key, file_entry{size, now()});
+}
+
+void directory_cache::remove(uint64_t key) {
+    std::remove(path(key).c_str());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(key);
+    if (it == files_.end()) return;
+
+    counters_.size -= it->second.size;
+    files_.erase(it);
+    counters_.files = files_.size();
+}
+
+bool directory_cache::write(uint64_t key, const void *header,
+                            size_t header_size, const void *data,
+                            size_t size) {
+    uint64_t file_size = header_size + size;
+
+    // A file larger than the cache would evict itself
+    if (file_size > budget_) return false;
+
+    std::string file_path(path(key));
+
+    // Other viewers may read the file, so never expose a partial file
+    std::string tmp_path(file_path + "." + std::to_string(getpid()) + ".tmp");
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary);
+        ofs.write(reinterpret_cast<const char *>(header), header_size);
+        ofs.write(reinterpret_cast<const char *>(data), size);
+
+        if (!ofs) {
+            VLOG->warn("Could not write {}", tmp_path);
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    update(key, file_entry{file_size, now()});
+    evict();
+    return true;
+}
+
+directory_cache::cache_stats directory_cache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_;
+}
+
+void directory_cache::update(uint64_t key, const file_entry &entry) {
+    auto &current(files_[key]);
+    counters_.size += entry.size - current.size;
+    current = entry;
+    counters_.files = files_.size();
+}
+
+void directory_cache::evict() {
+    while (counters_.size > budget_ && !files_.empty()) {
+        auto oldest = std::min_element(files_.begin(), files_.end(),
+                                       [](const auto &a, const auto &b) {
+                                           return a.second.last_used <
+                                                  b.second.last_used;
+                                       });
+
+        // Open or mapped files stay readable until they are closed
+        std::remove(path(oldest->first).c_str());
+
+        counters_.size -= oldest->second.size;
+        counters_.evictions++;
+        files_.erase(oldest);
+    }
+
+    counters_.files = files_.size();
+}
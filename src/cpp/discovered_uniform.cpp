@@ -563,3 +563,35 @@ bool try_set_variant(uniform_variant &dst, const uniform_variant &value) {
         },
         dst);
 }
+
+bool try_parse_variant(uniform_variant &dst, const std::string &text) {
+    if (text.empty()) return false;
+
+    // Check that all components are numbers before replacing the value
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        std::stringstream sp(part);
+        double component;
+        sp >> component;
+        if (sp.fail()) return false;
+    }
+
+    std::visit(
+        [&dst, &text](const auto &current) {
+            typedef std::remove_const_t<
+                std::remove_reference_t<decltype(current)>>
+                T;
+
+            if constexpr (std::is_arithmetic<T>::value) {
+                dst = parse_variant1<T>(text);
+            } else {
+                dst = parse_variantN<T, sizeof(T) /
+                                            sizeof(typename T::value_type)>(
+                    text);
+            }
+        },
+        dst);
+
+    return true;
+}
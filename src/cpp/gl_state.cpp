@@ -3,6 +3,9 @@
 #include <shadertoy.hpp>
 
 #include <fstream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
 #include <regex>
 
 #include <glm/gtx/string_cast.hpp>
@@ -17,13 +20,109 @@
 #include "imgui.h"
 
 #include "config.hpp"
+#include "content_hash.hpp"
 #include "gl_state.hpp"
+#include "noise/gabor.hpp"
+#include "noise/splat_table.hpp"
+#include "program_cache.hpp"
+#include "trace.hpp"
 #include "viewer_state.hpp"
 
 #include "options.hpp"
 
 using namespace shadertoy;
 
+/// Data input filled with generated points, read by pg/3d/data.glsl
+static const std::regex regex_splat_table(
+    "^//!\\s+(\\S+)\\s+table=splats\\s*$");
+
+static uint64_t hash_view(const glm::mat4 &model, const glm::mat4 &view) {
+    content_hash hash;
+    hash.add(model);
+    hash.add(view);
+    return hash.value();
+}
+
+/// Preprocessed source of a shader stage, empty if there is none
+static std::string read_source(const shader_file_program &sfp) {
+    if (sfp.empty()) return {};
+
+    auto ifs(sfp.open());
+    return std::string(std::istreambuf_iterator<char>(*ifs),
+                       std::istreambuf_iterator<char>());
+}
+
+/// content_hash of a file, or of nothing if it cannot be read
+static uint64_t hash_file(const std::string &path) {
+    std::ifstream ifs(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(ifs)),
+                         std::istreambuf_iterator<char>());
+
+    content_hash hash;
+    hash.add(contents);
+    return hash.value();
+}
+
+/// Input of the postprocess buffer reading a geometry output of the current
+/// render targets of its chain, so the targets of every size share the
+/// postprocess program
+class geometry_output_input : public inputs::basic_input {
+    const gl_state::render_targets &targets_;
+    output_name_t output_;
+
+   protected:
+    GLenum load_input() override { return GL_RGBA32F; }
+
+    void reset_input() override {
+        // nothing to do
+    }
+
+    backends::gx::texture *use_input() override {
+        auto outputs(std::static_pointer_cast<members::buffer_member>(
+                         targets_.chain.members().front())
+                         ->output());
+
+        auto it = std::find_if(outputs.begin(), outputs.end(),
+                               [this](const auto &out) {
+                                   return std::get<0>(out) == output_;
+                               });
+        if (it == outputs.end()) return nullptr;
+
+        // Sampled with mipmaps, see make_targets
+        std::get<1>(*it)->generate_mipmap();
+        return &*std::get<1>(*it);
+    }
+
+   public:
+    geometry_output_input(const gl_state::render_targets &targets,
+                          const output_name_t &output)
+        : targets_(targets), output_(output) {}
+};
+
+/// Input of the postprocess buffer reading the output of a compute or
+/// postprocessing pass, in the images of the current render target size
+class pass_output_input : public inputs::basic_input {
+    const gl_state::render_targets &targets_;
+    image_allocator &images_;
+    size_t index_;
+
+   protected:
+    GLenum load_input() override { return GL_RGBA32F; }
+
+    void reset_input() override {
+        // nothing to do
+    }
+
+    backends::gx::texture *use_input() override {
+        return images_.image(*targets_.size, index_)->texture();
+    }
+
+   public:
+    pass_output_input(const gl_state::render_targets &targets,
+                      image_allocator &images, size_t index)
+        : targets_(targets), images_(images), index_(index) {}
+};
+
 gl_state::gl_state(const frame_options &opt)
     : g_buffer_template_(std::make_shared<compiler::program_template>()) {
     // The default vertex shader is not sufficient, we replace it with our own
@@ -51,50 +150,164 @@ gl_state::gl_state(const frame_options &opt)
 
     // Set the context parameters (render size and some uniforms)
     render_size = rsize(opt.width, opt.height);
+
+    fit_oriented_bounds = opt.fit_oriented_bounds;
+
+    texture_pool_budget = static_cast<size_t>(opt.texture_pool_mb) << 20;
+    pool_stats = {};
+
+    jitter_ = glm::vec2(0.f);
+    frame_count_ = 0;
+
+    content_hash templates;
+    templates.add(hash_file(SHADERS_BASE "vertex.glsl"));
+    templates.add(hash_file(SHADERS_BASE "fragment.glsl"));
+    template_hash_ = templates.value();
+    geometry_hash_ = 0;
+    view_hash_ = 0;
 }
 
 gl_state::chain_instance::chain_instance(
     std::shared_ptr<compiler::program_template> g_buffer_template,
+    image_allocator &images,
     const shader_program_options &opt, 
     const input_map_t &inputs,
     shadertoy::render_context &context,
-    rsize &render_size)
-    : opt(opt) {
-    bool has_postprocess = !opt.postprocess.empty();
-    // Compile shaders
-    opt.shader.invoke(
-        [this](const auto &path) {
-            if (this->opt.use_make) compile_shader_source(path);
-        },
-        [](const auto &_source) {});
+    const rsize &render_size,
+    const chain_instance *previous)
+    : opt(opt),
+      g_buffer_template_(g_buffer_template),
+      inputs_(inputs),
+      pool_clock_(0),
+      images_(&images),
+      image_count_(0) {
+    // Compile shaders, with a single make invocation for all stages
+    if (opt.use_make) {
+        std::vector<std::string> shader_paths;
+        for (const auto *sfp : {&opt.shader, &opt.postprocess}) {
+            sfp->invoke(
+                [&shader_paths](const auto &path) {
+                    shader_paths.push_back(path);
+                },
+                [](const auto &source) {});
+        }
 
-    if (has_postprocess)
-        opt.postprocess.invoke(
-            [this](const auto &path) {
-                if (this->opt.use_make) compile_shader_source(path);
-            },
-            [](const auto &source) {});
+        shader_paths.insert(shader_paths.end(), opt.compute.begin(),
+                            opt.compute.end());
+        shader_paths.insert(shader_paths.end(), opt.passes.begin(),
+                            opt.passes.end());
+
+        compile_shader_sources(shader_paths);
+    }
+
+    // Hash the preprocessed sources to find unchanged stages
+    std::string shader_source(read_source(opt.shader)),
+        postprocess_source(read_source(opt.postprocess));
+    content_hash shader;
+    shader.add(shader_source);
+    shader_hash = shader.value();
+
+    content_hash sources;
+    sources.add(shader_source);
+    sources.add(postprocess_source);
 
     // Parse uniforms from source
-    parse_directives(opt.shader, false);
-    parse_directives(opt.postprocess, true);
+    parse_directives(shader_source, false);
+    parse_directives(postprocess_source, true);
+
+    // Passes are named after their file, and bound by this name
+    for (const auto &path : opt.compute) {
+        std::string id(make_pass_id(path)),
+            source(read_source(shader_file_program{path, {}}));
+        sources.add(id);
+        sources.add(source);
+
+        compute_passes.emplace_back(
+            std::make_unique<compute_pass>(id, source, discovered_uniforms));
+    }
 
-    // Create the geometry buffer
-    geometry_buffer = std::make_shared<mvw_buffer>("geometry");
+    for (const auto &path : opt.passes) {
+        std::string id(make_pass_id(path)),
+            source(read_source(shader_file_program{path, {}}));
+        sources.add(id);
+        sources.add(source);
 
-    opt.shader.invoke(
-        [&](const auto &path) {
-            shadertoy::sources::set_source_file(
-                *geometry_buffer, g_buffer_template, GL_FRAGMENT_SHADER, path);
-        },
-        [&](const auto &source) {
-            shadertoy::sources::set_source(*geometry_buffer, g_buffer_template,
-                                           GL_FRAGMENT_SHADER, source);
-        });
+        postprocess_passes.emplace_back(std::make_unique<postprocess_pass>(
+            id, source, discovered_uniforms));
+    }
+
+    source_hash = sources.value();
+
+    build_pass_graph();
+    assign_images();
 
-    // Register inputs
-    for (const auto &pair : inputs) {
-        geometry_buffer->inputs().emplace_back(pair.first, pair.second);
+    // Postprocess inputs are bound to the members of their chain, so only
+    // the geometry program can be shared with the previous chain
+    std::shared_ptr<mvw_buffer> geometry_buffer;
+    if (previous && previous->error_status.empty() &&
+        previous->shader_hash == shader_hash) {
+        VLOG->info("Geometry stage unchanged, reusing its program");
+        geometry_buffer = previous->targets.geometry_buffer;
+        reused_geometry_buffer_ = geometry_buffer;
+    }
+
+    make_targets(targets, render_size, context, geometry_buffer);
+
+    // Without its splat table the program does not compile, it is
+    // initialized once gl_state generated the table
+    if (!splat_table.empty() && inputs_.find(splat_table) == inputs_.end()) {
+        needs_init = true;
+        return;
+    }
+
+    // Initialize context
+    init(context);
+}
+
+void gl_state::chain_instance::make_targets(
+    render_targets &targets, const rsize &size, render_context &context,
+    std::shared_ptr<mvw_buffer> shared_geometry_buffer,
+    std::shared_ptr<buffers::toy_buffer> shared_postprocess_buffer) {
+    bool has_postprocess = !opt.postprocess.empty();
+    auto &chain(targets.chain);
+    auto &geometry_chain(targets.geometry_chain);
+    auto &geometry_buffer(targets.geometry_buffer);
+    auto &postprocess_buffer(targets.postprocess_buffer);
+
+    // Members refer to the size, so it must not move with the targets
+    targets.size = std::make_unique<rsize>(size);
+    auto &render_size(*targets.size);
+    targets.last_used = ++pool_clock_;
+    targets.fingerprint = 0;
+    targets.stale = false;
+    targets.released = false;
+    targets.released_size = 0;
+
+    targets.shared_geometry = static_cast<bool>(shared_geometry_buffer);
+
+    if (shared_geometry_buffer) {
+        // Already has its source and inputs
+        geometry_buffer = shared_geometry_buffer;
+    } else {
+        // Create the geometry buffer
+        geometry_buffer = std::make_shared<mvw_buffer>("geometry");
+
+        opt.shader.invoke(
+            [&](const auto &path) {
+                shadertoy::sources::set_source_file(
+                    *geometry_buffer, g_buffer_template_, GL_FRAGMENT_SHADER,
+                    path);
+            },
+            [&](const auto &source) {
+                shadertoy::sources::set_source(*geometry_buffer,
+                                               g_buffer_template_,
+                                               GL_FRAGMENT_SHADER, source);
+            });
+
+        // Register inputs
+        for (const auto &pair : inputs_) {
+            geometry_buffer->inputs().emplace_back(pair.first, pair.second);
+        }
     }
 
     // Add the geometry buffer to the swap chain, at the given size
@@ -130,7 +343,10 @@ gl_state::chain_instance::chain_instance(
     ws.enable(GL_LINE_SMOOTH);
     ws.polygon_mode(GL_LINE);
 
-    if (has_postprocess) {
+    if (shared_postprocess_buffer) {
+        // Already has its source and inputs
+        postprocess_buffer = shared_postprocess_buffer;
+    } else if (has_postprocess) {
         // Add the postprocess buffer
         postprocess_buffer =
             std::make_shared<buffers::toy_buffer>("postprocess");
@@ -149,15 +365,30 @@ gl_state::chain_instance::chain_instance(
 
         // Bind outputs according to the parsed definitions
         for (const auto &binding : buffer_bindings) {
-            auto binding_input(
-                std::make_shared<shadertoy::inputs::buffer_input>(
-                    geometry_target, binding.target_name));
+            std::shared_ptr<shadertoy::inputs::basic_input> binding_input;
+
+            // Pooled targets are swapped into the current ones, so always
+            // read those
+            int pass = find_compute_pass(binding.target_name);
+            int graph_pass = find_postprocess_pass(binding.target_name);
+            if (pass >= 0) {
+                binding_input = std::make_shared<pass_output_input>(
+                    this->targets, *images_, compute_slots[pass]);
+            } else if (graph_pass >= 0) {
+                binding_input = std::make_shared<pass_output_input>(
+                    this->targets, *images_, pass_slots[graph_pass]);
+            } else {
+                binding_input = std::make_shared<geometry_output_input>(
+                    this->targets, binding.target_name);
+            }
 
             binding_input->min_filter(GL_LINEAR_MIPMAP_LINEAR);
             postprocess_buffer->inputs().emplace_back(binding.uniform_name,
                                                       binding_input);
         }
+    }
 
+    if (postprocess_buffer) {
         // Add postprocess pass to the chain
         chain.emplace_back(postprocess_buffer, make_size_ref(render_size),
                            member_swap_policy::single_buffer);
@@ -180,14 +411,37 @@ gl_state::chain_instance::chain_instance(
     screen_member->state().blend_mode_alpha(GL_FUNC_ADD);
     screen_member->state().blend_src_alpha(GL_SRC_ALPHA);
     screen_member->state().blend_dst_alpha(GL_ONE_MINUS_SRC_ALPHA);
+}
 
-    // Initialize context
-    init(context);
+size_t gl_state::render_targets::memory_size() const {
+    if (released) return 0;
+
+    // RGBA32F outputs of every buffer member, and a depth buffer
+    size_t outputs = 0;
+    for (const auto &member : chain.members()) {
+        if (auto buffer_member =
+                std::dynamic_pointer_cast<members::buffer_member>(member)) {
+            outputs += buffer_member->output().size();
+        }
+    }
+
+    // Accumulators are double-buffered
+    outputs += 2 * accumulators.size();
+
+    return static_cast<size_t>(size->width) * size->height *
+           (outputs * 4 * sizeof(float) + sizeof(float));
 }
 
 void gl_state::load_chain(const shader_program_options &opt) {
+    // Latest chain that compiled, to reuse its unchanged programs
+    const chain_instance *previous = nullptr;
+    for (auto it = chains.rbegin(); it != chains.rend() && !previous; ++it) {
+        if ((*it)->error_status.empty()) previous = it->get();
+    }
+
     auto chain = std::make_unique<chain_instance>(
-        g_buffer_template_, opt, inputs_, context, render_size);
+        g_buffer_template_, transient_images, opt, inputs_, context,
+        render_size, previous);
     chain_instance *migrate_uniforms = nullptr;
 
     if (!chains.empty()) {
@@ -222,12 +476,22 @@ void gl_state::load_chain(const shader_program_options &opt) {
             chains.back()->set_named("dLighting", false);
         }
     }
+
+    update_splat_table(*chains.back());
 }
 
 void gl_state::load_geometry(const geometry_options &geometry) {
     // Load geometry
     geometry_ = make_geometry(geometry);
 
+    content_hash geometry_hash;
+    geometry.invoke(
+        [&geometry_hash](const auto &path) {
+            geometry_hash.add(hash_file(path));
+        },
+        [&geometry_hash](const auto &source) { geometry_hash.add(source); });
+    geometry_hash_ = geometry_hash.value();
+
     if (geometry_) {
         // Compute model scale, update state
         //  Fetch dimensions of model
@@ -239,6 +503,16 @@ void gl_state::load_geometry(const geometry_options &geometry) {
 
         if (geometry_->has_hint(HINT_NOSCALE)) {
             scale = 1.;
+        } else if (fit_oriented_bounds) {
+            // Fit the largest extent of the oriented bounding box, which does
+            // not depend on the orientation of the model in its file
+            const auto &obb = geometry_->get_oriented_bounds();
+            float extent = glm::max(obb.half_extents.x,
+                                    glm::max(obb.half_extents.y,
+                                             obb.half_extents.z));
+
+            center = obb.center;
+            scale = 1. / extent;
         } else {
             scale = 2. / dimensions.z;
         }
@@ -255,11 +529,21 @@ void gl_state::load_geometry(const geometry_options &geometry) {
     }
 }
 
+static std::string member_name(
+    const std::shared_ptr<members::basic_member> &member) {
+    if (auto buffer_member =
+            std::dynamic_pointer_cast<members::buffer_member>(member)) {
+        return buffer_member->buffer()->id();
+    }
+
+    return "screen";
+}
+
 void gl_state::chain_instance::render(shadertoy::render_context &context,
                                       bool draw_wireframe,
                                       const shadertoy::rsize &render_size,
                                       std::shared_ptr<mvw_geometry> geometry,
-                                      bool full_render) {
+                                      bool full_render, profiler &timings) {
     // Recompile if required
     if (needs_init) {
         init(context);
@@ -270,6 +554,10 @@ void gl_state::chain_instance::render(shadertoy::render_context &context,
         return;
     }
 
+    auto &chain(targets.chain);
+    auto &geometry_chain(targets.geometry_chain);
+    auto &geometry_buffer(targets.geometry_buffer);
+
     // Set the geometry reference
     geometry_buffer->geometry(geometry);
 
@@ -295,14 +583,34 @@ void gl_state::chain_instance::render(shadertoy::render_context &context,
     // First call: draw the shaded geometry
     // Render the swap chain
     if (full_render) {
-        chain.render(context);
+        // Render members one at a time so each of them gets timed
+        for (const auto &member : chain.members()) {
+            std::string section("gpu." + member_name(member));
+            TRACE_SCOPE(section.c_str(), "gl");
+
+            timings.gpu_begin(section);
+            chain.render(context, member, member);
+            timings.gpu_end(section);
+
+            // Compute and postprocessing passes read the geometry outputs
+            if (member == chain.members().front()) {
+                run_compute_passes(timings);
+                run_postprocess_passes(timings);
+            }
+        }
     } else {
         // Render result is already ok, just render the current texture to the
         // screen
+        TRACE_SCOPE("chain.render", "gl");
+        timings.gpu_begin("gpu.screen");
         chain.render(context, chain.members().back(), chain.members().back());
+        timings.gpu_end("gpu.screen");
     }
 
     if (draw_wireframe) {
+        TRACE_SCOPE("wireframe", "gl");
+        timings.gpu_begin("gpu.wireframe");
+
         // Copy the gl_buffer depth data onto the back left fb
         backends::current()->bind_default_framebuffer(GL_DRAW_FRAMEBUFFER);
         geometry_buffer->target_fbo().bind(GL_READ_FRAMEBUFFER);
@@ -319,6 +627,8 @@ void gl_state::chain_instance::render(shadertoy::render_context &context,
 
         // Note that both chains share the same program, so restore the wireframe value
         geometry_chain.set_uniform("bWireframe", 0);
+
+        timings.gpu_end("gpu.wireframe");
     }
 }
 
@@ -339,13 +649,32 @@ void gl_state::chain_instance::load_defaults() {
 }
 
 void gl_state::chain_instance::init(shadertoy::render_context &context) {
+    TRACE_SCOPE("chain_instance::init", "gl");
+
+    // Cache the programs libshadertoy links for the chains
+    program_cache::link_hook link_hook;
+
+    // Pooled targets would need to be initialized again
+    pool.clear();
+
+    // Outputs may have changed with the program
+    targets.accumulators.clear();
+
     try {
-        context.init(chain);
+        init_chain(targets.chain, context);
         VLOG->debug("Initialized main swap chain");
 
-        context.init(geometry_chain);
+        init_chain(targets.geometry_chain, context);
         VLOG->debug("Initialized geometry-only swap chain");
 
+        for (auto &pass : compute_passes) pass->compile();
+        for (auto &pass : postprocess_passes) pass->compile();
+
+        if (!pass_graph_error_.empty())
+            throw std::runtime_error(pass_graph_error_);
+
+        check_pass_bindings();
+
         error_status = {};
 
         // Set framerate uniforms
@@ -357,46 +686,573 @@ void gl_state::chain_instance::init(shadertoy::render_context &context) {
     } catch (shadertoy::backends::gx::program_link_error &ex) {
         error_status = "Failed to link program: " + ex.log();
         VLOG->error(error_status);
+    } catch (std::runtime_error &ex) {
+        // Compute and postprocessing passes
+        error_status = ex.what();
+        VLOG->error(error_status);
     }
 
     // Outside of try so we don't compile in a loop
     needs_init = false;
+    targets.released = false;
+
+    // Later inits, e.g. for new inputs, must compile it again
+    reused_geometry_buffer_.reset();
+}
+
+void gl_state::chain_instance::init_chain(swap_chain &chain,
+                                          render_context &context) {
+    if (!reused_geometry_buffer_) {
+        context.init(chain);
+        return;
+    }
+
+    for (const auto &member : chain.members()) {
+        auto buffer_member =
+            std::dynamic_pointer_cast<members::buffer_member>(member);
+
+        // The reused program is already compiled, it only needs textures
+        if (buffer_member && buffer_member->buffer() == reused_geometry_buffer_)
+            member->allocate_textures(chain, context);
+        else
+            member->init(chain, context);
+    }
+}
+
+bool gl_state::chain_instance::release_targets(render_context &context) {
+    if (targets.released || needs_init || !error_status.empty()) return false;
+
+    // Members are made again around the compiled buffers, without textures
+    auto geometry_buffer(targets.geometry_buffer);
+    auto postprocess_buffer(targets.postprocess_buffer);
+    rsize size(*targets.size);
+
+    size_t released_size = targets.memory_size();
+    for (const auto &pooled : pool) released_size += pooled.memory_size();
+
+    pool.clear();
+    targets = render_targets();
+    make_targets(targets, size, context, geometry_buffer, postprocess_buffer);
+    targets.released = true;
+    targets.released_size = released_size;
+
+    VLOG->debug("Released the render targets of a chain");
+    return true;
+}
+
+bool gl_state::chain_instance::restore_targets(render_context &context) {
+    if (!targets.released) return false;
+
+    allocate_chain(targets.chain, context);
+    allocate_chain(targets.geometry_chain, context);
+    targets.released = false;
+    targets.released_size = 0;
+
+    restore_uniforms(targets);
+    return true;
+}
+
+void gl_state::chain_instance::allocate_chain(swap_chain &chain,
+                                              render_context &context) {
+    for (const auto &member : chain.members()) {
+        // Buffers are already compiled, their members only need textures
+        if (std::dynamic_pointer_cast<members::buffer_member>(member))
+            member->allocate_textures(chain, context);
+        else
+            member->init(chain, context);
+    }
 }
 
-void gl_state::chain_instance::add_input(const std::string &name, std::shared_ptr<data_input> input) {
-    geometry_buffer->inputs().emplace_back(name, input);
+void gl_state::chain_instance::restore_uniforms(
+    const render_targets &targets) const {
+    for (const auto &pair : uniform_values_) {
+        std::visit(
+            [&](const auto &value) {
+                targets.chain.set_uniform(pair.first, value);
+                targets.geometry_chain.set_uniform(pair.first, value);
+            },
+            pair.second);
+    }
+}
+
+void gl_state::chain_instance::add_input(const std::string &name, std::shared_ptr<data_input> input,
+                                         std::set<const mvw_buffer *> &registered) {
+    inputs_[name] = input;
+
+    if (registered.insert(targets.geometry_buffer.get()).second)
+        targets.geometry_buffer->inputs().emplace_back(name, input);
 
     needs_init = true;
 }
 
-void gl_state::chain_instance::allocate_textures(shadertoy::render_context &context) {
+void gl_state::chain_instance::allocate_textures(
+    shadertoy::render_context &context, const rsize &size, size_t budget,
+    texture_pool_stats &stats, bool use_pool) {
     if (!error_status.empty()) return;
+    if (*targets.size == size) return;
+
+    // Allocated at the new size when the chain is rendered again
+    if (targets.released) {
+        *targets.size = size;
+        return;
+    }
+
+    targets.last_used = ++pool_clock_;
+
+    auto it = std::find_if(pool.begin(), pool.end(), [&size](const auto &t) {
+        return *t.size == size;
+    });
+
+    size_t pool_memory = 0;
+    for (const auto &pooled : pool) pool_memory += pooled.memory_size();
+
+    if (it != pool.end()) {
+        stats.hits++;
+        std::swap(targets, *it);
+
+        // Other targets may have resized the depth attachment of the shared
+        // geometry buffer. Its outputs belong to the members, so they are
+        // kept, and so is the frame they hold.
+        if (targets.shared_geometry) {
+            for (const auto &member : targets.chain.members()) {
+                auto buffer_member =
+                    std::dynamic_pointer_cast<members::buffer_member>(member);
+
+                if (buffer_member &&
+                    buffer_member->buffer() == targets.geometry_buffer) {
+                    targets.geometry_buffer->allocate_textures(
+                        context, buffer_member->io());
+                    break;
+                }
+            }
+        }
+    } else {
+        stats.misses++;
+
+        size_t memory = targets.memory_size();
+        size_t new_memory = memory / (targets.size->width * targets.size->height) *
+                            size.width * size.height;
+
+        if (use_pool && pool_memory + memory + new_memory <= budget) {
+            // Keep the current targets around, new ones share their compiled
+            // buffers and only need textures
+            auto geometry_buffer(targets.geometry_buffer);
+            auto postprocess_buffer(targets.postprocess_buffer);
+            pool.emplace_back(std::move(targets));
+            pool.back().shared_geometry = true;
+
+            targets = render_targets();
+            make_targets(targets, size, context, geometry_buffer,
+                         postprocess_buffer);
+
+            allocate_chain(targets.chain, context);
+            allocate_chain(targets.geometry_chain, context);
+        } else {
+            // No room, so resize the current targets
+            stats.resizes++;
+
+            *targets.size = size;
+            targets.fingerprint = 0;
+            context.allocate_textures(targets.chain);
+            context.allocate_textures(targets.geometry_chain);
+
+            for (auto &pair : targets.accumulators)
+                context.allocate_textures(pair.second.chain);
+        }
+    }
+
+    // Averages of pooled targets are out of date
+    reset_accumulation();
+
+    // Evict the least recently used targets over the budget
+    pool_memory = 0;
+    for (const auto &pooled : pool) pool_memory += pooled.memory_size();
+
+    while (!pool.empty() && pool_memory + targets.memory_size() > budget) {
+        auto lru = std::min_element(
+            pool.begin(), pool.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.last_used < rhs.last_used;
+            });
+
+        pool_memory -= lru->memory_size();
+        pool.erase(lru);
+        stats.evictions++;
+    }
 
-    context.allocate_textures(chain);
-    context.allocate_textures(geometry_chain);
+    // Uniform values of pooled targets are out of date
+    restore_uniforms(targets);
 }
 
-void gl_state::chain_instance::parse_directives(const shader_file_program &sfp, bool parse_bindings) {
-    if (sfp.empty()) return;
+gl_state::accumulator &gl_state::chain_instance::find_accumulator(
+    render_context &context,
+    const std::shared_ptr<members::buffer_member> &member,
+    const output_name_t &output) {
+    std::stringstream ss;
+    ss << member->buffer()->id() << '.';
+    std::visit([&ss](const auto &name) { ss << name; }, output);
+    std::string key(ss.str());
+
+    auto it = targets.accumulators.find(key);
+    if (it != targets.accumulators.end()) return it->second;
+
+    auto outputs(member->output());
+    if (std::none_of(outputs.begin(), outputs.end(),
+                     [&output](const auto &out) {
+                         return std::get<0>(out) == output;
+                     })) {
+        throw std::runtime_error("output target '" + key + "' was not found");
+    }
+
+    auto buffer(std::make_shared<buffers::toy_buffer>("accumulate"));
+    shadertoy::sources::set_source_file(*buffer, context.buffer_template(),
+                                        GL_FRAGMENT_SHADER,
+                                        SHADERS_BASE "accumulate.glsl");
+    buffer->inputs().emplace_back(
+        "iCurrent", std::make_shared<inputs::buffer_input>(member, output));
+
+    accumulator acc{};
+
+    auto acc_member =
+        acc.chain.emplace_back(buffer, make_size_ref(*targets.size),
+                               member_swap_policy::double_buffer);
+
+    // Reading its own output gives the average of the previous samples
+    buffer->inputs().emplace_back(
+        "iPrevious", std::make_shared<inputs::buffer_input>(acc_member));
+
+    {
+        program_cache::link_hook link_hook;
+        context.init(acc.chain);
+    }
+
+    return targets.accumulators.emplace(key, std::move(acc)).first->second;
+}
+
+void gl_state::chain_instance::reset_accumulation() {
+    for (auto &pair : targets.accumulators) pair.second.samples = 0;
+}
 
+void gl_state::chain_instance::parse_directives(const std::string &source, bool parse_bindings) {
     std::string line;
-    auto ifs(sfp.open());
-    while (!ifs->eof()) {
-        std::getline(*ifs, line);
-        if (!try_parse_uniform(line, discovered_uniforms) && parse_bindings)
+    std::istringstream iss(source);
+    std::smatch match;
+    while (std::getline(iss, line)) {
+        if (try_parse_uniform(line, discovered_uniforms)) continue;
+
+        if (parse_bindings) {
             try_parse_binding(line, buffer_bindings);
+        } else if (std::regex_search(line, match, regex_splat_table)) {
+            VLOG->debug("Parsed splat table declaration for {}",
+                        match.str(1));
+            splat_table = match.str(1);
+        }
     }
 }
 
-void gl_state::chain_instance::compile_shader_source(
-    const std::string &shader_path) {
-    if (shader_path.empty()) return;
+int gl_state::chain_instance::find_compute_pass(
+    const output_name_t &target) const {
+    auto name = std::get_if<std::string>(&target);
+    if (!name) return -1;
 
-    VLOG->info("Compiling {} using make", shader_path);
+    for (size_t i = 0; i < compute_passes.size(); ++i) {
+        if (compute_passes[i]->id() == *name) return i;
+    }
 
-    int pid = fork();
+    return -1;
+}
+
+int gl_state::chain_instance::find_postprocess_pass(
+    const output_name_t &target) const {
+    auto name = std::get_if<std::string>(&target);
+    if (!name) return -1;
+
+    for (size_t i = 0; i < postprocess_passes.size(); ++i) {
+        if (postprocess_passes[i]->id() == *name) return i;
+    }
+
+    return -1;
+}
+
+std::string gl_state::chain_instance::make_pass_id(
+    const std::string &path) const {
+    std::string id(path.substr(path.find_last_of('/') + 1));
+    id = id.substr(0, id.find('.'));
+
+    auto taken = [this](const std::string &id) {
+        return find_compute_pass(id) >= 0 || find_postprocess_pass(id) >= 0;
+    };
+
+    for (int n = 2; taken(id); ++n)
+        id = id.substr(0, id.find_last_of('#')) + '#' + std::to_string(n);
+
+    return id;
+}
+
+void gl_state::chain_instance::build_pass_graph() {
+    size_t count = postprocess_passes.size();
+    if (count == 0) return;
+
+    if (opt.postprocess.empty()) {
+        VLOG->warn("Postprocessing passes need a postprocess shader to read "
+                   "them, skipping them");
+        postprocess_passes.clear();
+        return;
+    }
+
+    // Passes read by each pass
+    std::vector<std::vector<size_t>> reads(count);
+    for (size_t i = 0; i < count; ++i) {
+        for (const auto &binding : postprocess_passes[i]->bindings()) {
+            int j = find_postprocess_pass(binding.target_name);
+            if (j >= 0) reads[i].push_back(j);
+        }
+    }
+
+    // Passes needed by the postprocess shader
+    std::vector<bool> needed(count, false);
+    std::vector<size_t> pending;
+    for (const auto &binding : buffer_bindings) {
+        int j = find_postprocess_pass(binding.target_name);
+        if (j >= 0) pending.push_back(j);
+    }
+
+    while (!pending.empty()) {
+        size_t i = pending.back();
+        pending.pop_back();
+        if (needed[i]) continue;
+
+        needed[i] = true;
+        pending.insert(pending.end(), reads[i].begin(), reads[i].end());
+    }
+
+    // Depth-first order, passes without dependencies between them keep the
+    // command line order
+    enum { unvisited, visiting, visited };
+    std::vector<int> state(count, unvisited);
+    std::vector<size_t> order;
+
+    std::function<bool(size_t)> visit = [&](size_t i) {
+        if (state[i] == visited) return true;
+        if (state[i] == visiting) return false;
+
+        state[i] = visiting;
+        for (size_t j : reads[i]) {
+            if (!visit(j)) return false;
+        }
+
+        state[i] = visited;
+        order.push_back(i);
+        return true;
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        if (!needed[i]) {
+            VLOG->warn("Postprocessing pass {} is not read by the postprocess "
+                       "shader, skipping it",
+                       postprocess_passes[i]->id());
+        } else if (!visit(i)) {
+            pass_graph_error_ = "Postprocessing pass " +
+                                postprocess_passes[i]->id() +
+                                " depends on its own output";
+            return;
+        }
+    }
+
+    std::vector<std::unique_ptr<postprocess_pass>> ordered;
+    for (size_t i : order)
+        ordered.emplace_back(std::move(postprocess_passes[i]));
+
+    postprocess_passes = std::move(ordered);
+}
+
+void gl_state::chain_instance::assign_images() {
+    size_t compute_count = compute_passes.size(),
+           count = compute_count + postprocess_passes.size();
+
+    // Position of the last reader of each output, in run order: compute
+    // passes, postprocessing passes, then the postprocess shader. Outputs
+    // nothing reads are free once written.
+    std::vector<size_t> last_read(count);
+    std::iota(last_read.begin(), last_read.end(), 0);
+
+    auto read_at = [&](const output_name_t &target, size_t position) {
+        int j = find_compute_pass(target);
+        if (j < 0) {
+            j = find_postprocess_pass(target);
+            if (j >= 0) j += compute_count;
+        }
+
+        // Outputs of later passes are never written before the read
+        if (j >= 0 && size_t(j) < position)
+            last_read[j] = std::max(last_read[j], position);
+    };
+
+    for (size_t i = 0; i < compute_count; ++i) {
+        for (const auto &binding : compute_passes[i]->bindings())
+            read_at(binding.target_name, i);
+    }
+
+    for (size_t i = 0; i < postprocess_passes.size(); ++i) {
+        for (const auto &binding : postprocess_passes[i]->bindings())
+            read_at(binding.target_name, compute_count + i);
+    }
+
+    for (const auto &binding : buffer_bindings)
+        read_at(binding.target_name, count);
+
+    // An image can be written again once the last reader of its previous
+    // output ran, which gives the least images for this order
+    std::vector<size_t> image_last_read, slots;
+    for (size_t k = 0; k < count; ++k) {
+        auto it = std::find_if(image_last_read.begin(), image_last_read.end(),
+                               [k](size_t last) { return last < k; });
+
+        if (it == image_last_read.end()) {
+            slots.push_back(image_last_read.size());
+            image_last_read.push_back(last_read[k]);
+        } else {
+            slots.push_back(it - image_last_read.begin());
+            *it = last_read[k];
+        }
+    }
+
+    compute_slots.assign(slots.begin(), slots.begin() + compute_count);
+    pass_slots.assign(slots.begin() + compute_count, slots.end());
+    image_count_ = image_last_read.size();
+
+    if (count > 0)
+        VLOG->info("Running {} passes with {} images", count, image_count_);
+}
+
+void gl_state::chain_instance::check_pass_bindings() const {
+    auto geometry_outputs(
+        std::static_pointer_cast<members::buffer_member>(
+            targets.chain.members().front())
+            ->output());
+
+    auto check = [&](const std::string &kind, const std::string &id,
+                     const output_name_t &target) {
+        if (find_compute_pass(target) >= 0 ||
+            find_postprocess_pass(target) >= 0)
+            return;
+
+        if (std::any_of(geometry_outputs.begin(), geometry_outputs.end(),
+                        [&target](const auto &out) {
+                            return std::get<0>(out) == target;
+                        }))
+            return;
+
+        std::stringstream ss;
+        ss << kind << " " << id << " binds a missing output ";
+        std::visit([&ss](const auto &name) { ss << name; }, target);
+        throw std::runtime_error(ss.str());
+    };
+
+    for (const auto &pass : compute_passes) {
+        for (const auto &binding : pass->bindings())
+            check("Compute pass", pass->id(), binding.target_name);
+    }
+
+    for (const auto &pass : postprocess_passes) {
+        for (const auto &binding : pass->bindings())
+            check("Postprocessing pass", pass->id(), binding.target_name);
+    }
+}
+
+backends::gx::texture *gl_state::chain_instance::find_pass_input(
+    const output_name_t &target,
+    const std::vector<members::member_output_t> &geometry_outputs) {
+    int pass = find_compute_pass(target);
+    if (pass >= 0)
+        return images_->image(*targets.size, compute_slots[pass])->texture();
+
+    pass = find_postprocess_pass(target);
+    if (pass >= 0)
+        return images_->image(*targets.size, pass_slots[pass])->texture();
+
+    auto it = std::find_if(geometry_outputs.begin(), geometry_outputs.end(),
+                           [&target](const auto &out) {
+                               return std::get<0>(out) == target;
+                           });
+
+    if (it == geometry_outputs.end()) return nullptr;
+
+    return &*std::get<1>(*it);
+}
+
+void gl_state::chain_instance::run_compute_passes(profiler &timings) {
+    if (compute_passes.empty()) return;
+
+    auto geometry_outputs(
+        std::static_pointer_cast<members::buffer_member>(
+            targets.chain.members().front())
+            ->output());
+
+    for (size_t i = 0; i < compute_passes.size(); ++i) {
+        auto &pass(*compute_passes[i]);
+
+        std::string section("gpu." + pass.id());
+        TRACE_SCOPE(section.c_str(), "gl");
+        timings.gpu_begin(section);
+
+        // Bindings were checked by init
+        std::vector<backends::gx::texture *> inputs;
+        for (const auto &binding : pass.bindings())
+            inputs.push_back(
+                find_pass_input(binding.target_name, geometry_outputs));
+
+        auto output(images_->image(*targets.size, compute_slots[i]));
+        pass.dispatch(inputs, *output, *targets.size);
+        timings.gpu_end(section);
+    }
+}
+
+void gl_state::chain_instance::run_postprocess_passes(profiler &timings) {
+    if (postprocess_passes.empty()) return;
+
+    auto geometry_outputs(
+        std::static_pointer_cast<members::buffer_member>(
+            targets.chain.members().front())
+            ->output());
+
+    // Geometry outputs are sampled with mipmaps, as by the postprocess shader
+    std::set<backends::gx::texture *> geometry_mipmaps;
+
+    for (size_t i = 0; i < postprocess_passes.size(); ++i) {
+        auto &pass(*postprocess_passes[i]);
+
+        std::string section("gpu." + pass.id());
+        TRACE_SCOPE(section.c_str(), "gl");
+        timings.gpu_begin(section);
+
+        // Bindings were checked by init
+        std::vector<backends::gx::texture *> inputs;
+        for (const auto &binding : pass.bindings()) {
+            auto texture(
+                find_pass_input(binding.target_name, geometry_outputs));
+
+            if (find_compute_pass(binding.target_name) < 0 &&
+                find_postprocess_pass(binding.target_name) < 0 &&
+                geometry_mipmaps.insert(texture).second)
+                texture->generate_mipmap();
+
+            inputs.push_back(texture);
+        }
+
+        pass.draw(inputs, *images_->image(*targets.size, pass_slots[i]),
+                  *targets.size, pass_target_);
+        timings.gpu_end(section);
+    }
+}
+
+void gl_state::chain_instance::compile_shader_sources(
+    const std::vector<std::string> &shader_paths) {
+    if (shader_paths.empty()) return;
+
+    std::vector<std::string> basenames;
+    for (const auto &shader_path : shader_paths) {
+        VLOG->info("Compiling {} using make", shader_path);
 
-    if (pid == 0) {
         size_t begin;
         if ((begin = shader_path.find_last_of('/')) != std::string::npos) {
             begin++;
@@ -404,10 +1260,18 @@ void gl_state::chain_instance::compile_shader_source(
             begin = 0;
         }
 
-        std::string basename(shader_path.begin() + begin, shader_path.end());
-        const char *args[] = {"make", basename.c_str(), NULL};
+        basenames.emplace_back(shader_path.begin() + begin, shader_path.end());
+    }
+
+    std::vector<const char *> args{"make"};
+    for (const auto &basename : basenames) args.push_back(basename.c_str());
+    args.push_back(NULL);
+
+    int pid = fork();
 
-        execvp("make", const_cast<char *const *>(args));
+    if (pid == 0) {
+        execvp("make", const_cast<char *const *>(args.data()));
+        _exit(127);
     } else {
         int status;
         waitpid(pid, &status, 0);
@@ -420,9 +1284,29 @@ void gl_state::chain_instance::compile_shader_source(
 
 void gl_state::render(bool draw_wireframe, int back_revision,
                       bool full_render) {
-    chains.at(chains.size() + back_revision - 1)
-        ->render(context, draw_wireframe, render_size,
-                 geometry_, full_render);
+    TRACE_SCOPE("gl_state::render", "gl");
+
+    auto &chain(chains.at(chains.size() + back_revision - 1));
+    update_splat_table(*chain);
+
+    // Only the rendered revision keeps the textures of its members
+    bool released = false;
+    for (auto &other : chains) {
+        if (other != chain) released |= other->release_targets(context);
+    }
+
+    if (released) release_images();
+
+    if (chain->restore_targets(context)) full_render = true;
+
+    chain->render(context, draw_wireframe, render_size, geometry_,
+                  full_render, timings);
+
+    if (full_render) chain->targets.stale = static_cast<bool>(tile_);
+
+    if (full_render && chain->error_status.empty())
+        chain->targets.fingerprint =
+            fingerprint(view_hash_, back_revision, render_size);
 }
 
 bool gl_state::render_imgui(int back_revision) {
@@ -456,47 +1340,115 @@ bool gl_state::render_imgui(int back_revision) {
     return changed;
 }
 
-void gl_state::get_render_ms(float times[2], int back_revision) {
-    auto &chain(chains.at(chains.size() + back_revision - 1));
+/// Buffer member of the given name, or the one shown on screen if empty
+static std::shared_ptr<members::buffer_member> find_buffer_member(
+    const gl_state::chain_instance &chain, const std::string &target) {
+    if (target.empty()) {
+        return std::static_pointer_cast<members::buffer_member>(
+            *++chain.targets.chain.members().rbegin());
+    }
+
+    auto it = std::find_if(
+        chain.targets.chain.members().begin(),
+        chain.targets.chain.members().end(),
+        [&target](const auto &member) {
+            if (auto buffer_member =
+                    std::dynamic_pointer_cast<members::buffer_member>(
+                        member)) {
+                return buffer_member->buffer()->id() == target;
+            }
 
-    times[0] = chain->geometry_buffer->elapsed_time() / 1.0e6f;
+            return false;
+        });
+
+    if (it == chain.targets.chain.members().end())
+        throw std::runtime_error(target + " member not found");
 
-    if (chain->postprocess_buffer)
-        times[1] = chain->postprocess_buffer->elapsed_time() / 1.0e6f;
-    else
-        times[1] = 0.0f;
+    return std::static_pointer_cast<members::buffer_member>(*it);
 }
 
 std::vector<shadertoy::members::member_output_t> gl_state::get_render_result(int back_revision, const std::string &target) const {
     auto &chain(chains.at(chains.size() + back_revision - 1));
-    std::shared_ptr<members::buffer_member> member;
+    auto member(find_buffer_member(*chain, target));
 
-    if (target.empty()) {
-        member = std::static_pointer_cast<members::buffer_member>(
-            *++chain->chain.members().rbegin());
-    } else {
-        auto it = std::find_if(
-            chain->chain.members().begin(), chain->chain.members().end(),
-            [&target](const auto &member) {
-                if (auto buffer_member =
-                        std::dynamic_pointer_cast<members::buffer_member>(
-                            member)) {
-                    return buffer_member->buffer()->id() == target;
-                }
+    VLOG->info("Fetching frame({}) rev {}", member->buffer()->id(),
+               back_revision);
 
-                return false;
-            });
+    return member->output();
+}
+
+/// Sub-pixel offset of the given sample, from the (2, 3) Halton sequence
+static glm::vec2 sample_jitter(int sample) {
+    // The first sample is the regular frame
+    if (sample == 0) return glm::vec2(0.f);
 
-        if (it == chain->chain.members().end())
-            throw std::runtime_error(target + " member not found");
+    glm::vec2 result(0.f);
+    const int bases[] = {2, 3};
 
-        member = std::static_pointer_cast<members::buffer_member>(*it);
+    for (int axis = 0; axis < 2; ++axis) {
+        float f = 1.f;
+        for (int i = sample; i > 0; i /= bases[axis]) {
+            f /= bases[axis];
+            result[axis] += f * (i % bases[axis]);
+        }
     }
 
-    VLOG->info("Fetching frame({}) rev {}", member->buffer()->id(),
-               back_revision);
+    return result - 0.5f;
+}
 
-    return member->output();
+std::vector<shadertoy::members::member_output_t> gl_state::accumulate(
+    int samples, int back_revision, const std::string &target,
+    const output_name_t &output) {
+    TRACE_SCOPE("gl_state::accumulate", "gl");
+
+    auto &chain(chains.at(chains.size() + back_revision - 1));
+    auto &acc(chain->find_accumulator(context, find_buffer_member(*chain, target),
+                                      output));
+    auto acc_member(std::static_pointer_cast<members::buffer_member>(
+        acc.chain.members().front()));
+
+    // Samples of another render state are out of date, and an average of
+    // more samples than requested can not be narrowed down
+    uint64_t state_fingerprint =
+        fingerprint(view_hash_, back_revision, render_size);
+    if (acc.fingerprint != state_fingerprint || acc.samples > samples) {
+        acc.samples = 0;
+        acc.fingerprint = state_fingerprint;
+    }
+
+    if (acc.samples == samples) return acc_member->output();
+
+    for (; acc.samples < samples; acc.samples++) {
+        // Successive iFrame values decorrelate the noise of the samples
+        jitter_ = sample_jitter(acc.samples);
+        update_frame_uniforms();
+        chain->set_uniform("iFrame", acc.samples);
+
+        chain->render(context, false, render_size, geometry_, true, timings);
+
+        if (!chain->error_status.empty()) break;
+
+        TRACE_SCOPE("gpu.accumulate", "gl");
+        timings.gpu_begin("gpu.accumulate");
+        acc.chain.set_uniform("iSampleCount", acc.samples);
+        context.render(acc.chain);
+        timings.gpu_end("gpu.accumulate");
+    }
+
+    // The regular frame is only rendered again when it is read, see
+    // stale_frame
+    jitter_ = glm::vec2(0.f);
+    update_frame_uniforms();
+    chain->set_uniform("iFrame", frame_count_);
+    chain->targets.fingerprint = 0;
+    chain->targets.stale = true;
+
+    if (!chain->error_status.empty())
+        throw std::runtime_error(
+            "render failed because of a compilation error: " +
+            chain->error_status);
+
+    return acc_member->output();
 }
 
 std::string gl_state::get_render_error(int back_revision) const {
@@ -514,25 +1466,158 @@ std::vector<discovered_uniform> &gl_state::get_discovered_uniforms(
     return chains.at(chains.size() + back_revision - 1)->discovered_uniforms;
 }
 
+template <typename T>
+static void get_uniform(const std::vector<discovered_uniform> &uniforms,
+                        const char *name, T &value) {
+    for (const auto &uniform : uniforms) {
+        if (uniform.s_name == name) {
+            if (auto p = std::get_if<T>(&uniform.value); p) value = *p;
+            return;
+        }
+    }
+}
+
+/// Take the values of the uniforms of gabor-noise-solid.glsl, other ones are
+/// ignored
+static noise::gabor_params make_gabor_params(
+    const std::vector<discovered_uniform> &uniforms) {
+    noise::gabor_params params;
+    get_uniform(uniforms, "gSplats", params.splats);
+    get_uniform(uniforms, "gF0", params.f0);
+    get_uniform(uniforms, "gW0", params.w0);
+    get_uniform(uniforms, "gLobes", params.lobes);
+    get_uniform(uniforms, "gTilesize", params.tile_size);
+    get_uniform(uniforms, "aSigma", params.sigma);
+    get_uniform(uniforms, "dQuad", params.quad);
+    return params;
+}
+
+noise::gabor_params gl_state::get_gabor_params(int back_revision) const {
+    auto params(make_gabor_params(get_discovered_uniforms(back_revision)));
+    params.bbox_min = bbox_min;
+    params.bbox_max = bbox_max;
+    return params;
+}
+
 bool gl_state::has_postprocess(int back_revision) const {
     return !chains.at(chains.size() + back_revision - 1)
                 ->opt.postprocess.empty();
 }
 
-void gl_state::allocate_textures() {
+void gl_state::allocate_textures(bool use_pool) {
     for (auto &chain : chains) {
-        chain->allocate_textures(context);
+        chain->allocate_textures(context, render_size, texture_pool_budget,
+                                 pool_stats, use_pool);
+    }
+
+    release_images();
+}
+
+void gl_state::release_images() {
+    std::vector<rsize> sizes;
+    for (const auto &chain : chains) {
+        if (!chain->targets.released) sizes.push_back(*chain->targets.size);
+        for (const auto &pooled : chain->pool) sizes.push_back(*pooled.size);
+    }
+
+    transient_images.release_unused(sizes);
+}
+
+std::map<std::string, double> gl_state::memory_stats() const {
+    size_t targets_memory = 0, unaliased_memory = 0, released_memory = 0;
+    for (const auto &chain : chains) {
+        size_t passes =
+            chain->compute_passes.size() + chain->postprocess_passes.size();
+
+        auto add = [&](const render_targets &targets) {
+            if (targets.released) {
+                released_memory += targets.released_size;
+                return;
+            }
+
+            targets_memory += targets.memory_size();
+            unaliased_memory += passes * targets.size->width *
+                                targets.size->height * 4 * sizeof(float);
+        };
+
+        add(chain->targets);
+        for (const auto &pooled : chain->pool) add(pooled);
+    }
+
+    size_t transient_memory = transient_images.memory_size();
+    size_t saved = released_memory;
+    if (unaliased_memory > transient_memory)
+        saved += unaliased_memory - transient_memory;
+
+    auto mb = [](size_t bytes) { return bytes / double(1 << 20); };
+    return {
+        {"targets_mb", mb(targets_memory)},
+        {"transient_mb", mb(transient_memory)},
+        {"unaliased_mb", mb(unaliased_memory)},
+        {"released_mb", mb(released_memory)},
+        {"saved_mb", mb(saved)},
+        {"transient_images", static_cast<double>(transient_images.count())},
+    };
+}
+
+uint64_t gl_state::fingerprint(const viewer_state &state, int back_revision,
+                               const rsize &size) const {
+    return fingerprint(hash_view(state.get_model(), state.get_view()),
+                       back_revision, size);
+}
+
+uint64_t gl_state::fingerprint(uint64_t view_hash, int back_revision,
+                               const rsize &size) const {
+    auto &chain(chains.at(chains.size() + back_revision - 1));
+
+    content_hash hash;
+    hash.add(view_hash);
+    hash.add(template_hash_);
+    hash.add(chain->source_hash);
+    hash.add(geometry_hash_);
+    hash.add(size.width);
+    hash.add(size.height);
+    hash.add(jitter_);
+    hash.add(tile_.has_value());
+
+    if (tile_) {
+        hash.add(tile_->frame_size.width);
+        hash.add(tile_->frame_size.height);
+        hash.add(tile_->x);
+        hash.add(tile_->y);
+    }
+
+    for (const auto &pair : input_hashes_) {
+        hash.add(pair.first);
+        hash.add(pair.second);
+    }
+
+    for (const auto &du : chain->discovered_uniforms) {
+        std::visit([&hash](const auto &value) { hash.add(value); }, du.value);
     }
+
+    // 0 stands for targets without a frame
+    return hash.value() ? hash.value() : 1;
+}
+
+uint64_t gl_state::rendered_fingerprint(int back_revision) const {
+    return chains.at(chains.size() + back_revision - 1)->targets.fingerprint;
+}
+
+bool gl_state::stale_frame(int back_revision) const {
+    return chains.at(chains.size() + back_revision - 1)->targets.stale;
 }
 
 void gl_state::update_uniforms(float t, const viewer_state &state) {
-    // Update model, view and projection matrices
+    TRACE_SCOPE("gl_state::update_uniforms");
+    scoped_timer timer(timings, "cpu.uniforms");
+
+    // Update model and view matrices
     glm::mat4 mModel = state.get_model();
     glm::mat4 mView = state.get_view();
-    // Projection matrix display range : 0.1 unit <-> 100 units
-    glm::mat4 mProj = glm::perspective(
-        glm::radians(25.0f),
-        (float)render_size.width / (float)render_size.height, 0.1f, 100.0f);
+
+    frame_count_ = state.frame_count;
+    view_hash_ = hash_view(mModel, mView);
 
     for (auto &chain : chains) {
         chain->set_uniform("iTime", t);
@@ -540,11 +1625,58 @@ void gl_state::update_uniforms(float t, const viewer_state &state) {
 
         chain->set_uniform("mModel", mModel);
         chain->set_uniform("mView", mView);
-        chain->set_uniform("mProj", mProj);
 
         chain->set_uniform("bboxMax", bbox_max);
         chain->set_uniform("bboxMin", bbox_min);
     }
+
+    update_frame_uniforms();
+}
+
+void gl_state::set_tile(const std::optional<tile_region> &tile) {
+    tile_ = tile;
+    update_frame_uniforms();
+}
+
+void gl_state::update_frame_uniforms() {
+    rsize frame_size(tile_ ? tile_->frame_size : render_size);
+    float frame_width = frame_size.width, frame_height = frame_size.height;
+
+    // Projection matrix display range : 0.1 unit <-> 100 units
+    glm::mat4 mProj = glm::perspective(
+        glm::radians(25.0f), frame_width / frame_height, 0.1f, 100.0f);
+
+    // Scale and offset the clip space so the tile covers the viewport
+    glm::mat4 mTile(1.0f);
+    if (tile_) {
+        float width = render_size.width, height = render_size.height;
+
+        mTile = glm::translate(
+                    glm::mat4(1.0f),
+                    glm::vec3((frame_width - 2.f * tile_->x - width) / width,
+                              (frame_height - 2.f * tile_->y - height) / height,
+                              0.f)) *
+                glm::scale(glm::mat4(1.0f),
+                           glm::vec3(frame_width / width,
+                                     frame_height / height, 1.f));
+    }
+
+    // Sub-pixel offset of accumulated samples
+    if (jitter_ != glm::vec2(0.f)) {
+        mTile = glm::translate(glm::mat4(1.0f),
+                               glm::vec3(2.f * jitter_.x / render_size.width,
+                                         2.f * jitter_.y / render_size.height,
+                                         0.f)) *
+                mTile;
+    }
+
+    glm::vec3 iFullResolution(frame_width, frame_height, 1.0f);
+
+    for (auto &chain : chains) {
+        chain->set_uniform("mProj", mProj);
+        chain->set_uniform("mTile", mTile);
+        chain->set_uniform("iFullResolution", iFullResolution);
+    }
 }
 
 void gl_state::load_defaults() {
@@ -559,11 +1691,22 @@ void gl_state::load_defaults() {
 }
 
 void gl_state::set_input(const std::string &name, std::vector<float> data, std::array<uint32_t, 3> dims) {
+    client_inputs_.insert(name);
+    store_input(name, std::move(data), dims);
+}
+
+void gl_state::store_input(const std::string &name, std::vector<float> data,
+                           std::array<uint32_t, 3> dims) {
+    content_hash input_hash;
+    input_hash.add(dims);
+    input_hash.add_bytes(data.data(), data.size() * sizeof(float));
+    input_hashes_[name] = input_hash.value();
+
     if (auto it = inputs_.find(name); it != inputs_.end()) {
         VLOG->debug("updating input data for {}", name);
 
         // Existing input
-        it->second->data = data;
+        it->second->data = std::move(data);
         it->second->dims = dims;
         it->second->state = dis_gpu_dirty;
     } else {
@@ -571,14 +1714,50 @@ void gl_state::set_input(const std::string &name, std::vector<float> data, std::
 
         // New input
         auto input(std::make_shared<data_input>());
-        input->data = data;
+        input->data = std::move(data);
         input->dims = dims;
 
-        inputs_.emplace(name, input);
+        inputs_[name] = input;
 
-        // Register the input in all chains
+        // Register the input in all chains, once per geometry buffer
+        std::set<const mvw_buffer *> registered;
         for (auto &chain : chains) {
-            chain->add_input(name, input);
+            chain->add_input(name, input, registered);
         }
     }
 }
+
+void gl_state::update_splat_table(const chain_instance &chain) {
+    if (chain.splat_table.empty() || client_inputs_.count(chain.splat_table))
+        return;
+
+    auto params(make_gabor_params(chain.discovered_uniforms));
+    params.bbox_min = bbox_min;
+    params.bbox_max = bbox_max;
+
+    std::tuple<glm::ivec3, int, int> key(params.tile_count(),
+                                         params.random_seed, params.splats);
+    if (splat_table_key_ == key) return;
+
+    TRACE_SCOPE("gl_state::update_splat_table");
+    scoped_timer timer(timings, "cpu.splat_table");
+
+    auto table(noise::make_splat_table(std::get<0>(key), std::get<1>(key),
+                                       std::get<2>(key)));
+
+    GLint max_size = 0;
+    // No libshadertoy wrapper yet
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    if (table.dims[0] > uint32_t(max_size) ||
+        table.dims[1] > uint32_t(max_size)) {
+        VLOG->warn("Splat table of {}x{} exceeds the texture size limit",
+                   table.dims[0], table.dims[1]);
+    } else {
+        VLOG->debug("Generated {}x{} splat table for {}", table.dims[0],
+                    table.dims[1], chain.splat_table);
+        store_input(chain.splat_table, std::move(table.data), table.dims);
+    }
+
+    // Do not retry until the parameters change
+    splat_table_key_ = key;
+}
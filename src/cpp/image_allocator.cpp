@@ -0,0 +1,45 @@
+#include <algorithm>
+
+#include "image_allocator.hpp"
+
+std::shared_ptr<compute_output> image_allocator::image(
+    const shadertoy::rsize &size, size_t index) {
+    auto &images(images_[std::make_pair(size.width, size.height)]);
+    while (images.size() <= index)
+        images.emplace_back(std::make_shared<compute_output>());
+
+    return images[index];
+}
+
+void image_allocator::release_unused(
+    const std::vector<shadertoy::rsize> &sizes) {
+    for (auto it = images_.begin(); it != images_.end();) {
+        bool used = std::any_of(sizes.begin(), sizes.end(),
+                                [&it](const auto &size) {
+                                    return it->first.first == size.width &&
+                                           it->first.second == size.height;
+                                });
+
+        if (used)
+            ++it;
+        else
+            it = images_.erase(it);
+    }
+}
+
+size_t image_allocator::count() const {
+    size_t count = 0;
+    for (const auto &pair : images_) count += pair.second.size();
+    return count;
+}
+
+size_t image_allocator::memory_size() const {
+    size_t pixels = 0;
+    for (const auto &pair : images_) {
+        for (const auto &image : pair.second)
+            pixels += size_t(image->size().width) * image->size().height;
+    }
+
+    // RGBA32F, without the mipmaps
+    return pixels * 4 * sizeof(float);
+}
@@ -7,6 +7,7 @@
 
 #include <boost/program_options.hpp>
 
+#include "trace.hpp"
 #include "viewer_window.hpp"
 
 using namespace shadertoy;
@@ -52,6 +53,8 @@ int main(int argc, char *argv[]) {
         ("shader,S", po::value(&opt.program.shader.source), "Source of the shader program")
         ("postprocess-file,p", po::value(&opt.program.postprocess.path), "Path to the postprocessing shader")
         ("postprocess,P", po::value(&opt.program.postprocess.source), "Source of the postprocessing shader")
+        ("compute-file", po::value(&opt.program.compute)->composing(), "Path to a compute pass run before postprocessing, may be repeated")
+        ("pass-file", po::value(&opt.program.passes)->composing(), "Path to a postprocessing pass run before the postprocess shader, may be repeated")
         ("use-make,m", po::bool_switch(&opt.program.use_make), "Compile the target shader file using make first")
         /* geometry */
         ("geometry-file,g", po::value(&opt.geometry.path), "Path to the geometry to load")
@@ -59,13 +62,24 @@ int main(int argc, char *argv[]) {
         /* frame options */
         ("width,W", po::value(&opt.frame.width)->default_value(512), "Frame width")
         ("height,H", po::value(&opt.frame.height)->default_value(512), "Frame height")
+        ("oriented-bounds", po::bool_switch(&opt.frame.fit_oriented_bounds)->default_value(false), "Fit geometry to the frame using its oriented bounding box")
+        ("texture-pool", po::value(&opt.frame.texture_pool_mb)->default_value(512), "Memory budget in MB for render targets kept across getframe size changes")
+        ("max-fps", po::value(&opt.frame.max_fps)->default_value(0), "Maximum frame rate, 0 for no limit")
         /* server options */
         ("bind,b", po::value(&opt.server.bind_addr)->default_value(default_bind_addr()), "Server bind address")
+        ("frame-cache", po::value(&opt.server.frame_cache)->default_value(0), "Number of getframe results kept on the GPU for repeated requests, 0 to disable")
+        ("frame-store", po::value(&opt.server.frame_store_dir), "Directory of the on-disk cache of getframe results, shared across runs")
+        ("frame-store-mb", po::value(&opt.server.frame_store_mb)->default_value(4096), "Size limit of the on-disk cache of getframe results in MB")
+        ("shm-frames", po::value(&opt.server.shm_frames)->default_value(0), "Number of shared memory slots for getframe results of local clients, 0 to disable")
+        ("shm-slot-mb", po::value(&opt.server.shm_slot_mb)->default_value(64), "Size of each shared memory slot in MB")
         /* log options */
         ("debug,d", po::bool_switch(&opt.log.debug)->default_value(false), "Enable debug logs")
         ("verbose,v", po::bool_switch(&opt.log.verbose)->default_value(false), "Enable verbose logs")
+        ("trace", po::value(&opt.log.trace_path), "Write a Chrome trace-event file of the frame timeline")
         /* viewer options */
         ("headless,q", po::bool_switch(&opt.headless_mode)->default_value(false), "Headless renderer mode")
+        ("program-cache", po::value(&opt.program_cache_dir), "Directory of the on-disk cache of linked pass programs, shared across runs")
+        ("program-cache-mb", po::value(&opt.program_cache_mb)->default_value(256), "Size limit of the on-disk cache of linked pass programs in MB")
         /* misc */
         ("help,h", "Show this help message");
     // clang-format on
@@ -107,6 +121,8 @@ int main(int argc, char *argv[]) {
 
     // Initialize window
     try {
+        if (!opt.log.trace_path.empty()) trace::open(opt.log.trace_path);
+
         viewer_window window(std::move(opt));
         window.run();
     } catch (gx::shader_compilation_error &sce) {
@@ -124,6 +140,8 @@ int main(int argc, char *argv[]) {
         code = 1;
     }
 
+    trace::close();
+
     glfwTerminate();
     return code;
 }
@@ -26,39 +26,24 @@ assimp_geometry::assimp_geometry(const std::string &geometry,
         throw std::runtime_error("No meshes found in imported file");
     }
 
-    glm::vec3 d_min(0., 0., 0.), d_max(0., 0., 0.);
-    glm::dvec3 d_centroid(0., 0., 0.);
-    size_t centroid_count = 0;
+    std::vector<mesh_data> meshes(scene->mNumMeshes);
 
-    // Just get the first mesh
     for (size_t mi = 0; mi < scene->mNumMeshes; ++mi) {
         aiMesh *mesh = scene->mMeshes[mi];
 
-        std::vector<vertex_data> vertices;
-        std::vector<uint32_t> indices;
+        auto &vertices = meshes[mi].vertices;
+        auto &indices = meshes[mi].indices;
 
-        vertices.reserve(mesh->mNumVertices * 8);
+        vertices.reserve(mesh->mNumVertices);
         indices.reserve(mesh->mNumFaces * 3);
 
         for (size_t i = 0; i < mesh->mNumVertices; ++i) {
-            glm::vec3 p(mesh->mVertices[i].x, mesh->mVertices[i].y,
-                        mesh->mVertices[i].z);
-
-            // Compute bounding box
-            if (p.x < d_min.x) d_min.x = p.x;
-            if (p.y < d_min.y) d_min.y = p.y;
-            if (p.z < d_min.z) d_min.z = p.z;
-
-            if (p.x > d_max.x) d_max.x = p.x;
-            if (p.y > d_max.y) d_max.y = p.y;
-            if (p.z > d_max.z) d_max.z = p.z;
-
-            d_centroid += p;
-
             // Prepare vertex_data
             vertex_data d;
 
-            d.position = p;
+            d.position.x = mesh->mVertices[i].x;
+            d.position.y = mesh->mVertices[i].y;
+            d.position.z = mesh->mVertices[i].z;
 
             d.normal.x = mesh->mNormals[i].x;
             d.normal.y = mesh->mNormals[i].y;
@@ -72,8 +57,6 @@ assimp_geometry::assimp_geometry(const std::string &geometry,
             vertices.push_back(d);
         }
 
-        centroid_count += mesh->mNumVertices;
-
         for (size_t i = 0; i < mesh->mNumFaces; ++i) {
             auto face = mesh->mFaces[i];
 
@@ -82,12 +65,8 @@ assimp_geometry::assimp_geometry(const std::string &geometry,
             std::copy(face.mIndices, face.mIndices + face.mNumIndices,
                       std::back_inserter(indices));
         }
-
-        add_vertex_data(vertices, indices);
     }
 
-    bbox_min_ = d_min;
-    bbox_max_ = d_max;
-    if (centroid_count > 0)
-        bbox_centroid_ = d_centroid / static_cast<double>(centroid_count);
+    // Upload, bounding box and centroid
+    add_meshes(meshes);
 }
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+#include "mvw/bounds.hpp"
+#include "parallel_for.hpp"
+
+/// Vertices per parallel task
+static const size_t chunk_size = 1 << 16;
+
+/// Vertices accumulated in single precision before flushing to double
+static const size_t block_size = 1 << 10;
+
+vertex_bounds::vertex_bounds()
+    : min(std::numeric_limits<float>::infinity()),
+      max(-std::numeric_limits<float>::infinity()),
+      sum(0.),
+      count(0) {}
+
+void vertex_bounds::merge(const vertex_bounds &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+oriented_bounds::oriented_bounds()
+    : center(0.f), axes(1.f), half_extents(0.f) {}
+
+oriented_bounds oriented_bounds::from_aabb(const glm::vec3 &min,
+                                           const glm::vec3 &max) {
+    oriented_bounds result;
+    result.center = (min + max) / 2.f;
+    result.half_extents = (max - min) / 2.f;
+    return result;
+}
+
+namespace {
+struct vertex_range {
+    const vertex_data *begin;
+    size_t size;
+};
+
+struct covariance_sums {
+    double xx, yy, zz, xy, yz, zx;
+
+    covariance_sums() : xx(0.), yy(0.), zz(0.), xy(0.), yz(0.), zx(0.) {}
+
+    void merge(const covariance_sums &other) {
+        xx += other.xx;
+        yy += other.yy;
+        zz += other.zz;
+        xy += other.xy;
+        yz += other.yz;
+        zx += other.zx;
+    }
+};
+
+struct projected_extents {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    projected_extents()
+        : min(std::numeric_limits<float>::infinity()),
+          max(-std::numeric_limits<float>::infinity()) {}
+
+    void merge(const projected_extents &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+};
+
+template <typename T, typename Kernel>
+T parallel_reduce(const std::vector<mesh_data> &meshes, Kernel kernel) {
+    // Split meshes into chunks, so large meshes also use all threads
+    std::vector<vertex_range> ranges;
+    for (const auto &mesh : meshes) {
+        for (size_t offset = 0; offset < mesh.vertices.size();
+             offset += chunk_size) {
+            ranges.push_back(
+                {mesh.vertices.data() + offset,
+                 std::min(chunk_size, mesh.vertices.size() - offset)});
+        }
+    }
+
+    auto partial = parallel_for<T>(
+        ranges.size(),
+        [&](T &result, size_t i) { result.merge(kernel(ranges[i])); });
+
+    T result;
+    for (const auto &part : partial) result.merge(part);
+
+    return result;
+}
+
+#if defined(__SSE2__)
+/// Load the positions of four vertices as one register per component
+inline void load4(const vertex_data *v, __m128 &x, __m128 &y, __m128 &z) {
+    __m128 p0 = _mm_loadu_ps(&v[0].position.x);
+    __m128 p1 = _mm_loadu_ps(&v[1].position.x);
+    __m128 p2 = _mm_loadu_ps(&v[2].position.x);
+    __m128 p3 = _mm_loadu_ps(&v[3].position.x);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    x = p0;
+    y = p1;
+    z = p2;
+}
+
+inline double hsum(__m128 v) {
+    alignas(16) float f[4];
+    _mm_store_ps(f, v);
+    return (double(f[0]) + double(f[1])) + (double(f[2]) + double(f[3]));
+}
+
+inline float hmin(__m128 v) {
+    alignas(16) float f[4];
+    _mm_store_ps(f, v);
+    return std::min(std::min(f[0], f[1]), std::min(f[2], f[3]));
+}
+
+inline float hmax(__m128 v) {
+    alignas(16) float f[4];
+    _mm_store_ps(f, v);
+    return std::max(std::max(f[0], f[1]), std::max(f[2], f[3]));
+}
+#endif
+
+vertex_bounds bounds_kernel(const vertex_range &range) {
+    vertex_bounds result;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const size_t simd_size = range.size & ~size_t(3);
+    __m128 min_x = _mm_set1_ps(result.min.x), min_y = min_x, min_z = min_x;
+    __m128 max_x = _mm_set1_ps(result.max.x), max_y = max_x, max_z = max_x;
+
+    while (i < simd_size) {
+        size_t block_end = std::min(simd_size, i + block_size);
+        __m128 sum_x = _mm_setzero_ps(), sum_y = sum_x, sum_z = sum_x;
+
+        for (; i < block_end; i += 4) {
+            __m128 x, y, z;
+            load4(range.begin + i, x, y, z);
+
+            min_x = _mm_min_ps(min_x, x);
+            min_y = _mm_min_ps(min_y, y);
+            min_z = _mm_min_ps(min_z, z);
+            max_x = _mm_max_ps(max_x, x);
+            max_y = _mm_max_ps(max_y, y);
+            max_z = _mm_max_ps(max_z, z);
+            sum_x = _mm_add_ps(sum_x, x);
+            sum_y = _mm_add_ps(sum_y, y);
+            sum_z = _mm_add_ps(sum_z, z);
+        }
+
+        result.sum += glm::dvec3(hsum(sum_x), hsum(sum_y), hsum(sum_z));
+    }
+
+    result.min = glm::vec3(hmin(min_x), hmin(min_y), hmin(min_z));
+    result.max = glm::vec3(hmax(max_x), hmax(max_y), hmax(max_z));
+    result.count = i;
+#endif
+
+    for (; i < range.size; ++i) {
+        const auto &p = range.begin[i].position;
+        result.min = glm::min(result.min, p);
+        result.max = glm::max(result.max, p);
+        result.sum += glm::dvec3(p);
+        result.count++;
+    }
+
+    return result;
+}
+
+covariance_sums covariance_kernel(const vertex_range &range,
+                                  const glm::vec3 &center) {
+    covariance_sums result;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const size_t simd_size = range.size & ~size_t(3);
+    const __m128 c_x = _mm_set1_ps(center.x), c_y = _mm_set1_ps(center.y),
+                 c_z = _mm_set1_ps(center.z);
+
+    while (i < simd_size) {
+        size_t block_end = std::min(simd_size, i + block_size);
+        __m128 xx = _mm_setzero_ps(), yy = xx, zz = xx, xy = xx, yz = xx,
+               zx = xx;
+
+        for (; i < block_end; i += 4) {
+            __m128 x, y, z;
+            load4(range.begin + i, x, y, z);
+
+            x = _mm_sub_ps(x, c_x);
+            y = _mm_sub_ps(y, c_y);
+            z = _mm_sub_ps(z, c_z);
+
+            xx = _mm_add_ps(xx, _mm_mul_ps(x, x));
+            yy = _mm_add_ps(yy, _mm_mul_ps(y, y));
+            zz = _mm_add_ps(zz, _mm_mul_ps(z, z));
+            xy = _mm_add_ps(xy, _mm_mul_ps(x, y));
+            yz = _mm_add_ps(yz, _mm_mul_ps(y, z));
+            zx = _mm_add_ps(zx, _mm_mul_ps(z, x));
+        }
+
+        result.xx += hsum(xx);
+        result.yy += hsum(yy);
+        result.zz += hsum(zz);
+        result.xy += hsum(xy);
+        result.yz += hsum(yz);
+        result.zx += hsum(zx);
+    }
+#endif
+
+    for (; i < range.size; ++i) {
+        glm::vec3 d = range.begin[i].position - center;
+        result.xx += d.x * d.x;
+        result.yy += d.y * d.y;
+        result.zz += d.z * d.z;
+        result.xy += d.x * d.y;
+        result.yz += d.y * d.z;
+        result.zx += d.z * d.x;
+    }
+
+    return result;
+}
+
+projected_extents projection_kernel(const vertex_range &range,
+                                    const glm::vec3 &center,
+                                    const glm::mat3 &axes) {
+    projected_extents result;
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const size_t simd_size = range.size & ~size_t(3);
+    const __m128 c_x = _mm_set1_ps(center.x), c_y = _mm_set1_ps(center.y),
+                 c_z = _mm_set1_ps(center.z);
+    __m128 a[3][3], min_d[3], max_d[3];
+
+    for (int k = 0; k < 3; ++k) {
+        for (int c = 0; c < 3; ++c) a[k][c] = _mm_set1_ps(axes[k][c]);
+        min_d[k] = _mm_set1_ps(result.min[k]);
+        max_d[k] = _mm_set1_ps(result.max[k]);
+    }
+
+    for (; i < simd_size; i += 4) {
+        __m128 x, y, z;
+        load4(range.begin + i, x, y, z);
+
+        x = _mm_sub_ps(x, c_x);
+        y = _mm_sub_ps(y, c_y);
+        z = _mm_sub_ps(z, c_z);
+
+        for (int k = 0; k < 3; ++k) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, a[k][0]), _mm_mul_ps(y, a[k][1])),
+                _mm_mul_ps(z, a[k][2]));
+            min_d[k] = _mm_min_ps(min_d[k], d);
+            max_d[k] = _mm_max_ps(max_d[k], d);
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        result.min[k] = hmin(min_d[k]);
+        result.max[k] = hmax(max_d[k]);
+    }
+#endif
+
+    for (; i < range.size; ++i) {
+        glm::vec3 d = range.begin[i].position - center;
+        for (int k = 0; k < 3; ++k) {
+            float p = glm::dot(d, axes[k]);
+            result.min[k] = std::min(result.min[k], p);
+            result.max[k] = std::max(result.max[k], p);
+        }
+    }
+
+    return result;
+}
+
+/// Eigenvectors of a symmetric 3x3 matrix, using cyclic Jacobi rotations
+void symmetric_eigenvectors(double a[3][3], double v[3][3]) {
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) v[r][c] = r == c ? 1. : 0.;
+
+    for (int sweep = 0; sweep < 32; ++sweep) {
+        double off = a[0][1] * a[0][1] + a[1][2] * a[1][2] + a[0][2] * a[0][2];
+        if (off < 1e-24) break;
+
+        for (int p = 0; p < 2; ++p) {
+            for (int q = p + 1; q < 3; ++q) {
+                if (a[p][q] == 0.) continue;
+
+                double theta = (a[q][q] - a[p][p]) / (2. * a[p][q]);
+                double t = (theta >= 0. ? 1. : -1.) /
+                           (std::abs(theta) + std::sqrt(theta * theta + 1.));
+                double c = 1. / std::sqrt(t * t + 1.), s = t * c;
+
+                for (int k = 0; k < 3; ++k) {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    double vkp = v[k][p], vkq = v[k][q];
+                    v[k][p] = c * vkp - s * vkq;
+                    v[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+}  // namespace
+
+vertex_bounds reduce_bounds(const std::vector<mesh_data> &meshes) {
+    return parallel_reduce<vertex_bounds>(meshes, bounds_kernel);
+}
+
+oriented_bounds reduce_oriented_bounds(const std::vector<mesh_data> &meshes,
+                                       const vertex_bounds &bounds) {
+    if (bounds.empty()) return oriented_bounds{};
+
+    glm::vec3 centroid(bounds.centroid());
+
+    // Principal axes of the vertex distribution
+    auto sums = parallel_reduce<covariance_sums>(
+        meshes,
+        [&centroid](const auto &range) {
+            return covariance_kernel(range, centroid);
+        });
+
+    double cov[3][3] = {{sums.xx, sums.xy, sums.zx},
+                        {sums.xy, sums.yy, sums.yz},
+                        {sums.zx, sums.yz, sums.zz}};
+    double eigenvectors[3][3];
+    symmetric_eigenvectors(cov, eigenvectors);
+
+    glm::mat3 axes;
+    for (int k = 0; k < 3; ++k)
+        axes[k] = glm::normalize(glm::vec3(
+            eigenvectors[0][k], eigenvectors[1][k], eigenvectors[2][k]));
+
+    // Keep a right-handed basis
+    if (glm::dot(glm::cross(axes[0], axes[1]), axes[2]) < 0.f)
+        axes[2] = -axes[2];
+
+    // Extents along the principal axes
+    auto extents = parallel_reduce<projected_extents>(
+        meshes,
+        [&centroid, &axes](const auto &range) {
+            return projection_kernel(range, centroid, axes);
+        });
+
+    oriented_bounds result;
+    glm::vec3 mid = (extents.min + extents.max) / 2.f;
+    result.center = centroid + axes * mid;
+    result.axes = axes;
+    result.half_extents = (extents.max - extents.min) / 2.f;
+
+    return result;
+}
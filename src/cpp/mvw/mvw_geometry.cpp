@@ -1,3 +1,12 @@
+#include <epoxy/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#include <glm/mat4x4.hpp>
+
 #include "mvw/mvw_geometry.hpp"
 
 #include "log.hpp"
@@ -11,7 +20,22 @@ mvw_geometry::mvw_mesh::mvw_mesh()
 {
 }
 
-mvw_geometry::mvw_geometry() : basic_geometry() {}
+mvw_geometry::mvw_geometry()
+    : basic_geometry(),
+    instances_(backends::current()->make_buffer(GL_ARRAY_BUFFER)),
+    instance_count_(1),
+    centroid_count_(0),
+    bbox_min_(std::numeric_limits<float>::infinity()),
+    bbox_max_(-std::numeric_limits<float>::infinity()),
+    bbox_centroid_(0.)
+{
+    // Single identity transform for non-instanced geometry
+    glm::mat4 identity(1.f);
+
+    instances_->bind(GL_ARRAY_BUFFER);
+    instances_->data(sizeof(glm::mat4), &identity, GL_STATIC_DRAW);
+    instances_->unbind(GL_ARRAY_BUFFER);
+}
 
 void mvw_geometry::add_vertex_data(const std::vector<vertex_data> &vertices,
                                    const std::vector<uint32_t> &indices) {
@@ -48,6 +72,18 @@ void mvw_geometry::add_vertex_data(const std::vector<vertex_data> &vertices,
                            (void *)(offsetof(struct vertex_data, normal)));
     normals->enable_vertex_array();
 
+    // bind input "instanceTransform" to per-instance model matrices (4 vec4)
+    instances_->bind(GL_ARRAY_BUFFER);
+    for (GLuint column = 0; column < 4; ++column) {
+        auto transform(backends::current()->make_attrib_location(3 + column));
+        transform->vertex_pointer(4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void *)(column * sizeof(glm::vec4)));
+        transform->enable_vertex_array();
+
+        // No libshadertoy wrapper yet
+        glVertexAttribDivisor(3 + column, 1);
+    }
+
     // Unbind
     mesh.vao->unbind();
     mesh.indices->unbind(GL_ELEMENT_ARRAY_BUFFER);
@@ -56,6 +92,37 @@ void mvw_geometry::add_vertex_data(const std::vector<vertex_data> &vertices,
     meshes_.emplace_back(std::move(mesh));
 }
 
+void mvw_geometry::add_meshes(const std::vector<mesh_data> &meshes) {
+    // Reduce bounds while the meshes are being uploaded
+    auto bounds_future = std::async(std::launch::async, [&meshes]() {
+        auto bounds = reduce_bounds(meshes);
+        return std::make_pair(bounds, reduce_oriented_bounds(meshes, bounds));
+    });
+
+    for (const auto &mesh : meshes) {
+        add_vertex_data(mesh.vertices, mesh.indices);
+    }
+
+    auto bounds(bounds_future.get());
+    const auto &aabb = bounds.first;
+
+    if (aabb.empty()) return;
+
+    bool first_meshes = centroid_count_ == 0;
+
+    bbox_min_ = glm::min(bbox_min_, aabb.min);
+    bbox_max_ = glm::max(bbox_max_, aabb.max);
+
+    bbox_centroid_ =
+        (bbox_centroid_ * static_cast<double>(centroid_count_) + aabb.sum) /
+        static_cast<double>(centroid_count_ + aabb.count);
+    centroid_count_ += aabb.count;
+
+    oriented_bounds_ = first_meshes
+                           ? bounds.second
+                           : oriented_bounds::from_aabb(bbox_min_, bbox_max_);
+}
+
 void mvw_geometry::set_hint(const std::string &hint, hint_value value) {
     hints_[hint] = value;
     std::visit([&](const auto &v) {
@@ -63,9 +130,56 @@ void mvw_geometry::set_hint(const std::string &hint, hint_value value) {
     }, value);
 }
 
+void mvw_geometry::set_instances(int count, float spacing) {
+    glm::vec3 extent = bbox_max_ - bbox_min_;
+    float cell = spacing * std::max(extent.x, extent.z);
+
+    int columns = static_cast<int>(std::ceil(std::sqrt(count)));
+    int rows = (count + columns - 1) / columns;
+
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(count);
+    glm::dvec3 offset_sum(0.);
+
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 offset(cell * ((i % columns) - (columns - 1) / 2.f), 0.f,
+                         cell * ((i / columns) - (rows - 1) / 2.f));
+
+        glm::mat4 transform(1.f);
+        transform[3] = glm::vec4(offset, 1.f);
+        transforms.push_back(transform);
+
+        offset_sum += offset;
+    }
+
+    instances_->bind(GL_ARRAY_BUFFER);
+    instances_->data(sizeof(glm::mat4) * transforms.size(), transforms.data(),
+                     GL_STATIC_DRAW);
+    instances_->unbind(GL_ARRAY_BUFFER);
+
+    // Only the last row may be incomplete, so the grid always spans all
+    // columns and rows
+    glm::vec3 half_grid(cell * (columns - 1) / 2.f, 0.f,
+                        cell * (rows - 1) / 2.f);
+    bbox_min_ -= half_grid;
+    bbox_max_ += half_grid;
+    bbox_centroid_ += offset_sum / static_cast<double>(count);
+    oriented_bounds_ = oriented_bounds::from_aabb(bbox_min_, bbox_max_);
+
+    instance_count_ = count;
+}
+
 void mvw_geometry::draw() const {
     for (const auto &mesh : meshes_) {
-        mesh.vao->draw_elements(GL_TRIANGLES, mesh.indices_size, GL_UNSIGNED_INT, nullptr);
+        if (instance_count_ == 1) {
+            mesh.vao->draw_elements(GL_TRIANGLES, mesh.indices_size, GL_UNSIGNED_INT, nullptr);
+        } else {
+            // No libshadertoy wrapper yet
+            mesh.vao->bind();
+            glDrawElementsInstanced(GL_TRIANGLES, mesh.indices_size,
+                                    GL_UNSIGNED_INT, nullptr, instance_count_);
+            mesh.vao->unbind();
+        }
     }
 }
 
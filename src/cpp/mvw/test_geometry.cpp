@@ -1,7 +1,11 @@
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 
+#include <glm/geometric.hpp>
+
 #include "mvw/test_geometry.hpp"
 
 #define SYNTAX_GETL(input, line, lnum) \
@@ -12,14 +16,74 @@
 
 #define SYNTAX_ASSERT(as, msg, lnum)                              \
     do {                                                          \
-        if (!as) {                                                \
+        if (!(as)) {                                              \
             std::stringstream ss;                                 \
             ss << "syntax error at line " << lnum << ": " << msg; \
             throw std::runtime_error(ss.str());                   \
         }                                                         \
     } while (0)
 
-void test_geometry::plane_geometry(const std::string &line) {
+template <typename T>
+static T read_arg(std::istream &in, T default_value) {
+    // Once an argument is missing, the stream fails and all following
+    // arguments take their default value
+    T value;
+    in >> value;
+    return in.fail() ? default_value : value;
+}
+
+static void grid_indices(std::vector<uint32_t> &indices, uint32_t base, int nu,
+                         int nv, bool skip_first = false,
+                         bool skip_last = false) {
+    // Vertices are laid out as base + i * (nv + 1) + j. Triangles are wound so
+    // that cross(dP/dj, dP/di) is the front face normal.
+    for (int i = 0; i < nu; ++i) {
+        for (int j = 0; j < nv; ++j) {
+            uint32_t a = base + i * (nv + 1) + j;
+            uint32_t b = a + (nv + 1);
+            uint32_t c = b + 1;
+            uint32_t d = a + 1;
+
+            // Degenerate triangles at the poles of a UV sphere
+            if (!(skip_first && i == 0)) {
+                indices.push_back(a);
+                indices.push_back(d);
+                indices.push_back(c);
+            }
+
+            if (!(skip_last && i == nu - 1)) {
+                indices.push_back(a);
+                indices.push_back(c);
+                indices.push_back(b);
+            }
+        }
+    }
+}
+
+static void patch_vertices(std::vector<vertex_data> &vertices,
+                           std::vector<uint32_t> &indices, glm::vec3 center,
+                           glm::vec3 normal, glm::vec3 tangent, float half_size,
+                           int nu, int nv, glm::vec2 uv_min, glm::vec2 uv_max) {
+    // Square patch facing normal, subdivided in nu x nv quads
+    glm::vec3 bitangent = glm::cross(tangent, normal);
+    uint32_t base = vertices.size();
+
+    for (int i = 0; i <= nu; ++i) {
+        for (int j = 0; j <= nv; ++j) {
+            glm::vec2 st(float(i) / nu, float(j) / nv);
+            glm::vec2 pq = 2.f * st - 1.f;
+
+            vertices.emplace_back(
+                center + half_size * (pq.x * tangent + pq.y * bitangent),
+                normal, glm::mix(uv_min, uv_max, st));
+        }
+    }
+
+    grid_indices(indices, base, nu, nv);
+}
+
+void test_geometry::plane_geometry(const std::string &line,
+                                   std::vector<mesh_data> &meshes) {
     // Plane geometry
     std::vector<vertex_data> vertices;
     std::vector<uint32_t> indices;
@@ -56,9 +120,10 @@ void test_geometry::plane_geometry(const std::string &line) {
     indices.push_back(3);
     indices.push_back(2);
 
-    add_vertex_data(vertices, indices);
+    meshes.push_back({std::move(vertices), std::move(indices)});
 
-    // Manual bounding box
+    // Manual bounding box, which also spans the Y axis since shaders
+    // evaluate noise at bboxMin + vPosition
     bbox_min_ = glm::min(bbox_min_, glm::vec3(-dim));
     bbox_max_ = glm::max(bbox_max_, glm::vec3(dim));
 
@@ -68,12 +133,271 @@ void test_geometry::plane_geometry(const std::string &line) {
     set_hint(HINT_NOLIGHT);
 }
 
+void test_geometry::grid_geometry(const std::string &line, int lnum,
+                                  std::vector<mesh_data> &meshes) {
+    // Subdivided plane geometry, same extent and mapping as plane
+    std::vector<vertex_data> vertices;
+    std::vector<uint32_t> indices;
+    std::istringstream in(line);
+
+    std::string s;
+    in >> s; // grid
+
+    float dim = read_arg(in, 100.0f);
+    int nx = read_arg(in, 64);
+    int ny = read_arg(in, nx);
+
+    SYNTAX_ASSERT(nx > 0 && ny > 0, "grid subdivisions must be positive", lnum);
+
+    patch_vertices(vertices, indices, glm::vec3(0.f), glm::vec3(0, 1, 0),
+                   glm::vec3(1, 0, 0), dim, nx, ny, glm::vec2(-dim),
+                   glm::vec2(dim));
+
+    meshes.push_back({std::move(vertices), std::move(indices)});
+
+    // Same manual bounding box as the plane
+    bbox_min_ = glm::min(bbox_min_, glm::vec3(-dim));
+    bbox_max_ = glm::max(bbox_max_, glm::vec3(dim));
+
+    // Same hints as the plane, so it can be used as a drop-in replacement
+    set_hint(HINT_NOSCALE);
+    set_hint(HINT_NOLIGHT);
+}
+
+void test_geometry::sphere_geometry(const std::string &line, int lnum,
+                                    std::vector<mesh_data> &meshes) {
+    // UV sphere geometry
+    std::vector<vertex_data> vertices;
+    std::vector<uint32_t> indices;
+    std::istringstream in(line);
+
+    std::string s;
+    in >> s; // sphere
+
+    float radius = read_arg(in, 1.0f);
+    int slices = read_arg(in, 64);
+    int stacks = read_arg(in, slices / 2);
+
+    SYNTAX_ASSERT(slices >= 3 && stacks >= 2,
+                  "sphere needs at least 3 slices and 2 stacks", lnum);
+
+    // The seam column is duplicated so texture coordinates wrap correctly
+    for (int i = 0; i <= stacks; ++i) {
+        float theta = float(M_PI) * i / stacks;
+
+        for (int j = 0; j <= slices; ++j) {
+            float phi = 2.f * float(M_PI) * j / slices;
+            glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta),
+                        std::sin(theta) * std::sin(phi));
+
+            vertices.emplace_back(radius * n, n,
+                                  glm::vec2(float(j) / slices,
+                                            float(i) / stacks));
+        }
+    }
+
+    grid_indices(indices, 0, stacks, slices, true, true);
+
+    meshes.push_back({std::move(vertices), std::move(indices)});
+}
+
+void test_geometry::icosphere_geometry(const std::string &line, int lnum,
+                                       std::vector<mesh_data> &meshes) {
+    // Subdivided icosahedron geometry
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> faces;
+    std::istringstream in(line);
+
+    std::string s;
+    in >> s; // icosphere
+
+    float radius = read_arg(in, 1.0f);
+    int subdivisions = read_arg(in, 3);
+
+    SYNTAX_ASSERT(subdivisions >= 0 && subdivisions <= 10,
+                  "icosphere subdivisions must be between 0 and 10", lnum);
+
+    const float t = (1.f + std::sqrt(5.f)) / 2.f;
+    for (const auto &p : {glm::vec3(-1, t, 0), glm::vec3(1, t, 0),
+                          glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+                          glm::vec3(0, -1, t), glm::vec3(0, 1, t),
+                          glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+                          glm::vec3(t, 0, -1), glm::vec3(t, 0, 1),
+                          glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1)}) {
+        positions.push_back(glm::normalize(p));
+    }
+
+    faces = {0, 11, 5,  0, 5,  1, 0, 1, 7, 0, 7,  10, 0, 10, 11,
+             1, 5,  9,  5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+             3, 9,  4,  3, 4,  2, 3, 2, 6, 3, 6,  8,  3, 8,  9,
+             4, 9,  5,  2, 4,  11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+
+    for (int k = 0; k < subdivisions; ++k) {
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+        std::vector<uint32_t> subdivided;
+        subdivided.reserve(faces.size() * 4);
+
+        auto midpoint = [&](uint32_t a, uint32_t b) {
+            auto key = std::make_pair(std::min(a, b), std::max(a, b));
+            auto it = midpoints.find(key);
+            if (it != midpoints.end()) return it->second;
+
+            uint32_t idx = positions.size();
+            positions.push_back(
+                glm::normalize(positions[a] + positions[b]));
+            midpoints.emplace(key, idx);
+            return idx;
+        };
+
+        for (size_t f = 0; f < faces.size(); f += 3) {
+            uint32_t a = faces[f], b = faces[f + 1], c = faces[f + 2];
+            uint32_t ab = midpoint(a, b), bc = midpoint(b, c),
+                     ca = midpoint(c, a);
+
+            for (uint32_t idx : {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca})
+                subdivided.push_back(idx);
+        }
+
+        faces.swap(subdivided);
+    }
+
+    // Spherical mapping, consistent with the UV sphere
+    std::vector<vertex_data> vertices;
+    vertices.reserve(positions.size());
+    for (const auto &n : positions) {
+        float u = std::atan2(n.z, n.x) / (2.f * float(M_PI));
+        vertices.emplace_back(
+            radius * n, n,
+            glm::vec2(u < 0.f ? u + 1.f : u,
+                      std::acos(glm::clamp(n.y, -1.f, 1.f)) / float(M_PI)));
+    }
+
+    // Duplicate the vertices of triangles crossing the u = 0 seam, and give
+    // pole vertices the mean u of the triangle they belong to
+    std::map<uint32_t, uint32_t> wrapped;
+    std::vector<uint32_t> indices(faces);
+    for (size_t f = 0; f < indices.size(); f += 3) {
+        uint32_t *tri = &indices[f];
+        float u_min = 1.f, u_max = 0.f;
+        int non_poles = 0;
+
+        for (int v = 0; v < 3; ++v) {
+            if (std::abs(vertices[tri[v]].normal.y) > 1.f - 1e-6f) continue;
+            u_min = std::min(u_min, vertices[tri[v]].texCoords.x);
+            u_max = std::max(u_max, vertices[tri[v]].texCoords.x);
+            non_poles++;
+        }
+
+        if (u_max - u_min > .5f) {
+            for (int v = 0; v < 3; ++v) {
+                if (vertices[tri[v]].texCoords.x >= .5f ||
+                    std::abs(vertices[tri[v]].normal.y) > 1.f - 1e-6f)
+                    continue;
+
+                auto it = wrapped.find(tri[v]);
+                if (it == wrapped.end()) {
+                    vertex_data d(vertices[tri[v]]);
+                    d.texCoords.x += 1.f;
+                    vertices.push_back(d);
+                    it = wrapped.emplace(tri[v], vertices.size() - 1).first;
+                }
+
+                tri[v] = it->second;
+            }
+        }
+
+        for (int v = 0; v < 3 && non_poles > 0; ++v) {
+            if (std::abs(vertices[tri[v]].normal.y) <= 1.f - 1e-6f) continue;
+
+            float u = 0.f;
+            for (int w = 0; w < 3; ++w)
+                if (w != v) u += vertices[tri[w]].texCoords.x;
+
+            vertex_data d(vertices[tri[v]]);
+            d.texCoords.x = u / non_poles;
+            vertices.push_back(d);
+            tri[v] = vertices.size() - 1;
+        }
+    }
+
+    meshes.push_back({std::move(vertices), std::move(indices)});
+}
+
+void test_geometry::torus_geometry(const std::string &line, int lnum,
+                                   std::vector<mesh_data> &meshes) {
+    // Torus geometry around the Y axis
+    std::vector<vertex_data> vertices;
+    std::vector<uint32_t> indices;
+    std::istringstream in(line);
+
+    std::string s;
+    in >> s; // torus
+
+    float major_radius = read_arg(in, 1.0f);
+    float minor_radius = read_arg(in, 0.25f);
+    int major_segments = read_arg(in, 64);
+    int minor_segments = read_arg(in, major_segments / 2);
+
+    SYNTAX_ASSERT(major_segments >= 3 && minor_segments >= 3,
+                  "torus needs at least 3 segments on each circle", lnum);
+
+    for (int i = 0; i <= major_segments; ++i) {
+        float u = 2.f * float(M_PI) * i / major_segments;
+
+        for (int j = 0; j <= minor_segments; ++j) {
+            float v = 2.f * float(M_PI) * j / minor_segments;
+            glm::vec3 n(std::cos(v) * std::cos(u), std::sin(v),
+                        std::cos(v) * std::sin(u));
+            glm::vec3 ring(major_radius * std::cos(u), 0.f,
+                           major_radius * std::sin(u));
+
+            vertices.emplace_back(ring + minor_radius * n, n,
+                                  glm::vec2(float(i) / major_segments,
+                                            float(j) / minor_segments));
+        }
+    }
+
+    grid_indices(indices, 0, major_segments, minor_segments);
+
+    meshes.push_back({std::move(vertices), std::move(indices)});
+}
+
+void test_geometry::cube_geometry(const std::string &line, int lnum,
+                                  std::vector<mesh_data> &meshes) {
+    // Cube geometry with one subdivided patch per face
+    std::vector<vertex_data> vertices;
+    std::vector<uint32_t> indices;
+    std::istringstream in(line);
+
+    std::string s;
+    in >> s; // cube
+
+    float half_size = read_arg(in, 1.0f);
+    int subdivisions = read_arg(in, 1);
+
+    SYNTAX_ASSERT(subdivisions > 0, "cube subdivisions must be positive",
+                  lnum);
+
+    const std::pair<glm::vec3, glm::vec3> faces[] = {
+        {glm::vec3(1, 0, 0), glm::vec3(0, 0, -1)},
+        {glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1)},
+        {glm::vec3(0, 1, 0), glm::vec3(1, 0, 0)},
+        {glm::vec3(0, -1, 0), glm::vec3(1, 0, 0)},
+        {glm::vec3(0, 0, 1), glm::vec3(1, 0, 0)},
+        {glm::vec3(0, 0, -1), glm::vec3(-1, 0, 0)},
+    };
+
+    for (const auto &face : faces) {
+        patch_vertices(vertices, indices, half_size * face.first, face.first,
+                       face.second, half_size, subdivisions, subdivisions,
+                       glm::vec2(0.f), glm::vec2(1.f));
+    }
+
+    meshes.push_back({std::move(vertices), std::move(indices)});
+}
+
 test_geometry::test_geometry(const std::string &geometry, bool is_tst_source)
     : mvw_geometry() {
-    bbox_min_ = glm::vec3(0.0f);
-    bbox_max_ = glm::vec3(0.0f);
-    bbox_centroid_ = glm::vec3(0.0f);
-
     auto input = std::unique_ptr<std::istream>(
         is_tst_source
             ? static_cast<std::istream *>(new std::istringstream(geometry))
@@ -88,12 +412,48 @@ test_geometry::test_geometry(const std::string &geometry, bool is_tst_source)
     bool has_marker = line.compare("#test") == 0;
     SYNTAX_ASSERT(has_marker, "invalid marker '" + line + "'", lnum);
 
-    // Get geometry type
-    SYNTAX_GETL(input, line, lnum);
+    // Get geometry types, one per line
+    std::vector<mesh_data> meshes;
+    int instances = 1;
+    float instance_spacing = 1.5f;
+    while (true) {
+        SYNTAX_GETL(input, line, lnum);
+        if (input->fail()) break;
+
+        std::istringstream ls(line);
+        std::string type;
+        ls >> type;
+
+        if (type.empty()) {
+            continue;
+        } else if (type == "plane") {
+            plane_geometry(line, meshes);
+        } else if (type == "grid") {
+            grid_geometry(line, lnum, meshes);
+        } else if (type == "sphere") {
+            sphere_geometry(line, lnum, meshes);
+        } else if (type == "icosphere") {
+            icosphere_geometry(line, lnum, meshes);
+        } else if (type == "torus") {
+            torus_geometry(line, lnum, meshes);
+        } else if (type == "cube") {
+            cube_geometry(line, lnum, meshes);
+        } else if (type == "instances") {
+            // Applies to the whole geometry, once all lines are parsed
+            instances = read_arg(ls, 1);
+            instance_spacing = read_arg(ls, instance_spacing);
 
-    if (line.find("plane") == 0) {
-        plane_geometry(line);
-    } else {
-        SYNTAX_ASSERT(false, "invalid geometry '" + line + "'", lnum);
+            SYNTAX_ASSERT(instances > 0, "instance count must be positive",
+                          lnum);
+            continue;
+        } else {
+            SYNTAX_ASSERT(false, "invalid geometry '" + line + "'", lnum);
+        }
     }
+
+    SYNTAX_ASSERT(!meshes.empty(), "no geometry defined", lnum);
+
+    add_meshes(meshes);
+
+    if (instances > 1) set_instances(instances, instance_spacing);
 }
@@ -0,0 +1,80 @@
+#include <zstd.h>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "net/frame_codec.hpp"
+#include "trace.hpp"
+
+using namespace net;
+
+/// Fastest zstd level, frames are compressed for every request
+static const int frame_zstd_level = 1;
+
+frame_codec net::parse_frame_codec(const std::string &name) {
+    if (name.empty() || name == "none") return FC_NONE;
+    if (name == "zstd") return FC_ZSTD;
+
+    throw std::runtime_error("unknown frame codec '" + name + "'");
+}
+
+void net::shuffle_bytes(const uint8_t *src, uint8_t *dst, size_t size,
+                        size_t element_size) {
+    size_t count = size / element_size;
+
+    for (size_t plane = 0; plane < element_size; ++plane) {
+        uint8_t *plane_dst = dst + plane * count;
+        for (size_t i = 0; i < count; ++i)
+            plane_dst[i] = src[i * element_size + plane];
+    }
+}
+
+encoded_frame net::encode_frame(std::vector<uint8_t> raw, frame_codec codec,
+                                size_t element_size) {
+    if (codec == FC_NONE) {
+        size_t size = raw.size();
+        return encoded_frame{std::move(raw), size, 0};
+    }
+
+    return encode_frame(raw.data(), raw.size(), codec, element_size);
+}
+
+encoded_frame net::encode_frame(const uint8_t *raw, size_t size,
+                                frame_codec codec, size_t element_size) {
+    auto start = std::chrono::steady_clock::now();
+    encoded_frame result{{}, size, 0};
+
+    if (codec == FC_NONE) {
+        result.data.assign(raw, raw + size);
+        return result;
+    }
+
+    std::vector<uint8_t> shuffled;
+    const uint8_t *input = raw;
+
+    if (element_size > 1) {
+        TRACE_SCOPE("shuffle_bytes", "net");
+        shuffled.resize(size);
+        shuffle_bytes(raw, shuffled.data(), size, element_size);
+        input = shuffled.data();
+    }
+
+    {
+        TRACE_SCOPE("ZSTD_compress", "net");
+        result.data.resize(ZSTD_compressBound(size));
+
+        size_t sz = ZSTD_compress(result.data.data(), result.data.size(),
+                                  input, size, frame_zstd_level);
+        if (ZSTD_isError(sz)) {
+            throw std::runtime_error(std::string("zstd compression failed: ") +
+                                     ZSTD_getErrorName(sz));
+        }
+
+        result.data.resize(sz);
+    }
+
+    result.codec_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    return result;
+}
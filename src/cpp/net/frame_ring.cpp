@@ -0,0 +1,102 @@
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.hpp"
+
+#include "net/frame_ring.hpp"
+
+using namespace net;
+
+/// Identifies frame rings, change it with the layout
+static const uint32_t ring_magic = 0x4d565231;  // "MVR1"
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "slot sequence numbers are shared with other processes");
+
+static size_t round_to_page(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+frame_ring::frame_ring(const std::string &name, size_t slot_count,
+                       size_t slot_size)
+    : name_(name),
+      slot_count_(slot_count),
+      slot_size_(round_to_page(slot_size)),
+      addr_(nullptr),
+      next_(0),
+      seq_(0) {
+    size_t data_offset = round_to_page(sizeof(frame_ring_header) +
+                                       slot_count * sizeof(frame_slot_header));
+    length_ = data_offset + slot_count_ * slot_size_;
+
+    // Left over by a viewer that did not exit cleanly
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        throw std::runtime_error("could not create shared memory " + name +
+                                 ": " + std::strerror(errno));
+
+    // Pages are only allocated when frames are written to them
+    void *addr = MAP_FAILED;
+    if (ftruncate(fd, length_) == 0)
+        addr = mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                    0);
+
+    int error = errno;
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("could not map shared memory " + name +
+                                 ": " + std::strerror(error));
+    }
+
+    addr_ = reinterpret_cast<uint8_t *>(addr);
+
+    for (size_t i = 0; i < slot_count_; ++i)
+        new (&slot_header(i)) frame_slot_header{{0}, 0, 0};
+
+    // Written last, clients wait for the magic
+    header().slot_count = slot_count_;
+    header().slot_size = slot_size_;
+    header().data_offset = data_offset;
+    std::atomic_thread_fence(std::memory_order_release);
+    header().magic = ring_magic;
+
+    VLOG->info("Sharing frames in {}, {} slots of {} MB", name, slot_count_,
+               slot_size_ >> 20);
+}
+
+frame_ring::~frame_ring() {
+    munmap(addr_, length_);
+    shm_unlink(name_.c_str());
+}
+
+size_t frame_ring::acquire() {
+    size_t index = next_++ % slot_count_;
+    slot_header(index).seq.store(0, std::memory_order_relaxed);
+
+    // A release store only orders the writes before it, this keeps the frame
+    // writes that follow after the 0, as in the writer of a seqlock
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return index;
+}
+
+uint32_t frame_ring::publish(size_t index, size_t size) {
+    // 0 marks slots being written
+    uint32_t seq = ++seq_;
+    if (seq == 0) seq = ++seq_;
+
+    auto &slot(slot_header(index));
+    slot.size = size;
+    slot.seq.store(seq, std::memory_order_release);
+    return seq;
+}
@@ -0,0 +1,100 @@
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "trace.hpp"
+
+#include "net/frame_store.hpp"
+
+using namespace net;
+
+/// Identifies frame store files, change it with the file layout
+static const uint32_t store_magic = 0x4d564631;  // "MVF1"
+
+mapped_frame::mapped_frame(void *addr, size_t length)
+    : addr_(addr), length_(length) {}
+
+mapped_frame::~mapped_frame() { munmap(addr_, length_); }
+
+frame_store::frame_store(const std::string &dir, size_t budget)
+    : files_(dir, ".frame", budget), counters_{} {
+    auto stats(files_.stats());
+    VLOG->info("Storing frames in {}, {} frames ({} MB)", dir, stats.files,
+               stats.size >> 20);
+}
+
+std::shared_ptr<const mapped_frame> frame_store::find(uint64_t key) {
+    TRACE_SCOPE("frame_store::find", "net");
+
+    std::string file_path(files_.path(key));
+
+    // The index may miss frames written by other viewers, so always look for
+    // the file
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        counters_.misses++;
+        return {};
+    }
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(stored_frame_header)) {
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    std::shared_ptr<const mapped_frame> frame;
+    if (addr != MAP_FAILED) {
+        frame = std::make_shared<mapped_frame>(addr, st.st_size);
+
+        const auto &header(frame->header());
+        if (header.magic != store_magic || header.key != key ||
+            header.size + sizeof(stored_frame_header) !=
+                static_cast<uint64_t>(st.st_size))
+            frame.reset();
+    }
+
+    if (!frame) {
+        VLOG->info("Removing invalid stored frame {}", file_path);
+        files_.remove(key);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        counters_.misses++;
+        return {};
+    }
+
+    files_.touch(key, st.st_size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_.hits++;
+    return frame;
+}
+
+void frame_store::store(stored_frame_header header, const uint8_t *data) {
+    TRACE_SCOPE("frame_store::store", "net");
+
+    header.magic = store_magic;
+    if (!files_.write(header.key, &header, sizeof(header), data, header.size))
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_.stores++;
+}
+
+frame_store::store_stats frame_store::stats() const {
+    auto files(files_.stats());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    store_stats result(counters_);
+    result.evictions = files.evictions;
+    result.size = files.size;
+    result.files = files.files;
+    return result;
+}
@@ -1,13 +1,32 @@
 #include <msgpack.hpp>
 #include <zmq.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <mutex>
 #include <optional>
+#include <thread>
 
+#include <unistd.h>
+
+#include "config.hpp"
+#include "content_hash.hpp"
 #include "gl_state.hpp"
 #include "log.hpp"
+#include "program_cache.hpp"
+#include "trace.hpp"
 #include "viewer_state.hpp"
 
 #include "detail/rsize.hpp"
+#include "net/command_queue.hpp"
+#include "net/frame_codec.hpp"
+#include "net/frame_ring.hpp"
+#include "net/frame_store.hpp"
 #include "net/server.hpp"
 
 #include <shadertoy/backends/gl4/texture.hpp>
@@ -17,8 +36,15 @@ using shadertoy::operator==; // for output_name_t
 
 namespace net {
 typedef msgpack::type::tuple<bool, std::string> default_reply;
-typedef msgpack::type::tuple<bool, std::map<std::string, int>> getframe_reply;
-typedef msgpack::type::tuple<std::string, shadertoy::rsize> getframe_args;
+/// Header values are 64-bit, frame sizes may exceed 2 GiB
+typedef msgpack::type::tuple<bool, std::map<std::string, int64_t>>
+    getframe_reply;
+// target, size, output format (see frame_formats), channel for single
+// channel formats, codec, number of jittered samples to average and
+// transport ("zmq" or "shm"). Older clients only send the first two.
+typedef msgpack::type::tuple<std::string, shadertoy::rsize, std::string, int,
+                             std::string, int, std::string>
+    getframe_args;
 typedef msgpack::type::tuple<bool, std::vector<discovered_uniform>>
     getparams_reply;
 typedef std::string getparam_args;
@@ -40,37 +66,735 @@ typedef bool geometry_reply;
 typedef bool loaddefaults_reply;
 typedef msgpack::type::tuple<std::string, uint32_t, uint32_t, uint32_t> setinput_args;
 typedef bool setinput_reply;
+typedef msgpack::type::tuple<bool, profiler_stats> getstats_reply;
+// target, frame size, tile size, border, tile index, output format and
+// channel. Tiles are numbered in rows from the bottom-left corner.
+typedef msgpack::type::tuple<std::string, shadertoy::rsize, shadertoy::rsize,
+                             int, int, std::string, int>
+    gettile_args;
+typedef getframe_reply gettile_reply;
+// target, size, channel of the histogram and spectrum, histogram bins,
+// histogram range and spectrum bands
+typedef msgpack::type::tuple<std::string, shadertoy::rsize, int, int,
+                             glm::vec2, int>
+    getnoisestats_args;
+typedef msgpack::type::tuple<bool, noise_stats> getnoisestats_reply;
+// shared memory object name, slot count, slot size and offset of slot 0
+typedef msgpack::type::tuple<bool, std::string, int, int64_t, int64_t>
+    getshm_reply;
+
+typedef std::tuple_element_t<1, shadertoy::members::member_output_t>
+    output_texture_t;
+
+/// Pixel transfer parameters of a getframe output format
+struct frame_format {
+    const char *name;
+    /// Sized format reported to the client
+    GLenum internal_format;
+    GLenum type;
+    size_t channels;
+    size_t bytes_per_channel;
+};
+
+// The conversion is done by the driver during readback
+static const frame_format frame_formats[] = {
+    {"rgba32f", GL_RGBA32F, GL_FLOAT, 4, 4},
+    {"rgba16f", GL_RGBA16F, GL_HALF_FLOAT, 4, 2},
+    {"rgba8", GL_RGBA8, GL_UNSIGNED_BYTE, 4, 1},
+    {"r32f", GL_R32F, GL_FLOAT, 1, 4},
+    {"r16f", GL_R16F, GL_HALF_FLOAT, 1, 2},
+    {"r8", GL_R8, GL_UNSIGNED_BYTE, 1, 1},
+};
+
+static const frame_format &find_frame_format(const std::string &name) {
+    // Default to the full precision format
+    if (name.empty()) return frame_formats[0];
+
+    for (const auto &format : frame_formats) {
+        if (name == format.name) return format;
+    }
+
+    throw std::runtime_error("unknown frame format '" + name + "'");
+}
+
+/// Reply to getframe and gettile, compressed by the network thread
+struct frame_reply {
+    getframe_reply header;
+    std::vector<uint8_t> data;
+    frame_codec codec;
+    size_t element_size;
+    /// Stored frame sent instead of data, or null
+    std::shared_ptr<const mapped_frame> mapped;
+    /// Key of data in the frame store, 0 to not store it
+    uint64_t store_key;
+    /// true to write the frame to the frame ring
+    bool shm;
+    /// Slot of the frame ring holding the frame instead of data
+    std::optional<size_t> slot;
+};
+
+/// Reply computed on the render thread: a bare success flag, an error, a
+/// frame or statistics
+typedef std::variant<bool, default_reply, frame_reply, getnoisestats_reply>
+    deferred_reply;
+
+/// Request decoded by the network thread and applied on the render thread.
+/// Returns false if it must be applied again after the next frame.
+typedef std::function<bool(viewer_state &, gl_state &, int revision,
+                           bool &changed_state)>
+    command;
+
+struct queued_command {
+    /// Sequence number of the last state change queued before this command
+    uint64_t seq;
+    command apply;
+};
+
+/// Copies of recent getframe outputs on the GPU, keyed by the fingerprint of
+/// the state they were rendered from. Render thread only.
+class frame_lru {
+    struct entry {
+        uint64_t fingerprint;
+        std::string target;
+        int samples;
+        std::unique_ptr<shadertoy::backends::gx::texture> texture;
+    };
+
+    size_t capacity_;
+    /// Most recently used first
+    std::list<entry> entries_;
+
+   public:
+    uint64_t hits;
+    uint64_t misses;
+
+    frame_lru(size_t capacity) : capacity_(capacity), hits(0), misses(0) {}
+
+    inline size_t size() const { return entries_.size(); }
+
+    /// Cached output, or null. Moves a hit to the front.
+    output_texture_t find(uint64_t fingerprint, const std::string &target,
+                          int samples) {
+        auto it = std::find_if(entries_.begin(), entries_.end(),
+                               [&](const auto &entry) {
+                                   return entry.fingerprint == fingerprint &&
+                                          entry.samples == samples &&
+                                          entry.target == target;
+                               });
+
+        if (it == entries_.end()) return nullptr;
+
+        entries_.splice(entries_.begin(), entries_, it);
+        return entries_.front().texture.get();
+    }
+
+    /// Copy an output into the cache, replacing the least recently used
+    /// entry when it is full
+    void store(uint64_t fingerprint, const std::string &target, int samples,
+               output_texture_t texture) {
+        TRACE_SCOPE("frame_lru::store", "gl");
+
+        if (capacity_ == 0 || find(fingerprint, target, samples)) return;
+
+        std::unique_ptr<shadertoy::backends::gx::texture> copy;
+        if (entries_.size() >= capacity_) {
+            // Reuse the texture object, its storage is redefined below
+            copy = std::move(entries_.back().texture);
+            entries_.pop_back();
+        } else {
+            copy = shadertoy::backends::current()->make_texture(GL_TEXTURE_2D);
+        }
+
+        GLint width, height, internal_format;
+        texture->get_parameter(GL_TEXTURE_WIDTH, &width);
+        texture->get_parameter(GL_TEXTURE_HEIGHT, &height);
+        texture->get_parameter(GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+
+        copy->image_2d(GL_TEXTURE_2D, 0, internal_format, width, height, 0,
+                       GL_RGBA, GL_FLOAT, nullptr);
+
+        auto src =
+            static_cast<const shadertoy::backends::gl4::texture *>(texture);
+        auto dst =
+            static_cast<const shadertoy::backends::gl4::texture *>(copy.get());
+
+        // No libshadertoy wrapper yet
+        glCopyImageSubData(GLuint(*src), GL_TEXTURE_2D, 0, 0, 0, 0,
+                           GLuint(*dst), GL_TEXTURE_2D, 0, 0, 0, 0, width,
+                           height, 1);
+
+        entries_.push_front(
+            entry{fingerprint, target, samples, std::move(copy)});
+    }
+};
+
+/// Render state answered to read-only queries by the network thread
+struct server_snapshot {
+    /// Sequence number of the last state change applied to this state
+    uint64_t applied;
+
+    glm::vec3 camera_location;
+    glm::vec3 camera_target;
+    glm::vec3 camera_up;
+    glm::vec2 user_rotate;
+    float scale;
+
+    std::vector<discovered_uniform> uniforms;
+    /// Timing statistics, only refreshed every stats_refresh_ms
+    std::shared_ptr<const profiler_stats> stats;
+};
+}  // namespace net
+
+/// content_hash of the driver identification strings, as other drivers may
+/// render different frames. Render thread only.
+static uint64_t driver_hash() {
+    static const uint64_t hash = []() {
+        content_hash result;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+            result.add(std::string(
+                reinterpret_cast<const char *>(glGetString(name))));
+        return result.value();
+    }();
+
+    return hash;
+}
+
+/// Key of a getframe result in the frame store
+static uint64_t stored_frame_key(uint64_t fingerprint,
+                                 const getframe_args &args) {
+    content_hash hash;
+    hash.add(fingerprint);
+    hash.add(driver_hash());
+    hash.add(args.get<0>());
+    // "" is the default format
+    hash.add(args.get<2>().empty() ? std::string(frame_formats[0].name)
+                                   : args.get<2>());
+    hash.add(args.get<3>());
+    hash.add(std::max(1, args.get<5>()));
+    return hash.value();
+}
+
+/// true for the frame ring transport of getframe, "" and "zmq" send frames
+/// in the reply
+static bool parse_transport(const std::string &name) {
+    if (name.empty() || name == "zmq") return false;
+    if (name == "shm") return true;
+
+    throw std::runtime_error("unknown frame transport '" + name + "'");
+}
+
+/// getframe reply without its data
+static frame_reply make_frame_reply(int width, int height, GLenum format,
+                                    size_t element_size, frame_codec codec,
+                                    int samples, size_t sz) {
+    // Status message, the network thread completes it after compression
+    frame_reply reply{
+        getframe_reply(true, std::map<std::string, int64_t>{}),
+        std::vector<uint8_t>(), codec, element_size};
+    auto &header = reply.header.get<1>();
+    header.emplace("width", width);
+    header.emplace("height", height);
+    header.emplace("format", format);
+    header.emplace("codec", codec);
+    header.emplace("samples", samples);
+    header.emplace("size", sz);
+
+    if (codec == FC_NONE) {
+        header.emplace("compressed_size", sz);
+        header.emplace("codec_us", 0);
+    }
+
+    return reply;
+}
+
+/// Read back a texture into dst, converted to the given format
+static void read_frame(gl_state &gl_state, output_texture_t texture,
+                       const frame_format &frame_format, int channel,
+                       void *dst, size_t sz) {
+    TRACE_SCOPE("get_image", "gl");
+    scoped_timer timer(gl_state.timings, "cpu.readback");
+
+    auto gl_texture =
+        reinterpret_cast<const shadertoy::backends::gl4::texture *>(texture);
+    size_t bytes_per_pixel = frame_format.channels * frame_format.bytes_per_channel;
+
+    // Rows of single channel 8-bit and half-float images are not 4-byte
+    // aligned. No libshadertoy wrapper yet
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (frame_format.channels == 4) {
+        gl_texture->get_image(0, GL_RGBA, frame_format.type, sz, dst);
+    } else if (channel < 3) {
+        static const GLenum channel_formats[] = {GL_RED, GL_GREEN, GL_BLUE};
+        gl_texture->get_image(0, channel_formats[channel], frame_format.type,
+                              sz, dst);
+    } else {
+        // Core profiles cannot read back GL_ALPHA alone, so extract it from
+        // the converted RGBA image
+        std::vector<uint8_t> rgba(sz * 4);
+        gl_texture->get_image(0, GL_RGBA, frame_format.type, rgba.size(),
+                              rgba.data());
+
+        auto dst_bytes = reinterpret_cast<uint8_t *>(dst);
+        for (size_t i = 0; i < sz; i += bytes_per_pixel) {
+            std::copy_n(&rgba[i * 4 + 3 * bytes_per_pixel], bytes_per_pixel,
+                        &dst_bytes[i]);
+        }
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+/// Texture of the given "buffer.output" render target, averaged over the
+/// given number of jittered samples
+static output_texture_t find_render_output(gl_state &gl_state, int revision,
+                                           const std::string &target,
+                                           int samples = 1) {
+    std::vector<shadertoy::members::member_output_t> output;
+    std::vector<shadertoy::members::member_output_t>::const_iterator output_target;
+    shadertoy::output_name_t buffer_output_name = 0;
+
+    // Split name on dot
+    auto dot_pos = target.find('.');
+    std::string target_name, output_name;
+
+    if (dot_pos == std::string::npos) 
+    {
+        target_name = target;
+    }
+    else
+    {
+        target_name.assign(target.begin(), target.begin() + dot_pos);
+        output_name.assign(target.begin() + dot_pos + 1, target.end());
+    }
+
+    // Set the output name
+    if (!output_name.empty())
+    {
+        int id = -1;
+        std::stringstream ss(output_name);
+        ss >> id;
+
+        // Set it either as a location or a name
+        if (ss.fail())
+            buffer_output_name = output_name;
+        else
+            buffer_output_name = id;
+    }
+
+    if (samples > 1)
+    {
+        std::string error_status(gl_state.get_render_error(revision));
+        if (!error_status.empty())
+            throw std::runtime_error(
+                "render failed because of a compilation error: " +
+                error_status);
+
+        // The accumulator has a single output
+        return std::get<1>(gl_state
+                               .accumulate(samples, revision, target_name,
+                                           buffer_output_name)
+                               .front());
+    }
+
+    // Get rendered-to texture
+    output = gl_state.get_render_result(revision, target_name);
+
+    // Try to find the right output
+    output_target =
+        std::find_if(output.begin(), output.end(),
+                     [&buffer_output_name](const auto &out) {
+                         return std::get<0>(out) == buffer_output_name;
+                     });
+
+    if (output_target == output.end())
+    {
+        // If we couldn't find the input, make sure there's no error pending
+        std::string error_status(gl_state.get_render_error(revision));
+
+        std::stringstream ss;
+        if (error_status.empty()) {
+            std::visit(
+                [&ss, &target_name](const auto &name) {
+                    ss << "output target '" << name
+                       << "' was not found on buffer '" << target_name << "'";
+                },
+                buffer_output_name);
+        } else {
+            ss << "render failed because of a compilation error: " << error_status;
+        }
+
+        throw std::runtime_error(ss.str());
+    }
+
+    return std::get<1>(*output_target);
+}
 
+/// Render and read back one tile of a frame, on the render thread
+static deferred_reply render_tile(gl_state &gl_state, int revision,
+                                  const gettile_args &args) {
+    TRACE_SCOPE("render_tile", "gl");
+
+    const auto &frame_size = args.get<1>();
+    const auto &tile_size = args.get<2>();
+    int border = args.get<3>(), index = args.get<4>(), channel = args.get<6>();
+
+    const frame_format *frame_format;
+    int tiles_x, tiles_y;
+    shadertoy::rsize padded_size;
+
+    try {
+        frame_format = &find_frame_format(args.get<5>());
+
+        if (channel < 0 || channel > 3)
+            throw std::runtime_error("invalid channel " +
+                                     std::to_string(channel));
+
+        if (frame_size.width <= 0 || frame_size.height <= 0 ||
+            tile_size.width <= 0 || tile_size.height <= 0 || border < 0)
+            throw std::runtime_error("invalid tile size");
+
+        tiles_x = (frame_size.width + tile_size.width - 1) / tile_size.width;
+        tiles_y = (frame_size.height + tile_size.height - 1) / tile_size.height;
+
+        if (index < 0 || index >= tiles_x * tiles_y)
+            throw std::runtime_error("invalid tile index " +
+                                     std::to_string(index));
+
+        // Borders give postprocessing passes the neighbors of edge pixels
+        padded_size = shadertoy::rsize(tile_size.width + 2 * border,
+                                       tile_size.height + 2 * border);
+
+        // No libshadertoy wrapper yet
+        GLint max_size;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        if (padded_size.width > max_size || padded_size.height > max_size)
+            throw std::runtime_error("tile size exceeds GL_MAX_TEXTURE_SIZE");
+
+        std::string error_status(gl_state.get_render_error(revision));
+        if (!error_status.empty())
+            throw std::runtime_error(
+                "render failed because of a compilation error: " +
+                error_status);
+    } catch (std::runtime_error &ex) {
+        return default_reply(false, ex.what());
+    }
+
+    // Only allocate render targets for one tile, and keep them for the
+    // next tiles of the same frame
+    if (gl_state.render_size != padded_size) {
+        gl_state.render_size = padded_size;
+        gl_state.allocate_textures(true);
+    }
+
+    int x = (index % tiles_x) * tile_size.width;
+    int y = (index / tiles_x) * tile_size.height;
+    int width = std::min(tile_size.width, frame_size.width - x);
+    int height = std::min(tile_size.height, frame_size.height - y);
+
+    gl_state.set_tile(gl_state::tile_region{frame_size, x - border, y - border});
+    gl_state.render(false, revision, true);
+    gl_state.set_tile({});
+
+    // Read back the padded tile
+    size_t bytes_per_pixel =
+        frame_format->channels * frame_format->bytes_per_channel;
+    std::vector<uint8_t> padded(padded_size.width * padded_size.height *
+                                bytes_per_pixel);
+    read_frame(gl_state, find_render_output(gl_state, revision, args.get<0>()),
+               *frame_format, channel, padded.data(), padded.size());
+
+    // Status message
+    frame_reply reply{gettile_reply(true, std::map<std::string, int64_t>{}),
+                      std::vector<uint8_t>(), FC_NONE,
+                      frame_format->bytes_per_channel};
+    auto &header = reply.header.get<1>();
+    header.emplace("frame_width", frame_size.width);
+    header.emplace("frame_height", frame_size.height);
+    header.emplace("tiles_x", tiles_x);
+    header.emplace("tiles_y", tiles_y);
+    header.emplace("x", x);
+    header.emplace("y", y);
+    header.emplace("width", width);
+    header.emplace("height", height);
+    header.emplace("format", frame_format->internal_format);
+
+    // Send the tile without its border
+    size_t row_size = width * bytes_per_pixel;
+    reply.data.resize(row_size * height);
+    for (int row = 0; row < height; ++row) {
+        std::copy_n(&padded[((row + border) * padded_size.width + border) *
+                            bytes_per_pixel],
+                    row_size, &reply.data[row * row_size]);
+    }
+
+    return reply;
+}
+/**
+ * @brief     Read back the output requested by getframe, on the render thread
+ *
+ * @param[in] gl_state    Render state
+ * @param[in] revision    Revision to read
+ * @param[in] args        Request arguments
+ * @param[in] frames      Cache of past results, or null
+ * @param[in] fingerprint Fingerprint of the requested state
+ * @param[in] store_key   Key of the result in the frame store, 0 if it is
+ *                        disabled
+ * @param[in] ring        Frame ring of the shm transport, or null
+ */
+static deferred_reply read_getframe(gl_state &gl_state, int revision,
+                                    const getframe_args &args,
+                                    frame_lru *frames, uint64_t fingerprint,
+                                    uint64_t store_key, frame_ring *ring) {
+    TRACE_SCOPE("read_getframe", "gl");
+
+    int channel = args.get<3>(), samples = std::max(1, args.get<5>());
+    output_texture_t texture = nullptr;
+    const frame_format *frame_format;
+    frame_codec codec;
+    bool cached = false, current = false, shm;
+
+    try
+    {
+        frame_format = &find_frame_format(args.get<2>());
+        codec = parse_frame_codec(args.get<4>());
+        shm = parse_transport(args.get<6>());
+
+        if (shm && !ring)
+            throw std::runtime_error("shared memory transport disabled");
+
+        // Clients read ring slots in place
+        if (shm) codec = FC_NONE;
+
+        if (channel < 0 || channel > 3)
+            throw std::runtime_error("invalid channel " +
+                                     std::to_string(channel));
+
+        if (frames) {
+            texture = frames->find(fingerprint, args.get<0>(), samples);
+            cached = texture != nullptr;
+        }
+
+        if (!texture) {
+            // Get rendered-to texture
+            texture =
+                find_render_output(gl_state, revision, args.get<0>(), samples);
+
+            // Only keep frames of the requested state
+            current = fingerprint == gl_state.rendered_fingerprint(revision);
+
+            if (frames) {
+                frames->misses++;
+                if (current)
+                    frames->store(fingerprint, args.get<0>(), samples,
+                                  texture);
+            }
+        } else {
+            frames->hits++;
+        }
+    }
+    catch (std::runtime_error &ex)
+    {
+        return default_reply(false, ex.what());
+    }
+
+    // Get texture parameters
+    GLint width, height;
+    texture->get_parameter(GL_TEXTURE_WIDTH, &width);
+    texture->get_parameter(GL_TEXTURE_HEIGHT, &height);
+
+    size_t sz = width * height * frame_format->channels *
+                frame_format->bytes_per_channel;
+
+    auto reply(make_frame_reply(width, height, frame_format->internal_format,
+                                frame_format->bytes_per_channel, codec,
+                                samples, sz));
+    reply.header.get<1>().emplace("cached", cached);
+    reply.header.get<1>().emplace("stored", false);
+
+    // The network thread writes it to the store
+    if (current) reply.store_key = store_key;
+
+    // Frames too large for a slot are sent in the reply
+    if (shm && sz <= ring->slot_size()) {
+        size_t slot = ring->acquire();
+        read_frame(gl_state, texture, *frame_format, channel,
+                   ring->data(slot), sz);
+
+        reply.header.get<1>().emplace("slot", slot);
+        reply.header.get<1>().emplace("seq", ring->publish(slot, sz));
+        reply.slot = slot;
+        return reply;
+    }
+
+    reply.data.resize(sz);
+    read_frame(gl_state, texture, *frame_format, channel, reply.data.data(),
+               sz);
+    return reply;
+}
+
+/// Answer getframe with a frame of the store
+static deferred_reply read_stored_getframe(
+    std::shared_ptr<const mapped_frame> frame, const getframe_args &args,
+    frame_ring *ring) {
+    frame_codec codec;
+    bool shm;
+
+    try {
+        codec = parse_frame_codec(args.get<4>());
+        shm = parse_transport(args.get<6>());
+
+        if (shm && !ring)
+            throw std::runtime_error("shared memory transport disabled");
+
+        if (shm) codec = FC_NONE;
+    } catch (std::runtime_error &ex) {
+        return default_reply(false, ex.what());
+    }
+
+    const auto &stored(frame->header());
+    auto reply(make_frame_reply(stored.width, stored.height, stored.format,
+                                stored.element_size, codec, stored.samples,
+                                stored.size));
+    reply.header.get<1>().emplace("cached", false);
+    reply.header.get<1>().emplace("stored", true);
+
+    // Pages are read by the network thread when it sends the frame
+    reply.mapped = std::move(frame);
+    reply.shm = shm;
+    return reply;
+}
+
+/// Reduce the output requested by getnoisestats, on the render thread
+static deferred_reply reduce_noise_stats(gl_state &gl_state, int revision,
+                                         const getnoisestats_args &args) {
+    TRACE_SCOPE("reduce_noise_stats", "gl");
+    // Includes waiting for the GPU, the results are read back right away
+    scoped_timer timer(gl_state.timings, "cpu.noise_stats");
+
+    noise_stats_options opt{args.get<2>(), args.get<3>(), args.get<4>(),
+                            args.get<5>()};
+
+    try {
+        auto texture = find_render_output(gl_state, revision, args.get<0>());
+        return getnoisestats_reply(true,
+                                   gl_state.stats_reducer.reduce(*texture, opt));
+    } catch (std::runtime_error &ex) {
+        return default_reply(false, ex.what());
+    }
+}
+
+namespace net {
 class server_impl {
     static void free_msgpack(void *data, void *hint) {
         auto ptr = reinterpret_cast<msgpack::sbuffer *>(hint);
         delete ptr;
     }
 
+    static void free_encoded(void *data, void *hint) {
+        auto ptr = reinterpret_cast<encoded_frame *>(hint);
+        delete ptr;
+    }
+
+    static void free_mapped(void *data, void *hint) {
+        delete reinterpret_cast<std::shared_ptr<const mapped_frame> *>(hint);
+    }
+
+    const std::function<void()> wake_;
+    std::atomic<bool> running_;
+
+    /// Sequence number of the last queued state change, network thread only
+    uint64_t queued_;
+
+    std::mutex snapshot_mutex_;
+    std::condition_variable snapshot_cv_;
+    std::shared_ptr<const server_snapshot> snapshot_;
+
+    /// Past getframe results, render thread only
+    std::optional<frame_lru> frames_;
+    /// getframe requests answered without a new render, render thread only
+    uint64_t skipped_renders_;
+    /// Results of previous runs, or null
+    std::unique_ptr<frame_store> store_;
+    /// Shared memory transport of getframe, or null
+    std::unique_ptr<frame_ring> ring_;
+
+    /// Last published statistics and their time, render thread only
+    std::shared_ptr<const profiler_stats> stats_;
+    std::chrono::steady_clock::time_point stats_time_;
+
+    std::thread thread_;
+
    public:
     zmq::context_t context;
     zmq::socket_t socket;
     std::shared_ptr<spdlog::logger> logger;
-    std::optional<getframe_args> getframe_pending;
 
-    server_impl(const server_options &opt, const log_options &log_opt)
-        : context(),
+    command_queue<queued_command, command_queue_size> commands;
+    /// Command waiting for the next frame, render thread only
+    std::optional<queued_command> pending;
+    /// Sequence number of the last applied command, render thread only
+    uint64_t applied;
+
+    server_impl(const server_options &opt, const log_options &log_opt,
+                std::function<void()> wake)
+        : wake_(std::move(wake)),
+          running_(true),
+          queued_(0),
+          skipped_renders_(0),
+          context(),
           socket(context, ZMQ_REP),
-          logger(spdlog::stderr_color_st("server")),
-          getframe_pending{} {
+          logger(spdlog::stderr_color_mt("server")),
+          applied(0) {
         logger->set_level(log_opt.debug ? spdlog::level::debug :
                           (log_opt.verbose ? spdlog::level::info : spdlog::level::warn));
 
+        if (opt.frame_cache > 0) frames_.emplace(opt.frame_cache);
+
+        if (!opt.frame_store_dir.empty()) {
+            try {
+                store_ = std::make_unique<frame_store>(
+                    opt.frame_store_dir,
+                    static_cast<size_t>(opt.frame_store_mb) << 20);
+            } catch (std::runtime_error &ex) {
+                logger->warn("Frame store disabled: {}", ex.what());
+            }
+        }
+
+        if (opt.shm_frames > 0) {
+            try {
+                ring_ = std::make_unique<frame_ring>(
+                    "/mvw-frames-" + std::to_string(getpid()),
+                    opt.shm_frames,
+                    static_cast<size_t>(opt.shm_slot_mb) << 20);
+            } catch (std::runtime_error &ex) {
+                logger->warn("Shared memory transport disabled: {}",
+                             ex.what());
+            }
+        }
+
         logger->info("Binding to {}", opt.bind_addr);
         socket.bind(opt.bind_addr);
+
+        thread_ = std::thread(&server_impl::run, this);
+    }
+
+    ~server_impl() {
+        running_ = false;
+        snapshot_cv_.notify_all();
+        thread_.join();
     }
 
     template <typename T>
     void send(T &&msg, int flags = 0) {
         // use new because of the C zero-copy API of ZMQ
         msgpack::sbuffer *buffer = new msgpack::sbuffer();
-        msgpack::pack(*buffer, msg);
+        {
+            TRACE_SCOPE("msgpack::pack", "net");
+            msgpack::pack(*buffer, msg);
+        }
 
+        TRACE_SCOPE("zmq::send", "net");
         zmq::message_t zmsg(buffer->data(), buffer->size(), free_msgpack,
                             buffer);
         socket.send(zmsg, flags);
@@ -79,7 +803,12 @@ class server_impl {
     template <typename T>
     T recv() {
         zmq::message_t msg;
-        socket.recv(&msg);
+        {
+            TRACE_SCOPE("zmq::recv", "net");
+            socket.recv(&msg);
+        }
+
+        TRACE_SCOPE("msgpack::unpack", "net");
         msgpack::object_handle result;
         msgpack::unpack(result, reinterpret_cast<const char *>(msg.data()),
                         msg.size());
@@ -87,6 +816,7 @@ class server_impl {
     }
 
     std::string recv_cmd() {
+        TRACE_SCOPE("zmq::recv", "net");
         zmq::message_t cmd_msg;
         socket.recv(&cmd_msg);
 
@@ -94,443 +824,836 @@ class server_impl {
             reinterpret_cast<const char *>(cmd_msg.data()),
             reinterpret_cast<const char *>(cmd_msg.data()) + cmd_msg.size());
     }
-};
-}  // namespace net
-
-void server::handle_getframe(gl_state &gl_state, int revision, const std::string &target) const {
-    std::vector<shadertoy::members::member_output_t> output;
-    std::vector<shadertoy::members::member_output_t>::const_iterator output_target;
-    shadertoy::output_name_t buffer_output_name = 0;
-
-    try
-    {
-        // Split name on dot
-        auto dot_pos = target.find('.');
-        std::string target_name, output_name;
 
-        if (dot_pos == std::string::npos) 
-        {
-            target_name = target;
+    /// Drop the remaining parts of a request that could not be decoded
+    void discard_more() {
+        while (socket.getsockopt<int>(ZMQ_RCVMORE)) {
+            zmq::message_t msg;
+            socket.recv(&msg);
         }
-        else
-        {
-            target_name.assign(target.begin(), target.begin() + dot_pos);
-            output_name.assign(target.begin() + dot_pos + 1, target.end());
+    }
+
+    /**
+     * @brief     Queue a command for the render thread
+     *
+     * @param[in] apply         Command to apply
+     * @param[in] changes_state true if the command changes the state served
+     *                          to read-only queries
+     * @param[in] wake          true to wake up the render thread
+     */
+    void push(command apply, bool changes_state, bool wake = true) {
+        TRACE_SCOPE("command_queue::push", "net");
+
+        if (changes_state) queued_++;
+        queued_command item{queued_, std::move(apply)};
+
+        while (!commands.try_push(std::move(item))) {
+            // The render thread is behind, give it time to drain the queue
+            if (!running_) return;
+            wake_();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
 
-        // Get rendered-to texture
-        output = gl_state.get_render_result(revision, target_name);
+        if (wake) wake_();
+    }
 
-        // Set the output name
-        if (!output_name.empty())
-        {
-            int id = -1;
-            std::stringstream ss(output_name);
-            ss >> id;
+    /// Latest snapshot, including the state changes queued so far
+    std::shared_ptr<const server_snapshot> current_snapshot() {
+        TRACE_SCOPE("server_impl::current_snapshot", "net");
+        std::unique_lock<std::mutex> lock(snapshot_mutex_);
+
+        auto is_current = [this]() {
+            return snapshot_ && snapshot_->applied >= queued_;
+        };
 
-            // Set it either as a location or a name
-            if (ss.fail())
-                buffer_output_name = output_name;
-            else
-                buffer_output_name = id;
+        if (!is_current()) wake_();
+        while (running_ && !is_current()) {
+            snapshot_cv_.wait_for(lock,
+                                  std::chrono::milliseconds(server_poll_ms));
         }
 
-        // Try to find the right output
-        output_target =
-            std::find_if(output.begin(), output.end(),
-                         [&buffer_output_name](const auto &out) {
-                             return std::get<0>(out) == buffer_output_name;
-                         });
+        if (!snapshot_) throw std::runtime_error("server shutting down");
+        return snapshot_;
+    }
 
-        if (output_target == output.end())
-        {
-            // If we couldn't find the input, make sure there's no error pending
-            std::string error_status(gl_state.get_render_error(revision));
+    /// Publish the render state for read-only queries, on the render thread
+    void publish(const viewer_state &state, const gl_state &gl_state,
+                 int revision) {
+        TRACE_SCOPE("server_impl::publish", "net");
+
+        // Percentiles over the whole timing history are too expensive to be
+        // computed for every frame
+        auto now = std::chrono::steady_clock::now();
+        if (!stats_ ||
+            now - stats_time_ > std::chrono::milliseconds(stats_refresh_ms)) {
+            auto stats = std::make_shared<profiler_stats>(gl_state.timings.stats());
+
+            const auto &pool_stats = gl_state.pool_stats;
+            stats->emplace(
+                "texture_pool",
+                std::map<std::string, double>{
+                    {"hits", static_cast<double>(pool_stats.hits)},
+                    {"misses", static_cast<double>(pool_stats.misses)},
+                    {"evictions", static_cast<double>(pool_stats.evictions)},
+                    {"resizes", static_cast<double>(pool_stats.resizes)},
+                    {"budget_mb", static_cast<double>(gl_state.texture_pool_budget >> 20)},
+                });
+
+            stats->emplace("render_targets", gl_state.memory_stats());
+
+            std::map<std::string, double> getframe_stats{
+                {"skipped_renders", static_cast<double>(skipped_renders_)}};
+            if (frames_) {
+                getframe_stats.emplace("cache_hits",
+                                       static_cast<double>(frames_->hits));
+                getframe_stats.emplace("cache_misses",
+                                       static_cast<double>(frames_->misses));
+                getframe_stats.emplace("cache_entries",
+                                       static_cast<double>(frames_->size()));
+            }
+            stats->emplace("getframe", std::move(getframe_stats));
+
+            if (store_) {
+                auto store_stats = store_->stats();
+                uint64_t lookups = store_stats.hits + store_stats.misses;
+                stats->emplace(
+                    "frame_store",
+                    std::map<std::string, double>{
+                        {"hits", static_cast<double>(store_stats.hits)},
+                        {"misses", static_cast<double>(store_stats.misses)},
+                        {"hit_rate",
+                         lookups ? static_cast<double>(store_stats.hits) /
+                                       lookups
+                                 : 0.},
+                        {"stores", static_cast<double>(store_stats.stores)},
+                        {"evictions",
+                         static_cast<double>(store_stats.evictions)},
+                        {"files", static_cast<double>(store_stats.files)},
+                        {"size_mb",
+                         static_cast<double>(store_stats.size) / (1 << 20)},
+                        {"budget_mb",
+                         static_cast<double>(store_->budget() >> 20)},
+                    });
+            }
 
-            std::stringstream ss;
-            if (error_status.empty()) {
-                std::visit(
-                    [&ss, &target_name](const auto &name) {
-                        ss << "output target '" << name
-                           << "' was not found on buffer '" << target_name << "'";
-                    },
-                    buffer_output_name);
-            } else {
-                ss << "render failed because of a compilation error: " << error_status;
+            if (program_cache::enabled()) {
+                auto cache_stats = program_cache::stats();
+                stats->emplace(
+                    "program_cache",
+                    std::map<std::string, double>{
+                        {"hits", static_cast<double>(cache_stats.hits)},
+                        {"misses", static_cast<double>(cache_stats.misses)},
+                        {"rejected", static_cast<double>(cache_stats.rejected)},
+                        {"evictions",
+                         static_cast<double>(cache_stats.evictions)},
+                        {"size_mb",
+                         static_cast<double>(cache_stats.size) / (1 << 20)},
+                    });
             }
 
-            throw std::runtime_error(ss.str());
+            stats_ = std::move(stats);
+            stats_time_ = now;
         }
-    }
-    catch (std::runtime_error &ex)
-    {
-        net::default_reply result(false, ex.what());
-        impl_->send(result);
-        return;
+
+        auto snapshot = std::make_shared<server_snapshot>();
+        snapshot->applied = applied;
+        snapshot->camera_location = state.camera_location;
+        snapshot->camera_target = state.camera_target;
+        snapshot->camera_up = state.camera_up;
+        snapshot->user_rotate = state.user_rotate;
+        snapshot->scale = state.scale;
+        snapshot->uniforms = gl_state.get_discovered_uniforms(revision);
+        snapshot->stats = stats_;
+
+        {
+            std::lock_guard<std::mutex> lock(snapshot_mutex_);
+            snapshot_ = std::move(snapshot);
+        }
+
+        snapshot_cv_.notify_all();
     }
 
-    auto texture(std::get<1>(*output_target));
+    void send_result(bool result) { send(result); }
 
-    // Get texture parameters and format
-    GLint width, height, internal_format;
-    texture->get_parameter(GL_TEXTURE_WIDTH, &width);
-    texture->get_parameter(GL_TEXTURE_HEIGHT, &height);
-    texture->get_parameter(GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+    void send_result(default_reply &&result) { send(result); }
 
-    // Status message
-    net::getframe_reply result(true, std::map<std::string, int>{});
+    void send_result(getnoisestats_reply &&result) { send(result); }
 
-    // Set format message data
-    result.get<1>().emplace("width", width);
-    result.get<1>().emplace("height", height);
-    result.get<1>().emplace("format", internal_format);
+    void send_result(frame_reply &&result) {
+        auto &header = result.header.get<1>();
 
-    impl_->send(result, ZMQ_SNDMORE);
+        // Store the raw frame before it is compressed
+        if (result.store_key && store_) {
+            store_->store(
+                stored_frame_header{
+                    0, static_cast<uint32_t>(header.at("format")),
+                    result.store_key, static_cast<int32_t>(header.at("width")),
+                    static_cast<int32_t>(header.at("height")),
+                    static_cast<uint32_t>(result.element_size),
+                    static_cast<uint32_t>(header.at("samples")),
+                    static_cast<uint64_t>(header.at("size"))},
+                result.slot ? ring_->data(*result.slot) : result.data.data());
+        }
 
-    // Send image data
-    size_t bytes_per_pixel;
-    if (internal_format == GL_RGBA32F)
-        bytes_per_pixel = 4 * sizeof(float);
-    else
-        throw std::runtime_error("Unsupported internal format");
-
-    size_t sz = width * height * bytes_per_pixel;
-    zmq::message_t data_msg(sz);
-    // Read the image into the message buffer directly
-    reinterpret_cast<const shadertoy::backends::gl4::texture *>(texture)
-        ->get_image(0, GL_RGBA, GL_FLOAT, sz, data_msg.data());
-    impl_->socket.send(data_msg);
-}
+        // Stored frames requested through the frame ring are copied to it,
+        // unless they are too large for a slot
+        if (result.mapped && result.shm &&
+            result.mapped->header().size <= ring_->slot_size()) {
+            TRACE_SCOPE("frame_ring::copy", "net");
 
-void server::handle_getparams(gl_state &gl_state, int revision) const {
-    // Get the list of parameters
-    auto &discovered_uniforms = gl_state.get_discovered_uniforms(revision);
+            size_t slot = ring_->acquire();
+            std::memcpy(ring_->data(slot), result.mapped->data(),
+                        result.mapped->header().size);
 
-    // Return result
-    net::getparams_reply result(true, discovered_uniforms);
-    impl_->send(result);
-}
+            header["slot"] = slot;
+            header["seq"] = ring_->publish(slot, result.mapped->header().size);
+            result.mapped.reset();
+        }
+
+        // Stored frames are sent from their mapping
+        if (result.mapped && result.codec == FC_NONE) {
+            send(result.header, ZMQ_SNDMORE);
+
+            TRACE_SCOPE("zmq::send", "net");
+            auto ptr = new std::shared_ptr<const mapped_frame>(
+                std::move(result.mapped));
+            zmq::message_t data_msg(const_cast<uint8_t *>((*ptr)->data()),
+                                    (*ptr)->header().size, free_mapped, ptr);
+            socket.send(data_msg);
+            return;
+        }
 
-void server::handle_getparam(gl_state &gl_state, int revision) const {
-    // Get the list of parameters
-    auto &discovered_uniforms = gl_state.get_discovered_uniforms(revision);
+        auto frame = result.mapped
+                         ? encode_frame(result.mapped->data(),
+                                        result.mapped->header().size,
+                                        result.codec, result.element_size)
+                         : encode_frame(std::move(result.data), result.codec,
+                                        result.element_size);
+
+        if (result.codec != FC_NONE) {
+            header["compressed_size"] = frame.data.size();
+            header["codec_us"] = frame.codec_us;
+
+            // The profiler belongs to the render thread
+            float codec_ms = frame.codec_us / 1.0e3f;
+            push(
+                [codec_ms](viewer_state &, gl_state &gl_state, int, bool &) {
+                    gl_state.timings.record("cpu.codec", codec_ms);
+                    return true;
+                },
+                false, false);
+        }
 
-    // Get the arguments
-    auto param_name = impl_->recv<getparam_args>();
+        send(result.header, ZMQ_SNDMORE);
 
-    // Find the right parameter
-    auto it = std::find_if(
-        discovered_uniforms.begin(), discovered_uniforms.end(),
-        [&param_name](const auto &item) { return item.s_name == param_name; });
+        TRACE_SCOPE("zmq::send", "net");
+        auto ptr = new encoded_frame(std::move(frame));
+        zmq::message_t data_msg(ptr->data.data(), ptr->data.size(),
+                                free_encoded, ptr);
+        socket.send(data_msg);
+    }
 
-    if (it == discovered_uniforms.end()) {
-        net::default_reply result(false, std::string("param ") + param_name +
-                                             std::string(" not found"));
-        impl_->send(result);
-    } else {
-        net::getparam_reply result(true, *it);
-        impl_->send(result);
+    /// Wait for the render thread to answer a command, and send its reply
+    void send_deferred(std::future<deferred_reply> &result) {
+        TRACE_SCOPE("server_impl::send_deferred", "net");
+
+        while (result.wait_for(std::chrono::milliseconds(server_poll_ms)) !=
+               std::future_status::ready) {
+            if (!running_) throw std::runtime_error("server shutting down");
+        }
+
+        std::visit([this](auto &&reply) { send_result(std::move(reply)); },
+                   result.get());
     }
-}
 
-void server::handle_setparam(gl_state &gl_state, int revision,
-                             bool &changed_state) const {
-    // Get the list of parameters
-    auto &discovered_uniforms = gl_state.get_discovered_uniforms(revision);
+    void handle_getframe() {
+        TRACE_SCOPE("server::handle_getframe", "net");
+
+        auto args = recv<getframe_args>();
+        auto reply = std::make_shared<std::promise<deferred_reply>>();
+        auto result = reply->get_future();
+
+        push(
+            [this, args, reply, check_store = true](
+                viewer_state &state, gl_state &gl_state, int revision,
+                bool &changed_state) mutable {
+                frame_lru *frames = frames_ ? &*frames_ : nullptr;
+                uint64_t fingerprint =
+                    gl_state.fingerprint(state, revision, args.get<1>());
+                uint64_t store_key =
+                    store_ ? stored_frame_key(fingerprint, args) : 0;
+
+                // A past result of the same state needs no render, nor a
+                // resize of the render targets
+                if (frames && frames->find(fingerprint, args.get<0>(),
+                                           std::max(1, args.get<5>()))) {
+                    reply->set_value(read_getframe(gl_state, revision, args,
+                                                   frames, fingerprint,
+                                                   store_key, ring_.get()));
+                    return true;
+                }
+
+                // Rendering does not change the fingerprint, so the store is
+                // only searched when the command is first applied
+                if (store_ && check_store) {
+                    check_store = false;
+
+                    if (auto frame = store_->find(store_key)) {
+                        reply->set_value(
+                            read_stored_getframe(std::move(frame), args,
+                                                 ring_.get()));
+                        return true;
+                    }
+                }
+
+                if (args.get<1>() != gl_state.render_size) {
+                    // We are not rendering at the right size
+                    gl_state.render_size = args.get<1>();
+                    gl_state.allocate_textures(true);
 
-    // Get the arguments
-    auto args = impl_->recv<setparam_args>();
-    const auto &param_name = args.get<0>();
+                    // The current frame is thus invalid w.r.t the requested
+                    // size
+                    changed_state = true;
+                }
 
-    // Find the right parameter
-    auto it = std::find_if(
-        discovered_uniforms.begin(), discovered_uniforms.end(),
-        [&param_name](const auto &item) { return item.s_name == param_name; });
+                // The changes may have restored the state of the current
+                // frame, such as a sweep sending the same parameters again
+                if (changed_state &&
+                    fingerprint == gl_state.rendered_fingerprint(revision)) {
+                    changed_state = false;
+                    skipped_renders_++;
+                }
 
-    if (it == discovered_uniforms.end()) {
-        net::default_reply result(false, std::string("param ") + param_name +
-                                             std::string(" not found"));
-        impl_->send(result);
-    } else {
-        // Try to set it with the decoded value
-        bool set = try_set_variant(it->value, args.get<1>());
+                // A tile or a jittered sample replaced the current frame in
+                // the render targets, averages render their own samples
+                if (args.get<5>() <= 1 && gl_state.stale_frame(revision))
+                    changed_state = true;
+
+                // We changed some render state, so the user probably wants
+                // the updated result instead of the current frame
+                if (changed_state) return false;
 
-        if (set) {
-            // Send success response
-            net::setparam_reply result(true);
-            impl_->send(result);
+                reply->set_value(read_getframe(gl_state, revision, args,
+                                               frames, fingerprint,
+                                               store_key, ring_.get()));
+                return true;
+            },
+            false);
+
+        send_deferred(result);
+    }
 
-            changed_state = true;
+    void handle_getparams() {
+        TRACE_SCOPE("server::handle_getparams", "net");
+        // Return result
+        net::getparams_reply result(true, current_snapshot()->uniforms);
+        send(result);
+    }
+
+    void handle_getparam() {
+        TRACE_SCOPE("server::handle_getparam", "net");
+        // Get the arguments
+        auto param_name = recv<getparam_args>();
+        auto snapshot = current_snapshot();
+
+        // Find the right parameter
+        auto it = std::find_if(
+            snapshot->uniforms.begin(), snapshot->uniforms.end(),
+            [&param_name](const auto &item) { return item.s_name == param_name; });
+
+        if (it == snapshot->uniforms.end()) {
+            net::default_reply result(false, std::string("param ") + param_name +
+                                                 std::string(" not found"));
+            send(result);
         } else {
+            net::getparam_reply result(true, *it);
+            send(result);
+        }
+    }
+
+    void handle_setparam() {
+        TRACE_SCOPE("server::handle_setparam", "net");
+        // Get the arguments
+        auto args = recv<setparam_args>();
+        const auto &param_name = args.get<0>();
+        auto snapshot = current_snapshot();
+
+        // Find the right parameter
+        auto it = std::find_if(
+            snapshot->uniforms.begin(), snapshot->uniforms.end(),
+            [&param_name](const auto &item) { return item.s_name == param_name; });
+
+        if (it == snapshot->uniforms.end()) {
+            net::default_reply result(false, std::string("param ") + param_name +
+                                                 std::string(" not found"));
+            send(result);
+            return;
+        }
+
+        // Check the decoded value converts to the parameter type
+        uniform_variant value(it->value);
+        if (!try_set_variant(value, args.get<1>())) {
             // Send failure response
             net::default_reply result(
                 false, std::string("invalid type for param " + param_name));
-            impl_->send(result);
+            send(result);
+            return;
         }
+
+        push(
+            [param_name, value](viewer_state &, gl_state &gl_state,
+                                int revision, bool &changed_state) {
+                auto &discovered_uniforms =
+                    gl_state.get_discovered_uniforms(revision);
+                auto it = std::find_if(discovered_uniforms.begin(),
+                                       discovered_uniforms.end(),
+                                       [&param_name](const auto &item) {
+                                           return item.s_name == param_name;
+                                       });
+
+                // The program may have been reloaded since the request was
+                // checked. Sending the current value changes nothing.
+                if (it != discovered_uniforms.end()) {
+                    uniform_variant previous(it->value);
+                    if (try_set_variant(it->value, value) &&
+                        !(it->value == previous))
+                        changed_state = true;
+                }
+
+                return true;
+            },
+            true);
+
+        // Send success response
+        net::setparam_reply result(true);
+        send(result);
     }
-}
 
-void server::handle_getcamera(viewer_state &state) const {
-    // Nothing to do, just send the camera parameters
-    getcamera_reply result(true, state.camera_location, state.camera_target,
-                           state.camera_up);
-    impl_->send(result);
-}
+    void handle_getcamera() {
+        TRACE_SCOPE("server::handle_getcamera", "net");
+        // Nothing to do, just send the camera parameters
+        auto snapshot = current_snapshot();
+        getcamera_reply result(true, snapshot->camera_location,
+                               snapshot->camera_target, snapshot->camera_up);
+        send(result);
+    }
 
-void server::handle_setcamera(viewer_state &state, bool &changed_state) const {
-    setcamera_args args;
+    void handle_setcamera() {
+        TRACE_SCOPE("server::handle_setcamera", "net");
 
-    try {
-        args = impl_->recv<setcamera_args>();
-    } catch (msgpack::type_error &ex) {
-        net::default_reply result(false, "invalid camera parameters");
-        impl_->send(result);
-        return;
+        setcamera_args args;
+
+        try {
+            args = recv<setcamera_args>();
+        } catch (msgpack::type_error &ex) {
+            net::default_reply result(false, "invalid camera parameters");
+            send(result);
+            return;
+        }
+
+        push(
+            [args](viewer_state &state, gl_state &, int,
+                   bool &changed_state) {
+                if (state.camera_location != args.get<0>() ||
+                    state.camera_target != args.get<1>() ||
+                    state.camera_up != args.get<2>())
+                    changed_state = true;
+
+                state.camera_location = args.get<0>();
+                state.camera_target = args.get<1>();
+                state.camera_up = args.get<2>();
+                return true;
+            },
+            true);
+
+        setcamera_reply result(true);
+        send(result);
     }
 
-    state.camera_location = args.get<0>();
-    state.camera_target = args.get<1>();
-    state.camera_up = args.get<2>();
+    void handle_getrotation() {
+        TRACE_SCOPE("server::handle_getrotation", "net");
+        // Nothing to do, just send the rotation parameters
+        getrotation_reply result(true, current_snapshot()->user_rotate);
+        send(result);
+    }
 
-    changed_state = true;
+    void handle_setrotation() {
+        TRACE_SCOPE("server::handle_setrotation", "net");
 
-    setcamera_reply result(true);
-    impl_->send(result);
-}
+        setrotation_args args;
 
-void server::handle_getrotation(viewer_state &state) const {
-    // Nothing to do, just send the rotation parameters
-    getrotation_reply result(true, state.user_rotate);
-    impl_->send(result);
-}
+        try {
+            args = recv<setrotation_args>();
+        } catch (msgpack::type_error &ex) {
+            net::default_reply result(false, "invalid rotation parameters");
+            send(result);
+            return;
+        }
 
-void server::handle_setrotation(viewer_state &state,
-                                bool &changed_state) const {
-    setrotation_args args;
+        push(
+            [args](viewer_state &state, gl_state &, int,
+                   bool &changed_state) {
+                if (state.user_rotate != args || state.rotate_camera)
+                    changed_state = true;
 
-    try {
-        args = impl_->recv<setrotation_args>();
-    } catch (msgpack::type_error &ex) {
-        net::default_reply result(false, "invalid rotation parameters");
-        impl_->send(result);
-        return;
+                state.user_rotate = args;
+                // Disable camera rotation if we set a manual orientation, as
+                // if the user clicked in the UI
+                state.rotate_camera = false;
+                return true;
+            },
+            true);
+
+        setrotation_reply result(true);
+        send(result);
     }
 
-    state.user_rotate = args;
-    // Disable camera rotation if we set a manual orientation, as if
-    // the user clicked in the UI
-    state.rotate_camera = false;
+    void handle_getscale() {
+        TRACE_SCOPE("server::handle_getscale", "net");
+        // Nothing to do, just send the scale parameters
+        getscale_reply result(true, current_snapshot()->scale);
+        send(result);
+    }
 
-    changed_state = true;
+    void handle_setscale() {
+        TRACE_SCOPE("server::handle_setscale", "net");
 
-    setrotation_reply result(true);
-    impl_->send(result);
-}
+        setscale_args args;
 
-void server::handle_getscale(viewer_state &state) const {
-    // Nothing to do, just send the scale parameters
-    getscale_reply result(true, state.scale);
-    impl_->send(result);
-}
+        try {
+            args = recv<setscale_args>();
+        } catch (msgpack::type_error &ex) {
+            net::default_reply result(false, "invalid scale parameter");
+            send(result);
+            return;
+        }
 
-void server::handle_setscale(viewer_state &state, bool &changed_state) const {
-    setscale_args args;
+        push(
+            [args](viewer_state &state, gl_state &, int,
+                   bool &changed_state) {
+                if (state.scale != args) changed_state = true;
 
-    try {
-        args = impl_->recv<setscale_args>();
-    } catch (msgpack::type_error &ex) {
-        net::default_reply result(false, "invalid scale parameter");
-        impl_->send(result);
-        return;
+                state.scale = args;
+                return true;
+            },
+            true);
+
+        setscale_reply result(true);
+        send(result);
     }
 
-    state.scale = args;
+    void handle_geometry() {
+        TRACE_SCOPE("server::handle_geometry", "net");
 
-    changed_state = true;
+        geometry_args args;
 
-    setscale_reply result(true);
-    impl_->send(result);
-}
+        try {
+            args = recv<geometry_args>();
+        } catch (msgpack::type_error &ex) {
+            net::default_reply result(false, std::string("invalid argument for geometry"));
+            send(result);
+            return;
+        }
 
-void server::handle_geometry(gl_state &gl_state, viewer_state &state, bool &changed_state) const
-{
-    geometry_args args;
+        geometry_options opts;
+        if (args.get<0>())
+            opts.nff_source = args.get<1>();
+        else
+            opts.path = args.get<1>();
+
+        auto reply = std::make_shared<std::promise<deferred_reply>>();
+        auto result = reply->get_future();
+
+        // Loading may fail, so the reply comes from the render thread
+        push(
+            [opts, reply](viewer_state &state, gl_state &gl_state, int,
+                          bool &changed_state) {
+                try {
+                    gl_state.load_geometry(opts);
+                    state.center = gl_state.center;
+                    state.scale = gl_state.scale;
+                } catch (std::runtime_error &ex) {
+                    reply->set_value(default_reply(
+                        false, std::string("could not load geometry: ") +
+                                   std::string(ex.what())));
+                    return true;
+                }
 
-    try {
-        args = impl_->recv<geometry_args>();
-    } catch (msgpack::type_error &ex) {
-        net::default_reply result(false, std::string("invalid argument for geometry"));
-        impl_->send(result);
-        return;
+                changed_state = true;
+
+                reply->set_value(net::geometry_reply(true));
+                return true;
+            },
+            true);
+
+        send_deferred(result);
     }
 
-    geometry_options opts;
-    if (args.get<0>())
-        opts.nff_source = args.get<1>();
-    else
-        opts.path = args.get<1>();
+    void handle_loaddefaults() {
+        TRACE_SCOPE("server::handle_loaddefaults", "net");
 
-    try {
-        gl_state.load_geometry(opts);
-        state.center = gl_state.center;
-        state.scale = gl_state.scale;
-    } catch (std::runtime_error &ex) {
-        net::default_reply result(false, std::string("could not load geometry: ") + std::string(ex.what()));
-        impl_->send(result);
-        return;
+        push(
+            [](viewer_state &, gl_state &gl_state, int, bool &changed_state) {
+                gl_state.load_defaults();
+                changed_state = true;
+                return true;
+            },
+            true);
+
+        net::loaddefaults_reply result(true);
+        send(result);
     }
 
-    changed_state = true;
+    void handle_setinput() {
+        TRACE_SCOPE("server::handle_setinput", "net");
+        // Get the arguments
+        auto args = recv<setinput_args>();
 
-    net::geometry_reply result(true);
-    impl_->send(result);
-}
+        // Create dims array
+        std::array<uint32_t, 3> dims{
+            args.get<1>(),
+            args.get<2>(),
+            args.get<3>()
+        };
 
-void server::handle_loaddefaults(gl_state &gl_state, bool &changed_state) const
-{
-   gl_state.load_defaults();
-   changed_state = true;
+        // Allocate buffer
+        std::vector<float> buf(dims[0] * dims[1] * dims[2]);
 
-   net::loaddefaults_reply result(true);
-   impl_->send(result);
-}
+        // Read image
+        size_t read_size;
+        {
+            TRACE_SCOPE("zmq::recv", "net");
+            read_size = socket.recv(buf.data(), sizeof(float) * buf.size());
+        }
 
-void server::handle_setinput(gl_state &gl_state, bool &changed_state) const {
-   // Get the arguments
-   auto args = impl_->recv<setinput_args>();
-
-   // Create dims array
-   std::array<uint32_t, 3> dims{
-      args.get<1>(),
-      args.get<2>(),
-      args.get<3>()
-   };
-
-   // Allocate buffer
-   std::vector<float> buf(dims[0] * dims[1] * dims[2]);
-
-   // Read image
-   size_t read_size = impl_->socket.recv(buf.data(), sizeof(float) * buf.size());
-
-   if (read_size != buf.size() * sizeof(float)) {
-       std::stringstream ss;
-       ss << "invalid input buffer size: expected "
-          << dims[0]
-          << "x"
-          << dims[1]
-          << "x"
-          << dims[2]
-          << "("
-          << dims[0] * dims[1] * dims[2]
-          << " elements)"
-          << " but only received "
-          << read_size / sizeof(float)
-          << " elements";
-
-       net::default_reply result(false, ss.str());
-       impl_->send(result);
-       return;
-   }
-
-   // Set input
-   gl_state.set_input(args.get<0>(), buf, dims);
-
-   changed_state = true;
-
-   // Send reply
-   net::setinput_reply result(true);
-   impl_->send(result);
-}
+        if (read_size != buf.size() * sizeof(float)) {
+            std::stringstream ss;
+            ss << "invalid input buffer size: expected "
+               << dims[0]
+               << "x"
+               << dims[1]
+               << "x"
+               << dims[2]
+               << "("
+               << dims[0] * dims[1] * dims[2]
+               << " elements)"
+               << " but only received "
+               << read_size / sizeof(float)
+               << " elements";
+
+            net::default_reply result(false, ss.str());
+            send(result);
+            return;
+        }
 
-server::server(const server_options &opt, const log_options &log_opt)
-    : opt_(opt), impl_{std::make_unique<server_impl>(opt, log_opt)} {}
+        // Set input, only the texture upload is left to the render thread
+        push(
+            [name = args.get<0>(), buf = std::move(buf), dims](
+                viewer_state &, gl_state &gl_state, int,
+                bool &changed_state) mutable {
+                gl_state.set_input(name, std::move(buf), dims);
+                changed_state = true;
+                return true;
+            },
+            true);
+
+        // Send reply
+        net::setinput_reply result(true);
+        send(result);
+    }
 
-server::~server() {}
+    void handle_getstats() {
+        TRACE_SCOPE("server::handle_getstats", "net");
+        // Percentiles over the timing history
+        net::getstats_reply result(true, *current_snapshot()->stats);
+        send(result);
+    }
 
-bool server::poll(viewer_state &state, gl_state &gl_state, int revision) const {
-    // true if we should stop reading messages and render the next frame
-    bool next_frame = false;
-    // true if we changed any render state, meaning the current frame does
-    // not match the new render state
-    bool changed_state = false;
+    void handle_getshm() {
+        TRACE_SCOPE("server::handle_getshm", "net");
 
-    // Check for pending getframe that we have to reply to
-    if (impl_->getframe_pending) {
-        // Note that it is unlikely the rendering size changed between two
-        // requests So we don't check again that gl_state.render_size matches
-        // getframe_pending args
-        handle_getframe(gl_state, revision, impl_->getframe_pending->get<0>());
+        if (!ring_) {
+            net::default_reply result(false,
+                                      "shared memory transport disabled");
+            send(result);
+            return;
+        }
 
-        // Acknowledge getframe
-        impl_->getframe_pending.reset();
+        getshm_reply result(true, ring_->name(), ring_->slot_count(),
+                            ring_->slot_size(), ring_->data_offset());
+        send(result);
     }
 
-    // Poll for incoming messages
-    while (!next_frame) {
-        zmq::pollitem_t items[] = {
-            {static_cast<void *>(impl_->socket), 0, ZMQ_POLLIN, 0}};
+    void handle_gettile() {
+        TRACE_SCOPE("server::handle_gettile", "net");
+
+        auto args = recv<gettile_args>();
+        auto reply = std::make_shared<std::promise<deferred_reply>>();
+        auto result = reply->get_future();
 
-        // Check for an incoming request
-        zmq::poll(&items[0], sizeof(items) / sizeof(items[0]), 0);
+        push(
+            [args, reply](viewer_state &, gl_state &gl_state, int revision,
+                          bool &changed_state) {
+                // Uniforms and the camera reach GL with the next frame, so
+                // render it before the tile
+                if (changed_state) return false;
 
-        // Incoming request?
-        if (items[0].revents & ZMQ_POLLIN) {
-            auto cmdname = impl_->recv_cmd();
+                reply->set_value(render_tile(gl_state, revision, args));
+                return true;
+            },
+            false);
+
+        send_deferred(result);
+    }
 
-            if (cmdname.compare(CMD_NAME_GETFRAME) == 0) {
-                auto args = impl_->recv<getframe_args>();
+    void handle_getnoisestats() {
+        TRACE_SCOPE("server::handle_getnoisestats", "net");
 
+        auto args = recv<getnoisestats_args>();
+        auto reply = std::make_shared<std::promise<deferred_reply>>();
+        auto result = reply->get_future();
+
+        push(
+            [args, reply](viewer_state &, gl_state &gl_state, int revision,
+                          bool &changed_state) {
                 if (args.get<1>() != gl_state.render_size) {
-                    // We are not rendering at the right size
+                    // Reduce a frame rendered at the requested size
                     gl_state.render_size = args.get<1>();
-                    gl_state.allocate_textures();
-
-                    // The current frame is thus invalid w.r.t the requested size
+                    gl_state.allocate_textures(true);
                     changed_state = true;
                 }
 
-                if (changed_state) {
-                    // We changed some render state, so the user probably wants
-                    // the updated result instead of the current frame
-                    impl_->getframe_pending = args;
-                    next_frame = true;
-                } else {
-                    handle_getframe(gl_state, revision, args.get<0>());
-                }
-            } else if (cmdname.compare(CMD_NAME_GETPARAMS) == 0) {
-                handle_getparams(gl_state, revision);
-            } else if (cmdname.compare(CMD_NAME_GETPARAM) == 0) {
-                handle_getparam(gl_state, revision);
-            } else if (cmdname.compare(CMD_NAME_SETPARAM) == 0) {
-                handle_setparam(gl_state, revision, changed_state);
-            } else if (cmdname.compare(CMD_NAME_GETCAMERA) == 0) {
-                handle_getcamera(state);
-            } else if (cmdname.compare(CMD_NAME_SETCAMERA) == 0) {
-                handle_setcamera(state, changed_state);
-            } else if (cmdname.compare(CMD_NAME_GETROTATION) == 0) {
-                handle_getrotation(state);
-            } else if (cmdname.compare(CMD_NAME_SETROTATION) == 0) {
-                handle_setrotation(state, changed_state);
-            } else if (cmdname.compare(CMD_NAME_GETSCALE) == 0) {
-                handle_getscale(state);
-            } else if (cmdname.compare(CMD_NAME_SETSCALE) == 0) {
-                handle_setscale(state, changed_state);
-            } else if (cmdname.compare(CMD_NAME_GEOMETRY) == 0) {
-                handle_geometry(gl_state, state, changed_state);
-            } else if (cmdname.compare(CMD_NAME_LOADDEFAULTS) == 0) {
-                handle_loaddefaults(gl_state, changed_state);
-            } else if (cmdname.compare(CMD_NAME_SETINPUT) == 0) {
-                handle_setinput(gl_state, changed_state);
-            } else {
-                net::default_reply result(false, "unknown command");
-                impl_->send(result);
+                if (gl_state.stale_frame(revision)) changed_state = true;
+
+                if (changed_state) return false;
+
+                reply->set_value(reduce_noise_stats(gl_state, revision, args));
+                return true;
+            },
+            false);
+
+        send_deferred(result);
+    }
+
+    void dispatch(const std::string &cmdname) {
+        if (cmdname.compare(CMD_NAME_GETFRAME) == 0) {
+            handle_getframe();
+        } else if (cmdname.compare(CMD_NAME_GETPARAMS) == 0) {
+            handle_getparams();
+        } else if (cmdname.compare(CMD_NAME_GETPARAM) == 0) {
+            handle_getparam();
+        } else if (cmdname.compare(CMD_NAME_SETPARAM) == 0) {
+            handle_setparam();
+        } else if (cmdname.compare(CMD_NAME_GETCAMERA) == 0) {
+            handle_getcamera();
+        } else if (cmdname.compare(CMD_NAME_SETCAMERA) == 0) {
+            handle_setcamera();
+        } else if (cmdname.compare(CMD_NAME_GETROTATION) == 0) {
+            handle_getrotation();
+        } else if (cmdname.compare(CMD_NAME_SETROTATION) == 0) {
+            handle_setrotation();
+        } else if (cmdname.compare(CMD_NAME_GETSCALE) == 0) {
+            handle_getscale();
+        } else if (cmdname.compare(CMD_NAME_SETSCALE) == 0) {
+            handle_setscale();
+        } else if (cmdname.compare(CMD_NAME_GEOMETRY) == 0) {
+            handle_geometry();
+        } else if (cmdname.compare(CMD_NAME_LOADDEFAULTS) == 0) {
+            handle_loaddefaults();
+        } else if (cmdname.compare(CMD_NAME_SETINPUT) == 0) {
+            handle_setinput();
+        } else if (cmdname.compare(CMD_NAME_GETSTATS) == 0) {
+            handle_getstats();
+        } else if (cmdname.compare(CMD_NAME_GETTILE) == 0) {
+            handle_gettile();
+        } else if (cmdname.compare(CMD_NAME_GETNOISESTATS) == 0) {
+            handle_getnoisestats();
+        } else if (cmdname.compare(CMD_NAME_GETSHM) == 0) {
+            handle_getshm();
+        } else {
+            net::default_reply result(false, "unknown command");
+            send(result);
+        }
+    }
+
+    /// Network thread: receive, decode and answer requests
+    void run() {
+        trace::name_thread("network");
+
+        while (running_) {
+            zmq::pollitem_t items[] = {
+                {static_cast<void *>(socket), 0, ZMQ_POLLIN, 0}};
+
+            // Wake up regularly to check for shutdown
+            zmq::poll(&items[0], sizeof(items) / sizeof(items[0]),
+                      server_poll_ms);
+
+            // Incoming request?
+            if (!(items[0].revents & ZMQ_POLLIN)) continue;
+
+            auto cmdname = recv_cmd();
+
+            try {
+                dispatch(cmdname);
+            } catch (std::exception &ex) {
+                // The REP socket still expects a reply
+                logger->error("Failed to handle {}: {}", cmdname, ex.what());
+                discard_more();
+
+                net::default_reply result(false, ex.what());
+                send(result);
             }
+        }
+    }
+};
+}  // namespace net
+
+server::server(const server_options &opt, const log_options &log_opt,
+               std::function<void()> wake)
+    : opt_(opt),
+      impl_{std::make_unique<server_impl>(opt, log_opt, std::move(wake))} {}
+
+server::~server() {}
+
+bool server::poll(viewer_state &state, gl_state &gl_state, int revision) const {
+    TRACE_SCOPE("server::poll", "net");
+
+    // true if we should stop applying commands and render the next frame
+    bool next_frame = false;
+    // true if we changed any render state, meaning the current frame does
+    // not match the new render state
+    bool changed_state = false;
+
+    // Check for a pending command waiting for this frame
+    if (impl_->pending) {
+        if (impl_->pending->apply(state, gl_state, revision, changed_state)) {
+            impl_->applied = impl_->pending->seq;
+            impl_->pending.reset();
+        } else {
+            next_frame = true;
+        }
+    }
+
+    // Apply the queued commands in order, until one needs a new frame
+    while (!impl_->pending) {
+        auto item = impl_->commands.try_pop();
+        if (!item) break;
+
+        if (item->apply(state, gl_state, revision, changed_state)) {
+            impl_->applied = item->seq;
         } else {
-            break;
+            impl_->pending = std::move(item);
+            next_frame = true;
         }
     }
 
+    impl_->publish(state, gl_state, revision);
+
     // We need a new render if we either changed state or actually need a new
     // frame
     return next_frame || changed_state;
 }
+
+bool server::has_work() const {
+    return impl_->pending.has_value() || !impl_->commands.empty();
+}
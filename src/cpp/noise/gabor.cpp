@@ -0,0 +1,590 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "noise/gabor.hpp"
+#include "noise/prng.hpp"
+#include "parallel_for.hpp"
+
+using namespace noise;
+
+/// Pixels per side of the tiles rendered by parallel tasks
+static const int tile_pixels = 32;
+
+/// Cells visited around the current one, max_disp in util/gabor_main.glsl
+static const int max_disp = 1;
+
+gabor_params::gabor_params()
+    : splats(3),
+      f0(1.f),
+      w0(0.f),
+      lobes(1),
+      tile_size(1.f),
+      sigma(1.f),
+      quad(true),
+      envelope(gabor_envelope::trunc),
+      prng(prng_type::xoroshiro),
+      poisson_splats(false),
+      random_seed(156237),
+      bbox_min(-1.f),
+      bbox_max(1.f) {}
+
+glm::ivec3 gabor_params::tile_count() const {
+    glm::vec3 extent(quad ? glm::vec3(1.f, 1.f, 0.f)
+                          : glm::ceil(bbox_max - bbox_min));
+    return glm::ivec3(extent / tile_size);
+}
+
+namespace {
+#if defined(__SSE2__)
+struct float4 {
+    __m128 v;
+
+    float4(__m128 v) : v(v) {}
+    float4(float s) : v(_mm_set1_ps(s)) {}
+    float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+
+struct int4 {
+    __m128i v;
+
+    int4(__m128i v) : v(v) {}
+    int4(int s) : v(_mm_set1_epi32(s)) {}
+};
+
+/// All bits set in selected lanes
+struct mask4 {
+    __m128 v;
+
+    mask4(__m128 v) : v(v) {}
+    mask4(bool a, bool b, bool c, bool d)
+        : v(_mm_castsi128_ps(_mm_setr_epi32(-a, -b, -c, -d))) {}
+};
+
+inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+inline float4 sqrt(float4 a) { return _mm_sqrt_ps(a.v); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+inline mask4 operator>(float4 a, float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+
+/// Lanes of a where mask is set, lanes of b elsewhere
+inline float4 select(mask4 mask, float4 a, float4 b) {
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+/// Round to nearest, ties to even
+inline int4 round_int(float4 a) { return _mm_cvtps_epi32(a.v); }
+inline float4 to_float(int4 a) { return _mm_cvtepi32_ps(a.v); }
+inline int4 operator+(int4 a, int4 b) { return _mm_add_epi32(a.v, b.v); }
+inline int4 operator&(int4 a, int4 b) { return _mm_and_si128(a.v, b.v); }
+
+inline mask4 nonzero(int4 a) {
+    __m128i zero = _mm_cmpeq_epi32(a.v, _mm_setzero_si128());
+    return _mm_castsi128_ps(_mm_xor_si128(zero, _mm_set1_epi32(-1)));
+}
+
+/// 2^n, for n in the range of normal floats
+inline float4 exp2i(int4 n) {
+    return _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_add_epi32(n.v, _mm_set1_epi32(127)), 23));
+}
+#else
+struct float4 {
+    float v[4];
+
+    float4(float s) : v{s, s, s, s} {}
+    float4(float a, float b, float c, float d) : v{a, b, c, d} {}
+
+    void store(float *p) const { std::copy(v, v + 4, p); }
+};
+
+struct int4 {
+    int v[4];
+
+    int4(int s) : v{s, s, s, s} {}
+    int4(int a, int b, int c, int d) : v{a, b, c, d} {}
+};
+
+struct mask4 {
+    bool v[4];
+
+    mask4(bool a, bool b, bool c, bool d) : v{a, b, c, d} {}
+};
+
+#define LANES(T, expr) T(expr(0), expr(1), expr(2), expr(3))
+
+inline float4 operator+(float4 a, float4 b) {
+#define L(i) a.v[i] + b.v[i]
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 operator-(float4 a, float4 b) {
+#define L(i) a.v[i] - b.v[i]
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 operator*(float4 a, float4 b) {
+#define L(i) a.v[i] * b.v[i]
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 operator/(float4 a, float4 b) {
+#define L(i) a.v[i] / b.v[i]
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 sqrt(float4 a) {
+#define L(i) std::sqrt(a.v[i])
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 min(float4 a, float4 b) {
+#define L(i) std::min(a.v[i], b.v[i])
+    return LANES(float4, L);
+#undef L
+}
+
+inline float4 max(float4 a, float4 b) {
+#define L(i) std::max(a.v[i], b.v[i])
+    return LANES(float4, L);
+#undef L
+}
+
+inline mask4 operator>(float4 a, float4 b) {
+#define L(i) a.v[i] > b.v[i]
+    return LANES(mask4, L);
+#undef L
+}
+
+/// Lanes of a where mask is set, lanes of b elsewhere
+inline float4 select(mask4 mask, float4 a, float4 b) {
+#define L(i) mask.v[i] ? a.v[i] : b.v[i]
+    return LANES(float4, L);
+#undef L
+}
+
+/// Round to nearest, ties to even
+inline int4 round_int(float4 a) {
+#define L(i) int(std::nearbyint(a.v[i]))
+    return LANES(int4, L);
+#undef L
+}
+
+inline float4 to_float(int4 a) {
+#define L(i) float(a.v[i])
+    return LANES(float4, L);
+#undef L
+}
+
+inline int4 operator+(int4 a, int4 b) {
+#define L(i) a.v[i] + b.v[i]
+    return LANES(int4, L);
+#undef L
+}
+
+inline int4 operator&(int4 a, int4 b) {
+#define L(i) a.v[i] & b.v[i]
+    return LANES(int4, L);
+#undef L
+}
+
+inline mask4 nonzero(int4 a) {
+#define L(i) a.v[i] != 0
+    return LANES(mask4, L);
+#undef L
+}
+
+/// 2^n, for n in the range of normal floats
+inline float4 exp2i(int4 n) {
+#define L(i) std::ldexp(1.f, n.v[i])
+    return LANES(float4, L);
+#undef L
+}
+
+#undef LANES
+#endif
+
+/// exp(x), Cephes expf polynomial
+inline float4 exp(float4 x) {
+    x = min(max(x, -87.3f), 88.3f);
+
+    int4 n = round_int(x * 1.44269504088896341f);
+    float4 fn = to_float(n);
+    x = x - fn * 0.693359375f + fn * 2.12194440e-4f;
+
+    float4 p = 1.9875691500e-4f;
+    p = p * x + 1.3981999507e-3f;
+    p = p * x + 8.3334519073e-3f;
+    p = p * x + 4.1665795894e-2f;
+    p = p * x + 1.6666665459e-1f;
+    p = p * x + 5.0000001201e-1f;
+    p = p * x * x + x + 1.f;
+
+    return p * exp2i(n);
+}
+
+/// sin(x + quadrant * pi / 2), Cephes sinf and cosf polynomials
+inline float4 sin(float4 x, int quadrant = 0) {
+    int4 j = round_int(x * 0.636619772367581343f);
+    float4 fj = to_float(j);
+
+    // Extended precision reduction to [-pi/4, pi/4]
+    float4 r = x - fj * 1.5703125f;
+    r = r - fj * 4.837512969970703125e-4f;
+    r = r - fj * 7.54978995489188216e-8f;
+
+    float4 z = r * r;
+    float4 s = -1.9515295891e-4f;
+    s = s * z + 8.3321608736e-3f;
+    s = s * z - 1.6666654611e-1f;
+    s = s * z * r + r;
+
+    float4 c = 2.443315711809948e-5f;
+    c = c * z - 1.388731625493765e-3f;
+    c = c * z + 4.166664568298827e-2f;
+    c = c * z * z - z * .5f + 1.f;
+
+    int4 q = j + quadrant;
+    float4 y = select(nonzero(q & 1), c, s);
+    return select(nonzero(q & 2), 0.f - y, y);
+}
+
+inline float4 cos(float4 x) { return sin(x, 1); }
+
+/// eb() in gabor/kernel.glsl
+template <gabor_envelope E>
+float4 envelope(float4 r) {
+    float4 e(0.f);
+
+    if (E == gabor_envelope::kaiser) {
+        e = 0.402f + 0.498f * cos(2.f * pi * (r / 8.f)) +
+            0.099f * cos(4.f * pi * (r / 8.f)) + cos(6.f * pi * (r / 8.f));
+    } else if (E == gabor_envelope::trunc) {
+        const float e_pi = std::exp(-pi);
+        e = (exp(0.f - pi * r * r) - e_pi) / (1.f - e_pi);
+    } else {
+        e = exp(0.f - pi * r * r);
+    }
+
+    // Truncate kernel so it fits in a cell
+    return select(r > 1.f, 0.f, e);
+}
+
+struct splat {
+    glm::vec3 position;
+    glm::vec3 w0;
+    float phase;
+    /// Prefiltering weight, constant over a quad
+    float f;
+};
+
+/// Values shared by all tiles of a frame
+struct frame_setup {
+    const gabor_params &params;
+    int width;
+    int height;
+    /// Aspect ratio correction of the quad, as in vertex.glsl
+    float ratio;
+    glm::ivec3 tile_count;
+    /// Change in vPosition from one pixel to the next
+    glm::vec3 dpdx;
+    glm::vec3 dpdy;
+    glm::vec3 normal;
+
+    frame_setup(const gabor_params &params, int width, int height)
+        : params(params),
+          width(width),
+          height(height),
+          ratio(float(width) / float(height)),
+          tile_count(params.tile_count()),
+          dpdx(2.f * ratio / width, 0.f, 0.f),
+          dpdy(0.f, 2.f / height, 0.f),
+          normal(0.f, 0.f, 1.f) {}
+
+    /// Noise coordinates of the center of pixel (x, y)
+    glm::vec3 position(float x, float y) const {
+        return params.bbox_min +
+               glm::vec3((2.f * (x + .5f) / width - 1.f) * ratio,
+                         2.f * (y + .5f) / height - 1.f, 0.f);
+    }
+
+    /// ccell in gabor/grid.glsl, along one axis
+    int current_cell(float p) const {
+        float c = p / params.tile_size;
+        if (!params.quad) c += .5f * ((p > 0.f) - (p < 0.f));
+        return int(c);
+    }
+
+    glm::ivec3 current_cell(const glm::vec3 &p) const {
+        return glm::ivec3(current_cell(p.x), current_cell(p.y),
+                          current_cell(p.z));
+    }
+};
+
+/// Splats of a box of cells
+class cell_block {
+    glm::ivec3 min_;
+    glm::ivec3 size_;
+    /// Start of the splats of each cell, plus the total count
+    std::vector<size_t> offsets_;
+    std::vector<splat> splats_;
+
+    size_t index(const glm::ivec3 &cell) const {
+        glm::ivec3 c(cell - min_);
+        return (size_t(c.z) * size_.y + c.y) * size_.x + c.x;
+    }
+
+   public:
+    /// gaborCell in gabor-noise-solid.glsl, up to the kernel evaluation
+    template <typename Prng>
+    void generate(const frame_setup &setup, const glm::ivec3 &min,
+                  const glm::ivec3 &max) {
+        const auto &params(setup.params);
+        const glm::vec3 &n(setup.normal);
+        const float tile = params.tile_size;
+
+        min_ = min;
+        size_ = max - min + 1;
+        offsets_.clear();
+        splats_.clear();
+
+        glm::ivec3 cell;
+        for (cell.z = min.z; cell.z <= max.z; ++cell.z) {
+            for (cell.y = min.y; cell.y <= max.y; ++cell.y) {
+                for (cell.x = min.x; cell.x <= max.x; ++cell.x) {
+                    offsets_.push_back(splats_.size());
+
+                    glm::vec3 center(params.quad
+                                         ? tile * (glm::vec3(.5f) +
+                                                   glm::vec3(cell))
+                                         : tile * glm::vec3(cell));
+
+                    white_points<Prng> points(cell, setup.tile_count,
+                                              params.random_seed,
+                                              params.splats,
+                                              params.poisson_splats);
+
+                    for (int i = 0; i < points.splats(); ++i) {
+                        glm::vec4 td_point(points.point4());
+                        glm::vec4 td_extra(points.point4());
+
+                        // GETW0 in gabor/orient.glsl
+                        float a = .5f + .5f * td_extra.x;
+                        float theta =
+                            params.w0.x + std::floor(a * params.lobes) /
+                                              (2.f * params.lobes) * 2.f * pi;
+                        glm::vec3 w0(std::cos(theta) * std::cos(params.w0.y),
+                                     std::sin(theta) * std::cos(params.w0.y),
+                                     std::sin(params.w0.y));
+
+                        // Prefiltering, screen derivatives of
+                        // dot(vPosition, w0) are constant over the quad
+                        glm::vec3 w0p0 = w0 - glm::dot(w0, n) * n;
+                        float w0p = std::hypot(glm::dot(setup.dpdx, w0),
+                                               glm::dot(setup.dpdy, w0));
+                        float wP = 2.f * pi * params.f0 * w0p;
+                        float k = glm::length(w0p0) * wP / params.sigma;
+
+                        splat s;
+                        s.f = std::exp(-k * k / 2.f);
+
+                        // On a quad, don't offset points in the z direction
+                        if (params.quad) td_point.z = 0.f;
+
+                        s.position = center + tile / 2.f * glm::vec3(td_point);
+                        s.w0 = w0;
+                        s.phase = pi * (2.f * td_point.w - 1.f);
+                        splats_.push_back(s);
+                    }
+                }
+            }
+        }
+
+        offsets_.push_back(splats_.size());
+    }
+
+    const splat *begin(const glm::ivec3 &cell) const {
+        return splats_.data() + offsets_[index(cell)];
+    }
+
+    const splat *end(const glm::ivec3 &cell) const {
+        return splats_.data() + offsets_[index(cell) + 1];
+    }
+};
+
+struct tile_rect {
+    int x0, y0, x1, y1;
+};
+
+template <typename Prng, gabor_envelope E>
+void render_tile(const frame_setup &setup, const tile_rect &rect,
+                 cell_block &block, float *pixels) {
+    const auto &params(setup.params);
+    const float tile = params.tile_size;
+    const float k = 2.f * pi * params.f0;
+    const float norm =
+        .5f * std::sqrt(3.f) * 3.f /
+        (4.f * std::sqrt((1.f - std::exp(-2.f * pi * params.f0 * params.f0 *
+                                         tile * tile)) *
+                         float(params.splats)));
+
+    // The z range is only searched by the 3D grid
+    glm::ivec3 disp(max_disp, max_disp, params.quad ? 0 : max_disp);
+    glm::ivec3 first(
+        setup.current_cell(setup.position(rect.x0, rect.y0)));
+    glm::ivec3 last(
+        setup.current_cell(setup.position(rect.x1 - 1, rect.y1 - 1)));
+    block.generate<Prng>(setup, glm::min(first, last) - disp,
+                         glm::max(first, last) + disp);
+
+    for (int y = rect.y0; y < rect.y1; ++y) {
+        for (int x = rect.x0; x < rect.x1; x += 4) {
+            // Lanes only differ along x. Lanes past the tile repeat its
+            // last pixel, so they stay within the generated cells
+            glm::vec3 p[4];
+            int ccx[4];
+            for (int l = 0; l < 4; ++l) {
+                p[l] = setup.position(std::min(x + l, rect.x1 - 1), y);
+                ccx[l] = setup.current_cell(p[l].x);
+            }
+
+            glm::ivec3 ccell(setup.current_cell(p[0]));
+            float4 px(p[0].x, p[1].x, p[2].x, p[3].x);
+            float4 r_sum(0.f), g_sum(0.f), b_sum(0.f);
+
+            // Same cell order as the shader, so each lane sums its splats
+            // in the same order
+            glm::ivec3 cell;
+            for (cell.x = std::min(ccx[0], ccx[3]) - disp.x;
+                 cell.x <= std::max(ccx[0], ccx[3]) + disp.x; ++cell.x) {
+                mask4 lanes(std::abs(cell.x - ccx[0]) <= disp.x,
+                            std::abs(cell.x - ccx[1]) <= disp.x,
+                            std::abs(cell.x - ccx[2]) <= disp.x,
+                            std::abs(cell.x - ccx[3]) <= disp.x);
+
+                for (cell.y = ccell.y - disp.y; cell.y <= ccell.y + disp.y;
+                     ++cell.y) {
+                    for (cell.z = ccell.z - disp.z;
+                         cell.z <= ccell.z + disp.z; ++cell.z) {
+                        for (auto s = block.begin(cell), e = block.end(cell);
+                             s != e; ++s) {
+                            float4 dx = (px - s->position.x) / tile;
+                            float dy = (p[0].y - s->position.y) / tile;
+                            float dz = (p[0].z - s->position.z) / tile;
+
+                            float4 r = sqrt(dx * dx + dy * dy + dz * dz);
+                            float4 phase = dx * tile * s->w0.x +
+                                           dy * tile * s->w0.y +
+                                           dz * tile * s->w0.z;
+                            float4 noise = envelope<E>(r) *
+                                           sin(k * phase + s->phase);
+
+                            r_sum = r_sum + select(lanes, s->f * noise, 0.f);
+                            g_sum = g_sum + select(lanes, s->f, 0.f);
+                            b_sum = b_sum + select(lanes, noise, 0.f);
+                        }
+                    }
+                }
+            }
+
+            alignas(16) float r[4], g[4], b[4];
+            r_sum.store(r);
+            g_sum.store(g);
+            b_sum.store(b);
+
+            // Normalize output, as in util/gabor_main.glsl
+            for (int l = 0; l < std::min(4, rect.x1 - x); ++l) {
+                float *o = pixels + (size_t(y) * setup.width + x + l) * 4;
+                float nb = b[l] * norm;
+
+                o[0] = .5f * (r[l] * norm) + .5f;
+                o[1] = g[l];
+                o[2] = nb * nb;
+                o[3] = 1.f;
+            }
+        }
+    }
+}
+
+template <typename Prng>
+void render_tile(const frame_setup &setup, const tile_rect &rect,
+                 cell_block &block, float *pixels) {
+    switch (setup.params.envelope) {
+        case gabor_envelope::gaussian:
+            render_tile<Prng, gabor_envelope::gaussian>(setup, rect, block,
+                                                        pixels);
+            break;
+        case gabor_envelope::trunc:
+            render_tile<Prng, gabor_envelope::trunc>(setup, rect, block,
+                                                     pixels);
+            break;
+        case gabor_envelope::kaiser:
+            render_tile<Prng, gabor_envelope::kaiser>(setup, rect, block,
+                                                      pixels);
+            break;
+    }
+}
+
+void render_tile(const frame_setup &setup, const tile_rect &rect,
+                 cell_block &block, float *pixels) {
+    switch (setup.params.prng) {
+        case prng_type::hash:
+            render_tile<hash_prng>(setup, rect, block, pixels);
+            break;
+        case prng_type::lcg:
+            render_tile<lcg_prng>(setup, rect, block, pixels);
+            break;
+        case prng_type::xorshift:
+            render_tile<xorshift_prng>(setup, rect, block, pixels);
+            break;
+        case prng_type::xoroshiro:
+            render_tile<xoroshiro_prng>(setup, rect, block, pixels);
+            break;
+        case prng_type::none:
+            render_tile<none_prng>(setup, rect, block, pixels);
+            break;
+    }
+}
+}  // namespace
+
+void noise::render_gabor(const gabor_params &params, int width, int height,
+                         float *pixels) {
+    if (width <= 0 || height <= 0) return;
+
+    frame_setup setup(params, width, height);
+
+    std::vector<tile_rect> tiles;
+    for (int y = 0; y < height; y += tile_pixels) {
+        for (int x = 0; x < width; x += tile_pixels) {
+            tiles.push_back({x, y, std::min(width, x + tile_pixels),
+                             std::min(height, y + tile_pixels)});
+        }
+    }
+
+    parallel_for<cell_block>(tiles.size(), [&](cell_block &block, size_t i) {
+        render_tile(setup, tiles[i], block, pixels);
+    });
+}
+
+std::vector<float> noise::render_gabor(const gabor_params &params, int width,
+                                       int height) {
+    std::vector<float> pixels(size_t(std::max(width, 0)) *
+                              std::max(height, 0) * 4);
+    render_gabor(params, width, height, pixels.data());
+    return pixels;
+}
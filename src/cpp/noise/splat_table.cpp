@@ -0,0 +1,64 @@
+#include <algorithm>
+
+#include "noise/prng_batch.hpp"
+#include "noise/splat_table.hpp"
+#include "parallel_for.hpp"
+
+using namespace noise;
+
+/// Rows generated together by a worker
+static const size_t chunk_rows = 1024;
+
+/// Scratch buffers of a worker
+struct chunk_buffers {
+    std::vector<uint32_t> seeds;
+    std::vector<float> values;
+};
+
+splat_table noise::make_splat_table(const glm::ivec3 &tile_count,
+                                    int random_seed, int splats) {
+    // pg_point4 is called twice per splat
+    size_t width = std::max(2 * splats, 1);
+    size_t rows = size_t(std::max(tile_count.x, 1)) *
+                  std::max(tile_count.y, 1) * std::max(tile_count.z, 1);
+
+    splat_table table;
+    table.data.resize(width * rows * 4);
+    table.dims = {uint32_t(width), uint32_t(rows), 4};
+
+    size_t chunks = (rows + chunk_rows - 1) / chunk_rows;
+
+    parallel_for<chunk_buffers>(chunks, [&](chunk_buffers &buffers,
+                                            size_t chunk) {
+        auto &seeds(buffers.seeds);
+        auto &values(buffers.values);
+
+        size_t begin = chunk * chunk_rows;
+        size_t count = std::min(chunk_rows, rows - begin);
+
+        // Same wrap-around as the int arithmetic of the shader
+        seeds.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            seeds[i] = uint32_t(begin + i) + uint32_t(random_seed);
+
+        prng_batch<xoroshiro_gen> batch(seeds.data(), count);
+        values.resize(2 * count);
+
+        // The table holds the random values, pg_point4 maps them to [-1, 1]
+        // like the white generator does
+        for (size_t column = 0; column < width; ++column) {
+            for (size_t half = 0; half < 2; ++half) {
+                batch.rand2(values.data());
+
+                for (size_t i = 0; i < count; ++i) {
+                    float *texel =
+                        &table.data[((begin + i) * width + column) * 4];
+                    texel[2 * half] = values[2 * i];
+                    texel[2 * half + 1] = values[2 * i + 1];
+                }
+            }
+        }
+    });
+
+    return table;
+}
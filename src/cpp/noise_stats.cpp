@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "config.hpp"
+#include "log.hpp"
+#include "noise_stats.hpp"
+#include "program_cache.hpp"
+#include "trace.hpp"
+
+/// Side of the work groups of the moments pass
+static const int group_side = 16;
+
+/// Floats in the moments struct of noise-stats.glsl
+static const size_t moments_floats = 20;
+
+static bool is_power_of_two(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+static void set_uniform(GLuint program, const char *name, int value) {
+    glProgramUniform1i(program, glGetUniformLocation(program, name), value);
+}
+
+noise_stats_reducer::noise_stats_reducer()
+    : moments_program_(0), reduce_program_(0), buffers_{} {}
+
+noise_stats_reducer::~noise_stats_reducer() {
+    if (!moments_program_) return;
+
+    glDeleteProgram(moments_program_);
+    glDeleteProgram(reduce_program_);
+    for (const auto &pair : fft_rows_programs_) glDeleteProgram(pair.second);
+    for (const auto &pair : fft_columns_programs_)
+        glDeleteProgram(pair.second);
+
+    glDeleteBuffers(4, buffers_);
+}
+
+GLuint noise_stats_reducer::make_program(const std::string &defines) {
+    static const std::string source = []() {
+        std::ifstream ifs(SHADERS_BASE "noise-stats.glsl");
+        if (!ifs)
+            throw std::runtime_error("could not open noise-stats.glsl");
+
+        return std::string(std::istreambuf_iterator<char>(ifs),
+                           std::istreambuf_iterator<char>());
+    }();
+
+    std::string header("#version 450\n" + defines);
+    const char *sources[] = {header.c_str(), source.c_str()};
+
+    // No libshadertoy wrapper yet, it only builds graphics programs
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 2, sources, nullptr);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::string log(std::max(length, 1), '\0');
+        glGetShaderInfoLog(shader, log.size(), nullptr, &log[0]);
+        glDeleteShader(shader);
+
+        throw std::runtime_error("failed to compile noise-stats.glsl: " + log);
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    program_cache::link(program);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        throw std::runtime_error("failed to link noise-stats.glsl");
+    }
+
+    return program;
+}
+
+noise_stats noise_stats_reducer::reduce(
+    shadertoy::backends::gx::texture &texture,
+    const noise_stats_options &opt) {
+    TRACE_SCOPE("noise_stats_reducer::reduce", "gl");
+
+    if (opt.channel < 0 || opt.channel > 3)
+        throw std::runtime_error("invalid channel " +
+                                 std::to_string(opt.channel));
+
+    if (opt.bins < 0 || opt.bins > max_bins)
+        throw std::runtime_error("histogram bins must be in [0, " +
+                                 std::to_string(max_bins) + "]");
+
+    if (opt.bins > 0 && !(opt.range.x < opt.range.y))
+        throw std::runtime_error("invalid histogram range");
+
+    if (opt.spectrum_bins < 0 || opt.spectrum_bins > max_spectrum_bins)
+        throw std::runtime_error("spectrum bins must be in [0, " +
+                                 std::to_string(max_spectrum_bins) + "]");
+
+    GLint width, height;
+    texture.get_parameter(GL_TEXTURE_WIDTH, &width);
+    texture.get_parameter(GL_TEXTURE_HEIGHT, &height);
+
+    bool spectrum = opt.spectrum_bins > 0;
+    if (spectrum) {
+        for (int side : {width, height}) {
+            if (side < 2 || side > max_spectrum_size || !is_power_of_two(side))
+                throw std::runtime_error(
+                    "the spectrum requires power of two sizes up to " +
+                    std::to_string(max_spectrum_size));
+        }
+    }
+
+    if (!moments_program_) {
+        moments_program_ = make_program("#define STATS_MOMENTS\n");
+        reduce_program_ = make_program("#define STATS_REDUCE\n");
+        glCreateBuffers(4, buffers_);
+    }
+
+    GLuint fft_rows = 0, fft_columns = 0;
+    if (spectrum) {
+        auto get_fft = [this](std::map<int, GLuint> &programs,
+                              const char *pass, int size) {
+            auto it = programs.find(size);
+            if (it != programs.end()) return it->second;
+
+            return programs[size] = make_program(
+                       std::string("#define ") + pass + "\n#define FFT_SIZE " +
+                       std::to_string(size) + "\n");
+        };
+
+        fft_rows = get_fft(fft_rows_programs_, "STATS_FFT_ROWS", width);
+        fft_columns =
+            get_fft(fft_columns_programs_, "STATS_FFT_COLUMNS", height);
+    }
+
+    GLuint groups_x = (width + group_side - 1) / group_side,
+           groups_y = (height + group_side - 1) / group_side;
+    size_t result_size = moments_floats * sizeof(float) +
+                         std::max(opt.bins, 1) * sizeof(GLuint);
+
+    glNamedBufferData(buffers_[0],
+                      groups_x * groups_y * moments_floats * sizeof(float),
+                      nullptr, GL_DYNAMIC_COPY);
+    glNamedBufferData(buffers_[1], result_size, nullptr, GL_DYNAMIC_READ);
+    glClearNamedBufferData(buffers_[1], GL_R32UI, GL_RED_INTEGER,
+                           GL_UNSIGNED_INT, nullptr);
+
+    for (GLuint i = 0; i < 2; ++i)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers_[i]);
+
+    texture.bind_unit(0);
+
+    // Moments of each work group, and the histogram
+    set_uniform(moments_program_, "uChannel", opt.channel);
+    set_uniform(moments_program_, "uBins", opt.bins);
+    glProgramUniform2f(moments_program_,
+                       glGetUniformLocation(moments_program_, "uRange"),
+                       opt.range.x, opt.range.y);
+
+    glUseProgram(moments_program_);
+    glDispatchCompute(groups_x, groups_y, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Moments of the image
+    set_uniform(reduce_program_, "uGroups", groups_x * groups_y);
+
+    glUseProgram(reduce_program_);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    if (spectrum) {
+        // Spectrum bands are accumulated as float bits, 0 is 0.f
+        glNamedBufferData(buffers_[2],
+                          size_t(width) * height * 2 * sizeof(float), nullptr,
+                          GL_DYNAMIC_COPY);
+        glNamedBufferData(buffers_[3], opt.spectrum_bins * sizeof(GLuint),
+                          nullptr, GL_DYNAMIC_READ);
+        glClearNamedBufferData(buffers_[3], GL_R32UI, GL_RED_INTEGER,
+                               GL_UNSIGNED_INT, nullptr);
+
+        for (GLuint i = 2; i < 4; ++i)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, buffers_[i]);
+
+        set_uniform(fft_rows, "uChannel", opt.channel);
+
+        glUseProgram(fft_rows);
+        glDispatchCompute(height, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        set_uniform(fft_columns, "uWidth", width);
+        set_uniform(fft_columns, "uSpectrumBins", opt.spectrum_bins);
+
+        glUseProgram(fft_columns);
+        glDispatchCompute(width, 1, 1);
+    }
+
+    glUseProgram(0);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // Only the reduced values are read back
+    std::vector<float> moments(moments_floats);
+    glGetNamedBufferSubData(buffers_[1], 0, moments_floats * sizeof(float),
+                            moments.data());
+
+    const float *count = &moments[0], *mean = &moments[4], *m2 = &moments[8],
+                *lo = &moments[12], *hi = &moments[16];
+
+    noise_stats result;
+    result["count"] = {count[0]};
+
+    for (int c = 0; c < 4; ++c) {
+        result["mean"].push_back(mean[c]);
+        result["variance"].push_back(count[c] > 0.f ? m2[c] / count[c] : 0.);
+        result["min"].push_back(lo[c]);
+        result["max"].push_back(hi[c]);
+    }
+
+    if (opt.bins > 0) {
+        std::vector<GLuint> histogram(opt.bins);
+        glGetNamedBufferSubData(buffers_[1], moments_floats * sizeof(float),
+                                histogram.size() * sizeof(GLuint),
+                                histogram.data());
+        result["histogram"].assign(histogram.begin(), histogram.end());
+    }
+
+    if (spectrum) {
+        std::vector<float> bands(opt.spectrum_bins);
+        glGetNamedBufferSubData(buffers_[3], 0, bands.size() * sizeof(float),
+                                bands.data());
+        result["spectrum"].assign(bands.begin(), bands.end());
+    }
+
+    VLOG->debug("Reduced {}x{} texture, {} histogram bins, {} spectrum bands",
+                width, height, opt.bins, opt.spectrum_bins);
+
+    return result;
+}
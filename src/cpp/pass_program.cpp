@@ -0,0 +1,158 @@
+#include <epoxy/gl.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "pass_program.hpp"
+#include "program_cache.hpp"
+
+using namespace shadertoy;
+
+void apply_uniform(GLuint program, GLint location, float value) {
+    glProgramUniform1f(program, location, value);
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::vec2 &value) {
+    glProgramUniform2fv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::vec3 &value) {
+    glProgramUniform3fv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::vec4 &value) {
+    glProgramUniform4fv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, int value) {
+    glProgramUniform1i(program, location, value);
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::ivec2 &value) {
+    glProgramUniform2iv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::ivec3 &value) {
+    glProgramUniform3iv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::ivec4 &value) {
+    glProgramUniform4iv(program, location, 1, glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location, bool value) {
+    glProgramUniform1i(program, location, value);
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::bvec2 &value) {
+    apply_uniform(program, location, glm::ivec2(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::bvec3 &value) {
+    apply_uniform(program, location, glm::ivec3(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::bvec4 &value) {
+    apply_uniform(program, location, glm::ivec4(value));
+}
+
+void apply_uniform(GLuint program, GLint location, const glm::mat4 &value) {
+    glProgramUniformMatrix4fv(program, location, 1, GL_FALSE,
+                              glm::value_ptr(value));
+}
+
+void apply_uniform(GLuint program, GLint location,
+                   const uniform_value &value) {
+    std::visit([program, location](const auto &v)
+               { apply_uniform(program, location, v); },
+               value);
+}
+
+bool try_parse_pass_uniform(const std::string &line,
+                            std::vector<discovered_uniform> &uniforms) {
+    std::vector<discovered_uniform> parsed;
+    if (!try_parse_uniform(line, parsed)) return false;
+
+    const auto &name(parsed.back().s_name);
+    if (std::none_of(uniforms.begin(), uniforms.end(),
+                     [&name](const auto &du) { return du.s_name == name; }))
+        uniforms.push_back(parsed.back());
+
+    return true;
+}
+
+pass_program::pass_program() : program_(0), resolution_location_(-1) {}
+
+pass_program::~pass_program() {
+    if (program_) glDeleteProgram(program_);
+}
+
+GLint pass_program::location(const std::string &name) const {
+    if (!program_) return -1;
+    return glGetUniformLocation(program_, name.c_str());
+}
+
+void pass_program::link(const std::string &description,
+                        const std::vector<pass_shader> &shaders,
+                        const std::vector<discovered_binding> &bindings) {
+    // No libshadertoy wrapper yet, it only builds the programs of its buffers
+    GLuint program = glCreateProgram();
+    GLint status = GL_FALSE, length = 0;
+
+    for (const auto &shader_sources : shaders) {
+        GLuint shader = glCreateShader(shader_sources.type);
+        glShaderSource(shader, shader_sources.sources.size(),
+                       shader_sources.sources.data(), nullptr);
+        glCompileShader(shader);
+
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE) {
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+            std::string log(std::max(length, 1), '\0');
+            glGetShaderInfoLog(shader, log.size(), nullptr, &log[0]);
+            glDeleteShader(shader);
+            glDeleteProgram(program);
+
+            throw std::runtime_error("Failed to compile " + description +
+                                     ": " + log);
+        }
+
+        // Deleted with the program
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+
+    program_cache::link(program);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::string log(std::max(length, 1), '\0');
+        glGetProgramInfoLog(program, log.size(), nullptr, &log[0]);
+        glDeleteProgram(program);
+
+        throw std::runtime_error("Failed to link " + description + ": " + log);
+    }
+
+    if (program_) glDeleteProgram(program_);
+    program_ = program;
+
+    // Input i is bound to texture unit i
+    for (size_t i = 0; i < bindings.size(); ++i)
+        apply_uniform(program_, location(bindings[i].uniform_name), int(i));
+
+    resolution_location_ = location("iResolution");
+
+    for (auto &pair : uniforms_) {
+        pair.second.location = location(pair.first);
+        if (pair.second.location >= 0)
+            apply_uniform(program_, pair.second.location, pair.second.value);
+    }
+}
+
+void pass_program::set_resolution(const rsize &size) {
+    apply_uniform(program_, resolution_location_,
+                  glm::vec3(size.width, size.height, 1.f));
+}
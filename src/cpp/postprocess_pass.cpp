@@ -0,0 +1,143 @@
+#include <epoxy/gl.h>
+
+#include <shadertoy/backends/gl4/texture.hpp>
+
+#include <sstream>
+
+#include "log.hpp"
+#include "postprocess_pass.hpp"
+#include "trace.hpp"
+
+using namespace shadertoy;
+namespace gx = shadertoy::backends::gx;
+
+/// Full-screen triangle, drawn without vertex attributes
+static const char *vertex_source = R"(#version 440
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(2. * p - 1., 0., 1.);
+}
+)";
+
+static const char *fragment_main = R"(
+void main()
+{
+    mainImage(fragColor, gl_FragCoord.xy);
+}
+)";
+
+pass_framebuffer::pass_framebuffer()
+    : framebuffer_(0), vertex_array_(0), sampler_(0) {}
+
+pass_framebuffer::~pass_framebuffer() {
+    if (!framebuffer_) return;
+
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteVertexArrays(1, &vertex_array_);
+    glDeleteSamplers(1, &sampler_);
+}
+
+void pass_framebuffer::bind(compute_output &output, const rsize &size) {
+    // No libshadertoy wrapper yet, its framebuffers belong to the buffers
+    if (!framebuffer_) {
+        glCreateFramebuffers(1, &framebuffer_);
+        glCreateVertexArrays(1, &vertex_array_);
+
+        glCreateSamplers(1, &sampler_);
+        glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER,
+                            GL_LINEAR_MIPMAP_LINEAR);
+        glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    auto gl_texture =
+        static_cast<const backends::gl4::texture *>(output.texture());
+
+    // Passes only differ by their color attachment
+    glNamedFramebufferTexture(framebuffer_, GL_COLOR_ATTACHMENT0,
+                              GLuint(*gl_texture), 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, size.width, size.height);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glBindVertexArray(vertex_array_);
+}
+
+void pass_framebuffer::unbind() {
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+postprocess_pass::postprocess_pass(const std::string &id,
+                                   const std::string &source,
+                                   std::vector<discovered_uniform> &uniforms)
+    : id_(id), source_(source) {
+    std::string line;
+    std::istringstream iss(source);
+    while (std::getline(iss, line)) {
+        if (try_parse_pass_uniform(line, uniforms)) continue;
+        try_parse_binding(line, bindings_);
+    }
+}
+
+void postprocess_pass::compile() {
+    if (program_.linked()) return;
+
+    TRACE_SCOPE("postprocess_pass::compile", "gl");
+
+    std::stringstream header;
+    header << "#version 440\n"
+           << "uniform vec3 iResolution;\n"
+           << "uniform float iTime;\n"
+           << "uniform float iTimeDelta;\n"
+           << "uniform int iFrame;\n"
+           << "uniform float iFrameRate;\n"
+           << "uniform vec4 iMouse;\n"
+           << "uniform vec4 iDate;\n"
+           << "layout(location = 0) out vec4 fragColor;\n";
+
+    for (const auto &binding : bindings_)
+        header << "uniform sampler2D " << binding.uniform_name << ";\n";
+
+    // Report errors at the lines of the pass source
+    header << "#line 1\n";
+
+    std::string header_source(header.str());
+    program_.link("postprocessing pass " + id_,
+                  {{GL_VERTEX_SHADER, {vertex_source}},
+                   {GL_FRAGMENT_SHADER,
+                    {header_source.c_str(), source_.c_str(), fragment_main}}},
+                  bindings_);
+
+    VLOG->debug("Compiled postprocessing pass {}", id_);
+}
+
+void postprocess_pass::draw(const std::vector<gx::texture *> &inputs,
+                            compute_output &output, const rsize &size,
+                            pass_framebuffer &target) {
+    output.allocate(size);
+
+    program_.set_resolution(size);
+
+    target.bind(output, size);
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        inputs[i]->bind_unit(i);
+        glBindSampler(i, target.sampler());
+    }
+
+    glUseProgram(program_.get());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glUseProgram(0);
+
+    // Other members sample with their own parameters
+    for (size_t i = 0; i < inputs.size(); ++i) glBindSampler(i, 0);
+
+    target.unbind();
+
+    // Later passes and the postprocess shader use mipmapped filtering
+    output.texture()->generate_mipmap();
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <numeric>
+
+#include "profiler.hpp"
+#include "trace.hpp"
+
+/// Interval between GPU clock calibrations when tracing
+static const double calibration_interval_us = 1.0e6;
+
+sample_ring::sample_ring(size_t capacity)
+    : samples_(capacity, 0.0f), next_(0), size_(0) {}
+
+void sample_ring::push(float ms) {
+    samples_[next_] = ms;
+    next_ = (next_ + 1) % samples_.size();
+    size_ = std::min(size_ + 1, samples_.size());
+}
+
+float sample_ring::last() const {
+    if (size_ == 0) return 0.0f;
+    return samples_[(next_ + samples_.size() - 1) % samples_.size()];
+}
+
+float sample_ring::mean() const {
+    if (size_ == 0) return 0.0f;
+    return std::accumulate(samples_.begin(), samples_.begin() + size_, 0.0f) /
+           size_;
+}
+
+float sample_ring::percentile(float p) const {
+    if (size_ == 0) return 0.0f;
+
+    // Samples are stored unordered once the ring wrapped, so work on a copy
+    std::vector<float> sorted(samples_.begin(), samples_.begin() + size_);
+    size_t rank = std::min(
+        size_ - 1, static_cast<size_t>(p / 100.0f * (size_ - 1) + 0.5f));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+profiler::profiler()
+    : gpu_reference_ns_(0), trace_reference_us_(0.), calibrated_(false) {}
+
+profiler::~profiler() {
+    for (const auto &section : open_) release(section);
+    for (const auto &section : pending_) release(section);
+
+    if (!free_queries_.empty())
+        glDeleteQueries(free_queries_.size(), free_queries_.data());
+}
+
+GLuint profiler::make_timestamp() {
+    GLuint query;
+
+    if (free_queries_.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = free_queries_.back();
+        free_queries_.pop_back();
+    }
+
+    // No libshadertoy wrapper yet
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+void profiler::release(const gpu_section &section) {
+    free_queries_.push_back(section.begin_query);
+    if (section.end_query) free_queries_.push_back(section.end_query);
+}
+
+void profiler::calibrate() {
+    // Reading the current GPU time synchronizes with the driver, so only do
+    // it once in a while to correct clock drift
+    double now = trace::now_us();
+    if (calibrated_ && now - trace_reference_us_ < calibration_interval_us)
+        return;
+
+    glGetInteger64v(GL_TIMESTAMP, &gpu_reference_ns_);
+    trace_reference_us_ = now;
+    calibrated_ = true;
+}
+
+void profiler::gpu_begin(const std::string &name) {
+    open_.push_back({name, make_timestamp(), 0});
+}
+
+void profiler::gpu_end(const std::string &name) {
+    auto it = std::find_if(open_.rbegin(), open_.rend(),
+                           [&name](const auto &s) { return s.name == name; });
+    if (it == open_.rend()) return;
+
+    gpu_section section(*it);
+    open_.erase(std::next(it).base());
+
+    section.end_query = make_timestamp();
+    pending_.push_back(section);
+}
+
+void profiler::collect() {
+    // Timestamps complete in submission order, so stop at the first section
+    // that is not available yet
+    while (!pending_.empty()) {
+        const auto &section = pending_.front();
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(section.end_query, GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if (!available) break;
+
+        GLuint64 begin_ns, end_ns;
+        glGetQueryObjectui64v(section.begin_query, GL_QUERY_RESULT, &begin_ns);
+        glGetQueryObjectui64v(section.end_query, GL_QUERY_RESULT, &end_ns);
+
+        record(section.name, (end_ns - begin_ns) / 1.0e6f);
+
+        if (trace::enabled()) {
+            calibrate();
+            trace::complete(
+                section.name, "gpu",
+                trace_reference_us_ +
+                    (static_cast<GLint64>(begin_ns) - gpu_reference_ns_) /
+                        1.0e3,
+                (end_ns - begin_ns) / 1.0e3, true);
+        }
+
+        release(section);
+        pending_.pop_front();
+    }
+}
+
+void profiler::clear() { sections_.clear(); }
+
+void profiler::record(const std::string &name, float ms) {
+    auto it = sections_.find(name);
+    if (it == sections_.end()) it = sections_.emplace(name, sample_ring()).first;
+
+    it->second.push(ms);
+}
+
+const sample_ring *profiler::find(const std::string &name) const {
+    auto it = sections_.find(name);
+    if (it == sections_.end()) return nullptr;
+    return &it->second;
+}
+
+profiler_stats profiler::stats() const {
+    profiler_stats result;
+
+    for (const auto &pair : sections_) {
+        const auto &ring = pair.second;
+
+        result.emplace(pair.first, std::map<std::string, double>{
+                                       {"count", static_cast<double>(ring.size())},
+                                       {"mean", ring.mean()},
+                                       {"p50", ring.percentile(50.0f)},
+                                       {"p95", ring.percentile(95.0f)},
+                                       {"p99", ring.percentile(99.0f)},
+                                       {"last", ring.last()},
+                                   });
+    }
+
+    return result;
+}
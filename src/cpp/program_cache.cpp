@@ -0,0 +1,206 @@
+#include <epoxy/gl.h>
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "content_hash.hpp"
+#include "directory_cache.hpp"
+#include "log.hpp"
+#include "program_cache.hpp"
+#include "trace.hpp"
+
+namespace {
+/// Identifies cache files, change it with the file layout
+const uint32_t cache_magic = 0x4d565731;  // "MVW1"
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+};
+
+/// Null until the cache is opened
+std::unique_ptr<directory_cache> files;
+/// Driver identification strings, part of every key
+std::string driver_id;
+/// Driver entry point, the libepoxy one may be hooked by link_hook
+PFNGLLINKPROGRAMPROC link_program = nullptr;
+
+/// Guards the counters, read by getstats
+std::mutex mutex;
+program_cache::cache_stats counters{};
+
+uint64_t program_key(GLuint program) {
+    content_hash hash;
+    hash.add_bytes(driver_id.data(), driver_id.size());
+
+    GLint count = 0;
+    glGetProgramiv(program, GL_ATTACHED_SHADERS, &count);
+
+    std::vector<GLuint> shaders(count);
+    if (count > 0)
+        glGetAttachedShaders(program, count, nullptr, shaders.data());
+
+    std::vector<std::pair<GLint, std::string>> stages;
+    for (GLuint shader : shaders) {
+        GLint type, length;
+        glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+        glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length);
+
+        std::string source(std::max(length, 1), '\0');
+        glGetShaderSource(shader, source.size(), nullptr, &source[0]);
+        stages.emplace_back(type, std::move(source));
+    }
+
+    // The attachment order does not change the program
+    std::sort(stages.begin(), stages.end());
+
+    for (const auto &stage : stages) {
+        hash.add_bytes(&stage.first, sizeof(stage.first));
+        hash.add_bytes(stage.second.data(), stage.second.size());
+    }
+
+    return hash.value();
+}
+
+bool load_binary(GLuint program, uint64_t key) {
+    std::string path(files->path(key));
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+
+    cache_header header;
+    if (!ifs.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(ifs)),
+                             std::istreambuf_iterator<char>());
+    if (header.magic != cache_magic || header.key != key || binary.empty())
+        return false;
+
+    glProgramBinary(program, header.format, binary.data(), binary.size());
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_TRUE) {
+        VLOG->debug("Loaded program {} from {}", program, path);
+        files->touch(key, sizeof(header) + binary.size());
+        return true;
+    }
+
+    // The driver changed in a way its identification strings do not show
+    VLOG->info("Program binary {} rejected by the driver", path);
+    files->remove(key);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.rejected++;
+    return false;
+}
+
+void store_binary(GLuint program, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    cache_header header{cache_magic, format, key};
+    files->write(key, &header, sizeof(header), binary.data(), binary.size());
+}
+}  // namespace
+
+void program_cache::open(const std::string &dir, size_t budget) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) {
+        VLOG->info("The driver does not support program binaries");
+        return;
+    }
+
+    try {
+        files = std::make_unique<directory_cache>(dir, ".bin", budget);
+    } catch (std::runtime_error &ex) {
+        VLOG->warn("Could not open the program cache: {}", ex.what());
+        return;
+    }
+
+    std::stringstream ss;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION,
+                        GL_SHADING_LANGUAGE_VERSION}) {
+        ss << reinterpret_cast<const char *>(glGetString(name)) << '\n';
+    }
+    driver_id = ss.str();
+
+    // Resolved here, as libepoxy would replace a hook with the entry point
+    // when it resolves it
+    link_program = reinterpret_cast<PFNGLLINKPROGRAMPROC>(
+        glfwGetProcAddress("glLinkProgram"));
+
+    auto stats(files->stats());
+    VLOG->info("Caching program binaries in {}, {} programs ({} MB)", dir,
+               stats.files, stats.size >> 20);
+}
+
+static void APIENTRY cached_link_program(GLuint program) {
+    TRACE_SCOPE("program_cache::link", "gl");
+
+    uint64_t key = program_key(program);
+
+    if (load_binary(program, key)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.hits++;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.misses++;
+    }
+
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    link_program(program);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_TRUE) store_binary(program, key);
+}
+
+void program_cache::link(GLuint program) {
+    if (enabled())
+        cached_link_program(program);
+    else
+        glLinkProgram(program);
+}
+
+program_cache::link_hook::link_hook() : previous_(nullptr) {
+    if (!enabled()) return;
+
+    previous_ = epoxy_glLinkProgram;
+    epoxy_glLinkProgram = cached_link_program;
+}
+
+program_cache::link_hook::~link_hook() {
+    if (previous_) epoxy_glLinkProgram = previous_;
+}
+
+bool program_cache::enabled() { return link_program != nullptr; }
+
+program_cache::cache_stats program_cache::stats() {
+    directory_cache::cache_stats file_stats{};
+    if (files) file_stats = files->stats();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache_stats result(counters);
+    result.evictions = file_stats.evictions;
+    result.size = file_stats.size;
+    return result;
+}
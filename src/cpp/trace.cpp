@@ -0,0 +1,116 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+#include "trace.hpp"
+
+namespace {
+/// Track identifier of GPU spans
+const int gpu_tid = 0;
+
+std::mutex trace_mutex;
+std::ofstream trace_file;
+std::atomic<bool> trace_enabled(false);
+std::chrono::steady_clock::time_point trace_start;
+bool first_event;
+
+int current_tid() {
+    static std::atomic<int> next_tid(gpu_tid + 1);
+    thread_local int tid = next_tid++;
+    return tid;
+}
+
+void write_escaped(std::ostream &os, const std::string &str) {
+    os << '"';
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') os << '\\';
+        os << ch;
+    }
+    os << '"';
+}
+
+// Must be called with trace_mutex held
+void begin_event() {
+    if (!first_event) trace_file << ",\n";
+    first_event = false;
+}
+
+void thread_name(int tid, const std::string &name) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    begin_event();
+    trace_file << R"({"ph":"M","name":"thread_name","pid":1,"tid":)" << tid
+               << R"(,"args":{"name":)";
+    write_escaped(trace_file, name);
+    trace_file << "}}";
+}
+}  // namespace
+
+void trace::open(const std::string &path) {
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+
+        trace_file.open(path);
+        if (!trace_file) {
+            throw std::runtime_error("could not open trace file " + path);
+        }
+
+        trace_file << std::fixed << std::setprecision(3);
+        trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        trace_start = std::chrono::steady_clock::now();
+        first_event = true;
+    }
+
+    trace_enabled = true;
+
+    thread_name(gpu_tid, "GPU");
+    thread_name(current_tid(), "main");
+}
+
+void trace::close() {
+    if (!trace_enabled) return;
+    trace_enabled = false;
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_file << "\n]}\n";
+    trace_file.close();
+}
+
+bool trace::enabled() { return trace_enabled; }
+
+void trace::name_thread(const std::string &name) {
+    if (!trace_enabled) return;
+    thread_name(current_tid(), name);
+}
+
+double trace::now_us() {
+    std::chrono::duration<double, std::micro> elapsed(
+        std::chrono::steady_clock::now() - trace_start);
+    return elapsed.count();
+}
+
+void trace::complete(const std::string &name, const char *category,
+                     double ts_us, double dur_us, bool gpu) {
+    if (!trace_enabled) return;
+
+    int tid = gpu ? gpu_tid : current_tid();
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    begin_event();
+    trace_file << R"({"ph":"X","pid":1,"tid":)" << tid << R"(,"name":)";
+    write_escaped(trace_file, name);
+    trace_file << R"(,"cat":")" << category << R"(","ts":)" << ts_us
+               << R"(,"dur":)" << dur_us << "}";
+}
+
+trace::scope::scope(const char *name, const char *category)
+    : name_(name),
+      category_(category),
+      start_(trace_enabled ? now_us() : 0.) {}
+
+trace::scope::~scope() {
+    if (!trace_enabled) return;
+    complete(name_, category_, start_, now_us() - start_);
+}
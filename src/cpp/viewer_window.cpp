@@ -5,8 +5,6 @@
 #include <shadertoy.hpp>
 #include <shadertoy/backends/gl4.hpp>
 
-#include <numeric>
-
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
@@ -14,8 +12,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
 
+#include <chrono>
+#include <thread>
+
 #include "mvw/geometry.hpp"
 
+#include "program_cache.hpp"
+#include "trace.hpp"
 #include "viewer_window.hpp"
 
 using namespace shadertoy;
@@ -33,7 +36,9 @@ viewer_window::viewer_window(viewer_options opt)
       opt_{std::move(opt)},
       window_render_size_(opt_.frame.width, opt_.frame.height),
       viewed_revision_(0),
-      need_render_(true) {
+      need_render_(true),
+      redraw_frames_(idle_redraw_frames),
+      next_frame_time_(0.) {
 
     // Hide windows in headless mode
     if (opt_.headless_mode)
@@ -64,9 +69,14 @@ viewer_window::viewer_window(viewer_options opt)
     glfwSetCharCallback(window_, glfw_window_char_callback);
     glfwSetCursorPosCallback(window_, glfw_window_cursor_pos_callback);
     glfwSetScrollCallback(window_, glfw_window_scroll_callback);
+    glfwSetWindowRefreshCallback(window_, glfw_window_refresh_callback);
 
     backends::set_current(std::make_unique<backends::gl4::backend>());
 
+    if (!opt_.program_cache_dir.empty())
+        program_cache::open(opt_.program_cache_dir,
+                            static_cast<size_t>(opt_.program_cache_mb) << 20);
+
     // Initialize ImGui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -99,11 +109,14 @@ viewer_window::viewer_window(viewer_options opt)
 
     // Start server
     if (!opt_.server.bind_addr.empty())
-        server_ = std::make_unique<net::server>(opt_.server, opt_.log);
+        server_ = std::make_unique<net::server>(
+            opt_.server, opt_.log, []() { glfwPostEmptyEvent(); });
 }
 
 viewer_window::~viewer_window() {
     if (window_) {
+        // Stop the network thread before the state it queues commands for
+        server_ = {};
         state_ = {};
         gl_state_ = {};
 
@@ -119,11 +132,11 @@ void viewer_window::run() {
     // Rendering time
     double t = 0.;
 
-    std::vector<float> runtime_acc(60, 0.0f);
-    std::vector<float> runtime_p_acc(60, 0.0f);
-    int runtime_acc_idx = 0;
-
     while (!glfwWindowShouldClose(window_)) {
+        wait_for_frame();
+
+        TRACE_SCOPE("frame");
+
         // Poll events
         glfwPollEvents();
 
@@ -185,24 +198,16 @@ void viewer_window::run() {
         char label_buf[30];
         char overlay_buf[30];
 
-        {
-            auto mean =
-                std::accumulate(runtime_acc.begin(), runtime_acc.end(), 0.0f) /
-                runtime_acc.size();
-            sprintf(label_buf, "N %2.3fms", runtime_acc[runtime_acc_idx]);
-            sprintf(overlay_buf, "a %2.3fms", mean);
-            ImGui::PlotHistogram(label_buf, runtime_acc.data(),
-                                 runtime_acc.size(), 0, overlay_buf);
-        }
+        for (const auto &section :
+             {std::make_pair("N", "gpu.geometry"),
+              std::make_pair("P", "gpu.postprocess")}) {
+            auto ring = gl_state_->timings.find(section.second);
+            if (!ring) continue;
 
-        if (gl_state_->has_postprocess(viewed_revision_)) {
-            auto mean = std::accumulate(runtime_p_acc.begin(),
-                                        runtime_p_acc.end(), 0.0f) /
-                        runtime_acc.size();
-            sprintf(label_buf, "P %2.3fms", runtime_p_acc[runtime_acc_idx]);
-            sprintf(overlay_buf, "a %2.3fms", mean);
-            ImGui::PlotHistogram(label_buf, runtime_p_acc.data(),
-                                 runtime_p_acc.size(), 0, overlay_buf);
+            sprintf(label_buf, "%s %2.3fms", section.first, ring->last());
+            sprintf(overlay_buf, "p95 %2.3fms", ring->percentile(95.0f));
+            ImGui::PlotHistogram(label_buf, ring->data(), ring->size(),
+                                 ring->offset(), overlay_buf);
         }
 
         ImGui::Text("Status");
@@ -227,11 +232,11 @@ void viewer_window::run() {
                           need_render_);
 
         // We updated the rendering to the latest version
-        bool has_renderered = need_render_;
         need_render_ = false;
 
         // Poll server instance for requests
         if (server_) {
+            scoped_timer timer(gl_state_->timings, "cpu.poll");
             need_render_ |=
                 server_->poll(*state_, *gl_state_, viewed_revision_);
         }
@@ -240,25 +245,53 @@ void viewer_window::run() {
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         // Buffer swapping
-        glfwSwapBuffers(window_);
-
-        if (has_renderered) {
-            // Measure time
-            float ts[2];
-            gl_state_->get_render_ms(ts, viewed_revision_);
-            runtime_acc[(runtime_acc_idx = (runtime_acc_idx + 1) %
-                                           runtime_acc.size())] = ts[0];
-            runtime_p_acc[runtime_acc_idx] = ts[1];
+        {
+            TRACE_SCOPE("glfwSwapBuffers", "gl");
+            glfwSwapBuffers(window_);
         }
 
+        // Record the GPU timings that are ready
+        gl_state_->timings.collect();
+
         // Update time and framecount
         t = glfwGetTime();
         state_->frame_count++;
+
+        if (redraw_frames_ > 0) redraw_frames_--;
+    }
+}
+
+void viewer_window::wait_for_frame() {
+    TRACE_SCOPE("wait_for_frame");
+
+    // Rotating the camera animates every frame
+    auto has_work = [this]() {
+        return need_render_ || redraw_frames_ > 0 || state_->rotate_camera;
+    };
+
+    // The network thread posts an empty event when it queues requests
+    while (!has_work() && !glfwWindowShouldClose(window_)) {
+        if (server_ && server_->has_work()) break;
+        glfwWaitEvents();
+    }
+
+    // Frame rate cap
+    if (opt_.frame.max_fps > 0) {
+        double now = glfwGetTime();
+        if (now < next_frame_time_) {
+            std::this_thread::sleep_for(
+                std::chrono::duration<double>(next_frame_time_ - now));
+        }
+
+        next_frame_time_ =
+            std::max(now, next_frame_time_) + 1.0 / opt_.frame.max_fps;
     }
 }
 
 void viewer_window::glfw_mouse_button_callback(int button, int action,
                                                int mods) {
+    wake();
+
     // Ignore mouse clicks in window area
     if (state_->current_pos_x < window_width) return;
 
@@ -281,6 +314,8 @@ void viewer_window::glfw_mouse_button_callback(int button, int action,
 }
 
 void viewer_window::glfw_set_framebuffer_size(int width, int height) {
+    wake();
+
     bool match_size = window_render_size_ == gl_state_->render_size;
 
     window_render_size_ = shadertoy::rsize(width - window_width, height);
@@ -295,6 +330,8 @@ void viewer_window::glfw_set_framebuffer_size(int width, int height) {
 
 void viewer_window::glfw_key_callback(int key, int scancode, int action,
                                       int mods) {
+    wake();
+
     if (action == GLFW_PRESS) {
         if (key == GLFW_KEY_ESCAPE) {
             glfwSetWindowShouldClose(window_, true);
@@ -305,6 +342,8 @@ void viewer_window::glfw_key_callback(int key, int scancode, int action,
 }
 
 void viewer_window::glfw_char_callback(unsigned int codepoint) {
+    wake();
+
     if (codepoint == 'w') {
         state_->draw_wireframe = !state_->draw_wireframe;
         need_render_ = true;
@@ -314,6 +353,8 @@ void viewer_window::glfw_char_callback(unsigned int codepoint) {
 }
 
 void viewer_window::glfw_cursor_pos_callback(double xpos, double ypos) {
+    wake();
+
     state_->current_pos_x = xpos;
     state_->current_pos_y = ypos;
 
@@ -326,6 +367,8 @@ void viewer_window::glfw_cursor_pos_callback(double xpos, double ypos) {
 }
 
 void viewer_window::glfw_scroll_callback(double xoffset, double yoffset) {
+    wake();
+
     state_->scale += yoffset / 4.0 * state_->scale;
 
     need_render_ = true;
@@ -371,3 +414,7 @@ void viewer_window::glfw_window_scroll_callback(GLFWwindow *window,
         ->glfw_scroll_callback(xoffset, yoffset);
 }
 
+void viewer_window::glfw_window_refresh_callback(GLFWwindow *window) {
+    reinterpret_cast<viewer_window *>(glfwGetWindowUserPointer(window))
+        ->wake();
+}
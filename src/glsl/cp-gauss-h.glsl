@@ -0,0 +1,42 @@
+// Horizontal pass of the separable Gaussian blur shown by pp-gauss-compute.glsl
+[% PROCESS pp/color.glsl %]
+
+//! float gSigma min=0.5 max=10.0 fmt="%2.2f" cat="Gaussian blur" unm="Sigma" def=3.0
+[% PROCESS pp/gauss.glsl %]
+
+//! local_size 256 1
+#define GROUP_WIDTH 256
+
+// Row segment of the work group, with an apron on both sides
+shared vec4 s_row[GROUP_WIDTH + 2 * MAX_RADIUS];
+
+void main()
+{
+    ivec2 size = ivec2(iResolution.xy);
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    int li = int(gl_LocalInvocationID.x);
+    int x0 = int(gl_WorkGroupID.x) * GROUP_WIDTH - MAX_RADIUS;
+
+    // Every texel of the row is fetched once per work group
+    for (int i = li; i < GROUP_WIDTH + 2 * MAX_RADIUS; i += GROUP_WIDTH) {
+        ivec2 q = clamp(ivec2(x0 + i, p.y), ivec2(0), size - 1);
+        s_row[i] = texelFetch(colorOutput, q, 0);
+    }
+
+    barrier();
+
+    if (any(greaterThanEqual(p, size)))
+        return;
+
+    int r = gauss_radius();
+    vec4 sum = vec4(0.);
+    float norm = 0.;
+
+    for (int k = -r; k <= r; ++k) {
+        float w = gauss_weight(float(k));
+        sum += w * s_row[li + MAX_RADIUS + k];
+        norm += w;
+    }
+
+    imageStore(oOutput, p, sum / norm);
+}
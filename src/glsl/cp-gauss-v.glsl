@@ -0,0 +1,40 @@
+// Vertical pass of the separable Gaussian blur, reads cp-gauss-h.glsl
+//! horizontal binding=cp-gauss-h
+
+[% PROCESS pp/gauss.glsl %]
+
+//! local_size 1 256
+#define GROUP_HEIGHT 256
+
+// Column segment of the work group, with an apron on both sides
+shared vec4 s_column[GROUP_HEIGHT + 2 * MAX_RADIUS];
+
+void main()
+{
+    ivec2 size = ivec2(iResolution.xy);
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    int li = int(gl_LocalInvocationID.y);
+    int y0 = int(gl_WorkGroupID.y) * GROUP_HEIGHT - MAX_RADIUS;
+
+    for (int i = li; i < GROUP_HEIGHT + 2 * MAX_RADIUS; i += GROUP_HEIGHT) {
+        ivec2 q = clamp(ivec2(p.x, y0 + i), ivec2(0), size - 1);
+        s_column[i] = texelFetch(horizontal, q, 0);
+    }
+
+    barrier();
+
+    if (any(greaterThanEqual(p, size)))
+        return;
+
+    int r = gauss_radius();
+    vec4 sum = vec4(0.);
+    float norm = 0.;
+
+    for (int k = -r; k <= r; ++k) {
+        float w = gauss_weight(float(k));
+        sum += w * s_column[li + MAX_RADIUS + k];
+        norm += w;
+    }
+
+    imageStore(oOutput, p, sum / norm);
+}
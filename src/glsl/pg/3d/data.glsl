@@ -1,3 +1,10 @@
+// Points are read from the pointData input, which the viewer fills with
+// points of the xoroshiro generator unless a client sets it. These match
+// pg/3d/white.glsl with the xoroshiro prng and without white_poisson, for
+// cells inside the grid only: neighbors outside of it wrap around here,
+// white.glsl seeds them from their own coordinates
+//! pointData table=splats
+
 struct pg_state {
     int seed;
     int splats;
@@ -7,6 +14,9 @@ struct pg_state {
 
 void pg_seed(inout pg_state this_, ivec3 nc, ivec3 tile_count, int random_seed, int expected_splats)
 {
+    // A zero count is one layer of cells, as in the generated tables
+    tile_count = max(tile_count, ivec3(1));
+
     // Wrap-around
     if (nc.x < 0) nc.x = tile_count.x + nc.x;
     if (nc.y < 0) nc.y = tile_count.y + nc.y;
@@ -0,0 +1,23 @@
+// Horizontal pass of the separable Gaussian blur shown by pp-gauss-passes.glsl,
+// the fragment baseline of cp-gauss-h.glsl
+[% PROCESS pp/color.glsl %]
+
+//! float gSigma min=0.5 max=10.0 fmt="%2.2f" cat="Gaussian blur" unm="Sigma" def=3.0
+[% PROCESS pp/gauss.glsl %]
+
+void mainImage(out vec4 O, in vec2 U)
+{
+    ivec2 size = ivec2(iResolution.xy);
+    int r = gauss_radius();
+    vec4 sum = vec4(0.);
+    float norm = 0.;
+
+    for (int k = -r; k <= r; ++k) {
+        float w = gauss_weight(float(k));
+        ivec2 q = clamp(ivec2(U) + ivec2(k, 0), ivec2(0), size - 1);
+        sum += w * texelFetch(colorOutput, q, 0);
+        norm += w;
+    }
+
+    O = sum / norm;
+}
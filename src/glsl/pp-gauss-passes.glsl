@@ -0,0 +1,15 @@
+[% PROCESS pp/params.glsl %]
+[% PROCESS pp/lighting.glsl %]
+
+// Noise blurred by the pp-gauss-h.glsl and pp-gauss-v.glsl fragment passes
+//! blurred binding=pp-gauss-v
+
+void mainImage(out vec4 O, in vec2 U)
+{
+    O = texture(blurred, U / iResolution.xy);
+
+    // Show only noise value
+    O.rgb = O.rrr;
+
+    O.rgb = lighting(U, O.rgb);
+}
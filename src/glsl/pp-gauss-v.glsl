@@ -0,0 +1,22 @@
+// Vertical pass of the separable Gaussian blur, reads pp-gauss-h.glsl, the
+// fragment baseline of cp-gauss-v.glsl
+//! horizontal binding=pp-gauss-h
+
+[% PROCESS pp/gauss.glsl %]
+
+void mainImage(out vec4 O, in vec2 U)
+{
+    ivec2 size = ivec2(iResolution.xy);
+    int r = gauss_radius();
+    vec4 sum = vec4(0.);
+    float norm = 0.;
+
+    for (int k = -r; k <= r; ++k) {
+        float w = gauss_weight(float(k));
+        ivec2 q = clamp(ivec2(U) + ivec2(0, k), ivec2(0), size - 1);
+        sum += w * texelFetch(horizontal, q, 0);
+        norm += w;
+    }
+
+    O = sum / norm;
+}
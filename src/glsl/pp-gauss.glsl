@@ -0,0 +1,32 @@
+[% PROCESS pp/color.glsl %]
+[% PROCESS pp/params.glsl %]
+[% PROCESS pp/lighting.glsl %]
+
+//! float gSigma min=0.5 max=10.0 fmt="%2.2f" cat="Gaussian blur" unm="Sigma" def=3.0
+[% PROCESS pp/gauss.glsl %]
+
+// Gaussian blur of the noise value with the full 2D kernel, in a single pass.
+// pp-gauss-passes.glsl and pp-gauss-compute.glsl apply it separably
+void mainImage(out vec4 O, in vec2 U)
+{
+    ivec2 size = ivec2(iResolution.xy);
+    int r = gauss_radius();
+    vec4 sum = vec4(0.);
+    float norm = 0.;
+
+    for (int j = -r; j <= r; ++j) {
+        for (int i = -r; i <= r; ++i) {
+            float w = gauss_weight(float(i)) * gauss_weight(float(j));
+            ivec2 p = clamp(ivec2(U) + ivec2(i, j), ivec2(0), size - 1);
+            sum += w * texelFetch(colorOutput, p, 0);
+            norm += w;
+        }
+    }
+
+    O = sum / norm;
+
+    // Show only noise value
+    O.rgb = O.rrr;
+
+    O.rgb = lighting(U, O.rgb);
+}
@@ -0,0 +1,17 @@
+// Gaussian kernel of the blur passes, the including shader declares the
+// gSigma directive
+
+uniform float gSigma;
+
+// Largest kernel radius, and apron of the compute passes
+#define MAX_RADIUS 32
+
+int gauss_radius()
+{
+    return min(int(ceil(3. * gSigma)), MAX_RADIUS);
+}
+
+float gauss_weight(float x)
+{
+    return exp(-x * x / (2. * gSigma * gSigma));
+}
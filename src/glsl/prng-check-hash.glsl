@@ -0,0 +1,2 @@
+[% SET prng = "hash" %]
+[% PROCESS "prng-check.glsl" %]
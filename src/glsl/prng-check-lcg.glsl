@@ -0,0 +1,2 @@
+[% SET prng = "lcg" %]
+[% PROCESS "prng-check.glsl" %]
@@ -0,0 +1,2 @@
+[% SET prng = "xorshift" %]
+[% PROCESS "prng-check.glsl" %]
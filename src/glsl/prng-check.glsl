@@ -0,0 +1,32 @@
+[% PROCESS core/math.glsl %]
+[% PROCESS core/hash.glsl %]
+[% IF prng == "hash" %]
+[% PROCESS prng/hash.glsl %]
+[% ELSIF prng == "lcg" %]
+[% PROCESS prng/lcg.glsl %]
+[% ELSIF prng == "xorshift" %]
+[% PROCESS prng/xorshift.glsl %]
+[% ELSE %]
+[% PROCESS prng/xoroshiro.glsl %]
+[% END %]
+[% PROCESS prng/poisson.glsl %]
+
+// Draws from one generator per pixel, compared against the C++ ports by
+// mvw-bench --check-prng
+
+//! bool dQuad def=true cat="Rendering" unm="Render as quad"
+
+//! float cMean min=0.0 max=100.0 fmt="%2.2f" cat="PRNG check" unm="Poisson mean" def=4.0
+uniform float cMean;
+
+void mainImage(out vec4 O, in vec2 U)
+{
+    // Seed with the pixel index
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    prng_state state;
+    prng_seed(state, uint(p.y * int(iResolution.x) + p.x));
+
+    O.xy = prng_rand2(state);
+    O.z = prng_rand1(state);
+    O.w = float(prng_poisson(state, cMean));
+}